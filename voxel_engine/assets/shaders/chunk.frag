@@ -4,6 +4,7 @@ centroid in vec2 uv;
 in vec2 extrapolated_uv;
 in float frag_break_amount;
 in float dist_to_camera;
+flat in vec4 frag_tile;
 
 out vec4 color;
 
@@ -23,25 +24,46 @@ float mip_map_level(in vec2 texture_coordinate) // in texel units
 
 // Source: https://vegard.wiki/w/Texture_magnification_antialiasing
 //         https://www.shadertoy.com/view/ldlSzS
-vec4 texturePixelAA(sampler2D tex, vec2 uv, vec2 w, vec2 texsize, float mm) {    
-    return texture(tex, (floor(uv)+0.5+clamp((fract(uv)-0.5+w)/w,0.,1.)) / texsize, mm);    
+vec2 pixelAAUV(vec2 uv, vec2 w) {
+    return floor(uv)+0.5+clamp((fract(uv)-0.5+w)/w,0.,1.);
+}
+
+// The gradients are taken from unwrapped_uv, so that the mipmap level doesn't jump at the edge of a wrapped tile.
+// Scaling them by 2^mm is the same as passing mm as a bias to texture()
+vec4 texturePixelAA(sampler2D tex, vec2 uv, vec2 unwrapped_uv, vec2 w, vec2 texsize, float mm) {
+    vec2 unwrapped_coordinate = pixelAAUV(unwrapped_uv, w) / texsize;
+    float bias = exp2(mm);
+    return textureGrad(tex, pixelAAUV(uv, w) / texsize, dFdx(unwrapped_coordinate) * bias, dFdy(unwrapped_coordinate) * bias);
+}
+
+// Merged faces have uvs that run across several copies of their tile, so wrap them back onto the tile
+vec2 wrap_uv(vec2 unwrapped_uv) {
+    if (frag_tile.z > 0.0) {
+        return frag_tile.xy + mod(unwrapped_uv - frag_tile.xy, frag_tile.zw);
+    }
+    return unwrapped_uv;
 }
 
 vec4 get_texture_color() {
+    // Derivatives are taken from the unwrapped uv, as the wrapped uv jumps at the edge of every tile
     float mm = mip_map_level(uv * textureSize(my_texture, 0));
     float lower_mm = min(floor(mm), 2.0);
     float higher_mm = min(ceil(mm), 2.0);
+    vec2 wrapped_uv = wrap_uv(uv);
 
     vec2 lower_texture_size = textureSize(my_texture, int(lower_mm + 0.5));
     vec2 higher_texture_size = textureSize(my_texture, int(higher_mm + 0.5));
-    vec2 lower_adjusted_uv = uv * lower_texture_size.x + vec2(-0.5, -0.5);
-    vec2 higher_adjusted_uv = uv * higher_texture_size.x + vec2(-0.5, -0.5);
+    vec2 lower_adjusted_uv = wrapped_uv * lower_texture_size.x + vec2(-0.5, -0.5);
+    vec2 higher_adjusted_uv = wrapped_uv * higher_texture_size.x + vec2(-0.5, -0.5);
+
+    vec2 lower_unwrapped_uv = uv * lower_texture_size.x + vec2(-0.5, -0.5);
+    vec2 higher_unwrapped_uv = uv * higher_texture_size.x + vec2(-0.5, -0.5);
 
-    vec2 lower_w = fwidth(lower_adjusted_uv);
-    vec2 higher_w = fwidth(higher_adjusted_uv);
+    vec2 lower_w = fwidth(lower_unwrapped_uv);
+    vec2 higher_w = fwidth(higher_unwrapped_uv);
 
-    vec4 lower_texture_color = texturePixelAA(my_texture, lower_adjusted_uv, lower_w, lower_texture_size, lower_mm);
-    vec4 higher_texture_color = texturePixelAA(my_texture, higher_adjusted_uv, higher_w, higher_texture_size, higher_mm);
+    vec4 lower_texture_color = texturePixelAA(my_texture, lower_adjusted_uv, lower_unwrapped_uv, lower_w, lower_texture_size, lower_mm);
+    vec4 higher_texture_color = texturePixelAA(my_texture, higher_adjusted_uv, higher_unwrapped_uv, higher_w, higher_texture_size, higher_mm);
     
     vec4 texture_color = mix(lower_texture_color, higher_texture_color, fract(mm));
     return texture_color;
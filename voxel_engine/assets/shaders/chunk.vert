@@ -1,28 +1,59 @@
 #version 330 core
 
-layout(location = 0) in vec3 vertex_position;
-
-// Notice that the "1" here equals the "1" in glVertexAttribPointer
-layout(location = 1) in vec2 vertexUV;
-layout(location = 2) in float break_amount;
+// A vertex packed into two words, see ChunkVertex in chunk_mesher.hpp
+layout(location = 0) in uvec2 packed_vertex;
 
 uniform mat4 P;
 uniform mat4 V;
+// The corner of the chunk, in block-coordinates
+uniform vec3 chunk_position;
+// The grid of bitmaps on the texture atlas, see TextureAtlasser::get_grid_layout
+uniform vec4 atlas_grid;
 
 // Vertex {gl_Position, per_vertex_color}
 centroid out vec2 uv;
 out vec2 extrapolated_uv;
 out float frag_break_amount;
 out float dist_to_camera;
+// The atlas tile that uv wraps around, as (offset, scale). A scale of 0 means no wrapping
+flat out vec4 frag_tile;
 
 void main() {
-  vec4 cameraspace_pos = V * vec4(vertex_position, 1.0);
+  uint position_word = packed_vertex.x;
+  uint texture_word = packed_vertex.y;
+
+  vec3 local_position = vec3(uvec3(position_word, position_word >> 9u, position_word >> 18u) & 511u) / 16.0 - 8.0;
+  uint face = (position_word >> 27u) & 7u;
+
+  // Find the bitmap's tile on the atlas, which is flipped vertically
+  uint tile = texture_word & 4095u;
+  uint bitmaps_per_row = uint(atlas_grid.x);
+  vec2 top_left = vec2(tile % bitmaps_per_row, tile / bitmaps_per_row) * atlas_grid.y + atlas_grid.z;
+  vec2 tile_offset = vec2(top_left.x, 1.0 - top_left.y - atlas_grid.w);
+
+  vec2 tile_uv;
+  if (face < 6u) {
+    // On a face of a unit cube, the texture repeats once per block along the face
+    uint axis = face / 2u;
+    vec2 face_position = axis == 0u ? local_position.yz : (axis == 1u ? local_position.xz : local_position.xy);
+    uint orientation = (texture_word >> 12u) & 7u;
+    if ((orientation & 1u) != 0u) {
+      face_position = face_position.yx;
+    }
+    tile_uv = mix(face_position, 1.0 - face_position, bvec2((orientation & 2u) != 0u, (orientation & 4u) != 0u));
+    frag_tile = vec4(tile_offset, vec2(atlas_grid.w));
+  } else {
+    tile_uv = vec2(uvec2(texture_word >> 12u, texture_word >> 17u) & 31u) / 16.0;
+    frag_tile = vec4(0.0);
+  }
+
+  frag_break_amount = float((texture_word >> 22u) & 255u) / 255.0;
+
+  vec4 cameraspace_pos = V * vec4(chunk_position + local_position, 1.0);
   dist_to_camera = length(cameraspace_pos);
 
-  frag_break_amount = break_amount;
-
-  uv = vertexUV;
-  extrapolated_uv = vertexUV;
+  uv = tile_offset + tile_uv * atlas_grid.w;
+  extrapolated_uv = uv;
 
   gl_Position = P * cameraspace_pos;
 }
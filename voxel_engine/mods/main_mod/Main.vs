@@ -50,13 +50,7 @@ implement Main {
             for(int dy = -1; dy <= 1; dy++) {
                 for(int dz = -1; dz <= 1; dz++) {
                     int[] ret = this.overworld.generate(dx, dy, dz);
-                    for(int x = 0; x < 16; x++) {
-                        for(int y = 0; y < 16; y++) {
-                            for(int z = 0; z < 16; z++) {
-                                voxel_engine.world.set_block(this.overworld.world_id, dx*16+x, dy*16+y, dz*16+z, ret[16*16*x+16*y+z]);
-                            }
-                        }
-                    }
+                    voxel_engine.world.paste_buffer(this.overworld.world_id, dx*16, dy*16, dz*16, 16, 16, 16, ret);
                     voxel_engine.world.mark_generated(this.overworld.world_id, dx, dy, dz);
                 }
             }
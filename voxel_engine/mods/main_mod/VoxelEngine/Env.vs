@@ -21,6 +21,12 @@ class Environment {
     void VoxelEngine__World__set_block(int world_id, int x, int y, int z, int model_id);
     float VoxelEngine__World__get_break_amount(int world_id, int x, int y, int z);
     void VoxelEngine__World__set_break_amount(int world_id, int x, int y, int z, float break_amount);
+    int VoxelEngine__World__get_height(int world_id, int x, int z);
+
+    void VoxelEngine__World__fill_box(int world_id, int x, int y, int z, int size_x, int size_y, int size_z, int model_id);
+    void VoxelEngine__World__copy_box_to_buffer(int world_id, int x, int y, int z, int size_x, int size_y, int size_z, int[] buffer);
+    void VoxelEngine__World__paste_buffer(int world_id, int x, int y, int z, int size_x, int size_y, int size_z, int[] buffer);
+    void VoxelEngine__World__apply_mask(int world_id, int x, int y, int z, int size_x, int size_y, int size_z, int[] mask, int model_id);
 
     void VoxelEngine__World__restart_world(int world_id);
     int VoxelEngine__World__load_world(int world_id, string filepath);
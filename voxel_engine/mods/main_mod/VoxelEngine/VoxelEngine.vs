@@ -34,6 +34,14 @@ class VoxelEngineWorld {
     void set_block(int world_id, int x, int y, int z, int model_id);
     float get_break_amount(int world_id, int x, int y, int z);
     void set_break_amount(int world_id, int x, int y, int z, float break_amount);
+    // The y of the topmost non-air block at x and z, or -2147483648 if there are only air blocks there
+    int get_height(int world_id, int x, int z);
+
+    void fill_box(int world_id, int x, int y, int z, int size_x, int size_y, int size_z, int model_id);
+    void copy_box_to_buffer(int world_id, int x, int y, int z, int size_x, int size_y, int size_z, int[] buffer);
+    void paste_buffer(int world_id, int x, int y, int z, int size_x, int size_y, int size_z, int[] buffer);
+    // Set every block in the box whose entry in mask is nonzero to model_id
+    void apply_mask(int world_id, int x, int y, int z, int size_x, int size_y, int size_z, int[] mask, int model_id);
 
     void restart_world(int world_id);
     int load_world(int world_id, string filepath);
@@ -63,6 +71,22 @@ implement VoxelEngineWorld {
     void set_break_amount(int world_id, int x, int y, int z, float break_amount) {
         env.VoxelEngine__World__set_break_amount(world_id, x, y, z, break_amount);
     }
+    int get_height(int world_id, int x, int z) {
+        return env.VoxelEngine__World__get_height(world_id, x, z);
+    }
+
+    void fill_box(int world_id, int x, int y, int z, int size_x, int size_y, int size_z, int model_id) {
+        env.VoxelEngine__World__fill_box(world_id, x, y, z, size_x, size_y, size_z, model_id);
+    }
+    void copy_box_to_buffer(int world_id, int x, int y, int z, int size_x, int size_y, int size_z, int[] buffer) {
+        env.VoxelEngine__World__copy_box_to_buffer(world_id, x, y, z, size_x, size_y, size_z, buffer);
+    }
+    void paste_buffer(int world_id, int x, int y, int z, int size_x, int size_y, int size_z, int[] buffer) {
+        env.VoxelEngine__World__paste_buffer(world_id, x, y, z, size_x, size_y, size_z, buffer);
+    }
+    void apply_mask(int world_id, int x, int y, int z, int size_x, int size_y, int size_z, int[] mask, int model_id) {
+        env.VoxelEngine__World__apply_mask(world_id, x, y, z, size_x, size_y, size_z, mask, model_id);
+    }
 
     void restart_world(int world_id) {
         env.VoxelEngine__World__restart_world(world_id);
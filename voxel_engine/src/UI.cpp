@@ -1,5 +1,6 @@
 #include "UI.hpp"
 #include "gl_utils.hpp"
+#include "universe.hpp"
 
 UIElement::UIElement() {
     this->texture = 0;
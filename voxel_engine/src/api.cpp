@@ -5,7 +5,8 @@
 
 #define uni get_universe()
 
-World world;
+// Worlds hold locks, so they can't be reassigned. Restarting the world replaces it instead
+unique_ptr<World> world(new World());
 
 int VoxelEngine::register_font(const char* filepath) {
     return uni->register_font(filepath);
@@ -49,49 +50,85 @@ int VoxelEngine::register_world() {
 
 bool VoxelEngine::World::is_generated(int world_id, ivec3 chunk_coords) {
     if (world_id != 1) dbg("ERROR: World doesn't exist!");
-    return world.is_generated(chunk_coords);
+    return world->is_generated(chunk_coords);
 }
 
 void VoxelEngine::World::mark_generated(int world_id, ivec3 chunk_coords) {
     if (world_id != 1) dbg("ERROR: World doesn't exist!");
-    world.mark_generated(chunk_coords);
+    world->mark_generated(chunk_coords);
+}
+
+void VoxelEngine::World::set_generator(int world_id, uint32_t generator_id, uint64_t seed, std::function<void(ivec3 chunk_coords, uint64_t seed, int* buffer)> generate) {
+    if (world_id != 1) dbg("ERROR: World doesn't exist!");
+    world->set_generator(generator_id, seed, generate);
 }
 
 void VoxelEngine::World::mark_chunk(int world_id, ivec3 chunk_coords, int priority) {
     if (world_id != 1) dbg("ERROR: World doesn't exist!");
-    world.mark_chunk(chunk_coords, priority);
+    world->mark_chunk(chunk_coords, priority);
 }
 
 int VoxelEngine::World::get_block(int world_id, ivec3 coordinates) {
     if (world_id != 1) dbg("ERROR: World doesn't exist!");
-    const BlockData* data = world.read_block(coordinates);
+    optional<BlockData> data = world->read_block(coordinates);
     return data ? data->block_model : 0;
 }
 
 void VoxelEngine::World::set_block(int world_id, ivec3 coordinates, int model_id) {
     if (world_id != 1) dbg("ERROR: World doesn't exist!");
-    world.set_block(coordinates.x, coordinates.y, coordinates.z, model_id);
+    world->set_block(coordinates.x, coordinates.y, coordinates.z, model_id);
 }
 
 float VoxelEngine::World::get_break_amount(int world_id, ivec3 coordinates) {
     if (world_id != 1) dbg("ERROR: World doesn't exist!");
-    return world.read_block(coordinates)->break_amount;
+    optional<BlockData> data = world->read_block(coordinates);
+    return data ? data->break_amount : 0.0f;
 }
 
 void VoxelEngine::World::set_break_amount(int world_id, ivec3 coordinates, float break_amount) {
     if (world_id != 1) dbg("ERROR: World doesn't exist!");
-    world.write_block(coordinates)->break_amount = break_amount;
+    optional<BlockData> data = world->read_block(coordinates);
+    if (data) {
+        BlockData new_data = *data;
+        new_data.break_amount = break_amount;
+        world->write_block(coordinates, new_data);
+    }
+}
+
+optional<int> VoxelEngine::World::get_height(int world_id, int x, int z) {
+    if (world_id != 1) dbg("ERROR: World doesn't exist!");
+    return world->get_height(x, z);
+}
+
+void VoxelEngine::World::fill_box(int world_id, ivec3 location, ivec3 size, int model_id) {
+    if (world_id != 1) dbg("ERROR: World doesn't exist!");
+    world->fill_box(location, size, model_id);
+}
+
+void VoxelEngine::World::copy_box_to_buffer(int world_id, ivec3 location, ivec3 size, int* buffer) {
+    if (world_id != 1) dbg("ERROR: World doesn't exist!");
+    world->copy_box_to_buffer(location, size, buffer);
+}
+
+void VoxelEngine::World::paste_buffer(int world_id, ivec3 location, ivec3 size, const int* buffer) {
+    if (world_id != 1) dbg("ERROR: World doesn't exist!");
+    world->paste_buffer(location, size, buffer);
+}
+
+void VoxelEngine::World::apply_mask(int world_id, ivec3 location, ivec3 size, const byte* mask, int model_id) {
+    if (world_id != 1) dbg("ERROR: World doesn't exist!");
+    world->apply_mask(location, size, mask, model_id);
 }
 
 optional<ivec3> VoxelEngine::World::raycast(int world_id, vec3 position, vec3 direction, float max_distance, bool previous_block) {
     if (world_id != 1) dbg("ERROR: World doesn't exist!");
-    return world.raycast(position, direction, max_distance, previous_block);
+    return world->raycast(position, direction, max_distance, previous_block);
 }
 
 vector<vec3> VoxelEngine::World::collide(int world_id, vec3 collision_box_min_point, vec3 collision_box_max_point) {
     if (world_id != 1) dbg("ERROR: World doesn't exist!");
     vector<vec3> collisions;
-    world.collide(AABB(collision_box_min_point, collision_box_max_point), [&collisions](vec3 movement, float) {
+    world->collide(AABB(collision_box_min_point, collision_box_max_point), [&collisions](vec3 movement, float) {
         collisions.push_back(movement);
     });
     return collisions;
@@ -99,17 +136,18 @@ vector<vec3> VoxelEngine::World::collide(int world_id, vec3 collision_box_min_po
 
 void VoxelEngine::World::restart_world(int world_id) {
     if (world_id != 1) dbg("ERROR: World doesn't exist! %d", world_id);
-    world = ::World();
+    world.reset(new ::World());
 }
 
 bool VoxelEngine::World::load_world(int world_id, const char* filepath) {
     if (world_id != 1) dbg("ERROR: World doesn't exist!");
-    return world.load(filepath);
+    return world->load(filepath);
 }
 
 void VoxelEngine::World::save_world(int world_id, const char* filepath) {
     if (world_id != 1) dbg("ERROR: World doesn't exist!");
-    world.save(filepath);
+    WorldSaveStatistics statistics = world->save(filepath);
+    dbg("Saved %d megachunks (%d unchanged, %d dirty chunks), %zu bytes in %.2fms", statistics.num_megachunks_written, statistics.num_megachunks_skipped, statistics.num_dirty_chunks, statistics.bytes_written, statistics.time_taken);
 }
 
 void VoxelEngine::Renderer::render_texture(int texture_id, ivec2 location, ivec2 size) {
@@ -126,7 +164,7 @@ void VoxelEngine::Renderer::render_model(int model_id, mat4 proj, mat4 view, mat
 
 void VoxelEngine::Renderer::render_world(int world_id, mat4 proj, mat4 view) {
     if (world_id != 1) dbg("ERROR: World doesn't exist!");
-    world.render(proj, view, *uni->get_atlasser());
+    world->render(proj, view, *uni->get_atlasser());
 }
 
 void VoxelEngine::Renderer::render_skybox(int cubemap_texture_id, mat4 proj, mat4 view) {
@@ -18,12 +18,19 @@ namespace VoxelEngine {
     namespace World {
         bool is_generated(int world_id, ivec3 chunk_coords);
         void mark_generated(int world_id, ivec3 chunk_coords);
+        void set_generator(int world_id, uint32_t generator_id, uint64_t seed, std::function<void(ivec3 chunk_coords, uint64_t seed, int* buffer)> generate);
         void mark_chunk(int world_id, ivec3 chunk_coords, int priority);
 
         int get_block(int world_id, ivec3 coordinates);
         void set_block(int world_id, ivec3 coordinates, int model_id);
         float get_break_amount(int world_id, ivec3 coordinates);
         void set_break_amount(int world_id, ivec3 coordinates, float break_amount);
+        optional<int> get_height(int world_id, int x, int z);
+
+        void fill_box(int world_id, ivec3 location, ivec3 size, int model_id);
+        void copy_box_to_buffer(int world_id, ivec3 location, ivec3 size, int* buffer);
+        void paste_buffer(int world_id, ivec3 location, ivec3 size, const int* buffer);
+        void apply_mask(int world_id, ivec3 location, ivec3 size, const byte* mask, int model_id);
 
         optional<ivec3> raycast(int world_id, vec3 position, vec3 direction, float max_distance, bool previous_block=false);
         vector<vec3> collide(int world_id, vec3 collision_box_min_point, vec3 collision_box_max_point);
@@ -0,0 +1,113 @@
+#include "block_cursor.hpp"
+#include "world.hpp"
+
+// Offsets of the six neighboring chunks, in the same order as Mesh::get_mesh_data
+static const ivec3 neighbor_offsets[6] = {ivec3(-1, 0, 0), ivec3(1, 0, 0), ivec3(0, -1, 0), ivec3(0, 1, 0), ivec3(0, 0, -1), ivec3(0, 0, 1)};
+
+static ivec3 to_chunk_coords(ivec3 position) {
+    return ivec3(floor_div(position.x, CHUNK_SIZE), floor_div(position.y, CHUNK_SIZE), floor_div(position.z, CHUNK_SIZE));
+}
+
+BlockCursor::BlockCursor(World* world, ivec3 position) {
+    this->world = world;
+    this->position = position;
+    chunk_coords = to_chunk_coords(position);
+    chunk = fetch_chunk(chunk_coords);
+    neighbors_fetched = 0;
+}
+
+ivec3 BlockCursor::get_position() {
+    return position;
+}
+
+void BlockCursor::move_to(ivec3 new_position) {
+    position = new_position;
+
+    ivec3 new_chunk_coords = to_chunk_coords(new_position);
+    if (new_chunk_coords == chunk_coords) {
+        return;
+    }
+
+    // If we moved into a neighboring chunk, then the chunk we left is now that chunk's neighbor in the opposite direction
+    for(int dir = 0; dir < 6; dir++) {
+        if (new_chunk_coords == chunk_coords + neighbor_offsets[dir]) {
+            ChunkData* old_chunk = chunk;
+            chunk = get_cached_chunk(new_chunk_coords).value();
+            chunk_coords = new_chunk_coords;
+            int opposite_dir = dir ^ 1;
+            neighbors[opposite_dir] = old_chunk;
+            neighbors_fetched = 1 << opposite_dir;
+            return;
+        }
+    }
+
+    chunk_coords = new_chunk_coords;
+    chunk = fetch_chunk(chunk_coords);
+    neighbors_fetched = 0;
+}
+
+void BlockCursor::move(ivec3 offset) {
+    move_to(position + offset);
+}
+
+int BlockCursor::get_block_model() {
+    if (!chunk) {
+        return 0;
+    }
+    std::shared_lock<ChunkLock> chunk_lock(chunk->lock);
+    return chunk->chunk.get_block_model(pos_mod(position.x, CHUNK_SIZE), pos_mod(position.y, CHUNK_SIZE), pos_mod(position.z, CHUNK_SIZE));
+}
+
+int BlockCursor::get_block_model(ivec3 location) {
+    optional<ChunkData*> c = get_cached_chunk(to_chunk_coords(location));
+    if (!c) {
+        // Outside of the cached chunks, so fallback to the world
+        return world->get_block_model(location.x, location.y, location.z);
+    }
+    if (!c.value()) {
+        return 0;
+    }
+    std::shared_lock<ChunkLock> chunk_lock(c.value()->lock);
+    return c.value()->chunk.get_block_model(pos_mod(location.x, CHUNK_SIZE), pos_mod(location.y, CHUNK_SIZE), pos_mod(location.z, CHUNK_SIZE));
+}
+
+optional<BlockData> BlockCursor::get_block() {
+    if (!chunk) {
+        return nullopt;
+    }
+    std::shared_lock<ChunkLock> chunk_lock(chunk->lock);
+    return chunk->chunk.get_block(pos_mod(position.x, CHUNK_SIZE), pos_mod(position.y, CHUNK_SIZE), pos_mod(position.z, CHUNK_SIZE));
+}
+
+optional<BlockData> BlockCursor::get_block(ivec3 location) {
+    optional<ChunkData*> c = get_cached_chunk(to_chunk_coords(location));
+    if (!c) {
+        // Outside of the cached chunks, so fallback to the world
+        return world->get_block(location.x, location.y, location.z);
+    }
+    if (!c.value()) {
+        return nullopt;
+    }
+    std::shared_lock<ChunkLock> chunk_lock(c.value()->lock);
+    return c.value()->chunk.get_block(pos_mod(location.x, CHUNK_SIZE), pos_mod(location.y, CHUNK_SIZE), pos_mod(location.z, CHUNK_SIZE));
+}
+
+optional<ChunkData*> BlockCursor::get_cached_chunk(ivec3 coords) {
+    if (coords == chunk_coords) {
+        return chunk;
+    }
+    for(int dir = 0; dir < 6; dir++) {
+        if (coords == chunk_coords + neighbor_offsets[dir]) {
+            if (!((neighbors_fetched >> dir) & 1)) {
+                neighbors[dir] = fetch_chunk(coords);
+                neighbors_fetched |= 1 << dir;
+            }
+            return neighbors[dir];
+        }
+    }
+    return nullopt;
+}
+
+ChunkData* BlockCursor::fetch_chunk(ivec3 coords) {
+    return world->get_chunk_data(coords);
+}
@@ -0,0 +1,68 @@
+#ifndef _BLOCK_CURSOR_HPP_
+#define _BLOCK_CURSOR_HPP_
+
+#include "utils.hpp"
+#include "megachunk.hpp"
+
+class World;
+
+/**
+ *\addtogroup VoxelEngine
+ * @{
+ */
+
+/// The BlockCursor class is a position in a @ref World, that caches the chunk it's in, and that chunk's six neighbors
+/**
+ * Every @ref World lookup must find the block's megachunk, and then its chunk. A BlockCursor only does this once per chunk:
+ * reading a block in the cursor's chunk or one of its six neighboring chunks, or moving the cursor to an adjacent block,
+ * does not do any lookups at all. This makes the BlockCursor fast for spatially coherent access, such as raycasts, collisions,
+ * and meshing the border of a chunk. Reading a block outside of that window will simply fall back to a regular lookup.
+ *
+ * Neighboring chunks are only looked up the first time that they're read from.
+ *
+ * A BlockCursor must only be used while holding the world's directory lock, and must not outlive it,
+ * as it will not notice chunks being created or unloaded. It will never load megachunks from disk itself,
+ * so blocks in megachunks that aren't resident read as air. Callers that need them must load them first, see World::load_megachunks_in_box. Each block read holds that chunk's lock in shared mode.
+ */
+
+class BlockCursor {
+public:
+    /// Creates a BlockCursor in the given world, at the given block-coordinates
+    BlockCursor(World* world, ivec3 position);
+
+    /// Get the block-coordinates of the cursor
+    ivec3 get_position();
+    /// Move the cursor to the given block-coordinates
+    void move_to(ivec3 position);
+    /// Move the cursor by the given offset, in blocks
+    void move(ivec3 offset);
+
+    /// Get the block model of the block at the cursor, or 0 if it's an air block
+    int get_block_model();
+    /// Get the block model of the block at the given block-coordinates, or 0 if it's an air block. Does not move the cursor
+    int get_block_model(ivec3 location);
+    /// Get the block at the cursor. Returns nullopt if the block is air, or if its chunk doesn't exist
+    optional<BlockData> get_block();
+    /// Get the block at the given block-coordinates. Returns nullopt if the block is air, or if its chunk doesn't exist. Does not move the cursor
+    optional<BlockData> get_block(ivec3 location);
+private:
+    World* world;
+    ivec3 position;
+
+    // The chunk that the cursor is in, and its chunk-coordinates. NULL if the chunk doesn't exist
+    ivec3 chunk_coords;
+    ChunkData* chunk;
+    // The six neighbors of the chunk, in the same order as Mesh::get_mesh_data. NULL if the chunk doesn't exist
+    ChunkData* neighbors[6];
+    // (neighbors_fetched >> dir) & 1 == 1 if and only if neighbors[dir] has been looked up
+    int neighbors_fetched;
+
+    // Get the chunk with the given chunk-coordinates, if it's within the window of cached chunks
+    optional<ChunkData*> get_cached_chunk(ivec3 coords);
+    // Look up the chunk at the given chunk-coordinates in the world
+    ChunkData* fetch_chunk(ivec3 coords);
+};
+
+/**@}*/
+
+#endif
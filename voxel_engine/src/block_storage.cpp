@@ -0,0 +1,177 @@
+#include "block_storage.hpp"
+
+// Number of palette indices that fit into one 64-bit word
+#define INDICES_PER_WORD(bits) (64 / (bits))
+
+BlockStorage::BlockStorage(int num_blocks) {
+    this->num_blocks = num_blocks;
+    // Every block starts out as air
+    fill(0);
+}
+
+int BlockStorage::get(int index) const {
+    return palette[get_palette_index(index)].block_model;
+}
+
+void BlockStorage::set(int index, int block_model) {
+    int old_palette_index = get_palette_index(index);
+    if (palette[old_palette_index].block_model == block_model) {
+        return;
+    }
+
+    // Release the old palette entry first, so that it can be reused by the new block model
+    palette[old_palette_index].refcount--;
+
+    int new_palette_index = find_or_add_palette_entry(block_model);
+    palette[new_palette_index].refcount++;
+    set_palette_index(index, new_palette_index);
+
+    // If every block is now the same, we can drop the indices entirely
+    if (palette[new_palette_index].refcount == num_blocks) {
+        fill(block_model);
+    }
+}
+
+void BlockStorage::fill(int block_model) {
+    bits_per_block = 0;
+    palette.assign(1, PaletteEntry{block_model, num_blocks});
+    palette.shrink_to_fit();
+    packed_indices.clear();
+    packed_indices.shrink_to_fit();
+}
+
+bool BlockStorage::is_uniform() const {
+    return bits_per_block == 0;
+}
+
+void BlockStorage::unpack(vector<int>& used_palette, uint16_t* palette_indices) const {
+    used_palette.clear();
+    if (bits_per_block == 0) {
+        used_palette.push_back(palette[0].block_model);
+        memset(palette_indices, 0, num_blocks*sizeof(uint16_t));
+        return;
+    }
+
+    // Palette entries that no block uses are skipped, so the used entries get new indices
+    vector<uint16_t> new_palette_indices(palette.size());
+    for(int i = 0; i < (int)palette.size(); i++) {
+        if (palette[i].refcount > 0) {
+            new_palette_indices[i] = used_palette.size();
+            used_palette.push_back(palette[i].block_model);
+        }
+    }
+    for(int i = 0; i < num_blocks; i++) {
+        palette_indices[i] = new_palette_indices[get_palette_index(i)];
+    }
+}
+
+void BlockStorage::pack(const vector<int>& new_palette, const uint16_t* palette_indices) {
+    palette.clear();
+    for(int block_model : new_palette) {
+        palette.push_back(PaletteEntry{block_model, 0});
+    }
+    for(int i = 0; i < num_blocks; i++) {
+        palette[palette_indices[i]].refcount++;
+    }
+    for(PaletteEntry& entry : palette) {
+        if (entry.refcount == num_blocks) {
+            fill(entry.block_model);
+            return;
+        }
+    }
+
+    // Every palette entry is known up-front, so the indices only have to be packed once
+    int new_bits_per_block = 1;
+    while ((1ULL << new_bits_per_block) < palette.size()) {
+        new_bits_per_block *= 2;
+    }
+    if (new_bits_per_block > 16) {
+        dbg("ERROR: Palette cannot exceed 16 bits per block! %d", new_bits_per_block);
+        CRASH();
+    }
+    bits_per_block = new_bits_per_block;
+    packed_indices.assign((num_blocks + INDICES_PER_WORD(bits_per_block) - 1) / INDICES_PER_WORD(bits_per_block), 0);
+    packed_indices.shrink_to_fit();
+    for(int i = 0; i < num_blocks; i++) {
+        set_palette_index(i, palette_indices[i]);
+    }
+}
+
+int BlockStorage::get_bits_per_block() const {
+    return bits_per_block;
+}
+
+int BlockStorage::get_palette_size() const {
+    return palette.size();
+}
+
+size_t BlockStorage::memory_usage() const {
+    return sizeof(BlockStorage)
+         + palette.capacity()*sizeof(PaletteEntry)
+         + packed_indices.capacity()*sizeof(uint64_t);
+}
+
+int BlockStorage::get_palette_index(int index) const {
+    // Uniform storage only has a single palette entry
+    if (bits_per_block == 0) {
+        return 0;
+    }
+    int word = index / INDICES_PER_WORD(bits_per_block);
+    int shift = (index % INDICES_PER_WORD(bits_per_block)) * bits_per_block;
+    uint64_t mask = (1ULL << bits_per_block) - 1;
+    return (packed_indices[word] >> shift) & mask;
+}
+
+void BlockStorage::set_palette_index(int index, int palette_index) {
+    int word = index / INDICES_PER_WORD(bits_per_block);
+    int shift = (index % INDICES_PER_WORD(bits_per_block)) * bits_per_block;
+    uint64_t mask = (1ULL << bits_per_block) - 1;
+    packed_indices[word] = (packed_indices[word] & ~(mask << shift)) | ((uint64_t)palette_index << shift);
+}
+
+int BlockStorage::find_or_add_palette_entry(int block_model) {
+    // Palettes are typically only a few entries long, so a linear scan is fastest
+    int free_palette_index = -1;
+    for(int i = 0; i < (int)palette.size(); i++) {
+        if (palette[i].refcount > 0) {
+            if (palette[i].block_model == block_model) {
+                return i;
+            }
+        } else if (free_palette_index < 0) {
+            free_palette_index = i;
+        }
+    }
+
+    // Reuse a palette entry that no block is using anymore
+    if (free_palette_index >= 0) {
+        palette[free_palette_index].block_model = block_model;
+        return free_palette_index;
+    }
+
+    // Otherwise, make a new palette entry, repacking if it won't fit in the current number of bits
+    if (palette.size() >= (1ULL << bits_per_block)) {
+        repack(bits_per_block == 0 ? 1 : bits_per_block * 2);
+    }
+    palette.push_back(PaletteEntry{block_model, 0});
+    return palette.size() - 1;
+}
+
+void BlockStorage::repack(int new_bits_per_block) {
+    if (new_bits_per_block > 16) {
+        dbg("ERROR: Palette cannot exceed 16 bits per block! %d", new_bits_per_block);
+        CRASH();
+    }
+
+    vector<int> palette_indices(num_blocks);
+    for(int i = 0; i < num_blocks; i++) {
+        palette_indices[i] = get_palette_index(i);
+    }
+
+    bits_per_block = new_bits_per_block;
+    packed_indices.assign((num_blocks + INDICES_PER_WORD(bits_per_block) - 1) / INDICES_PER_WORD(bits_per_block), 0);
+    packed_indices.shrink_to_fit();
+
+    for(int i = 0; i < num_blocks; i++) {
+        set_palette_index(i, palette_indices[i]);
+    }
+}
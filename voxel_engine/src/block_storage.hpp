@@ -0,0 +1,79 @@
+#ifndef _BLOCK_STORAGE_HPP_
+#define _BLOCK_STORAGE_HPP_
+
+#include "utils.hpp"
+
+/**
+ *\addtogroup VoxelEngine
+ * @{
+ */
+
+/// The BlockStorage class stores the block models of a fixed number of blocks, using a palette and bit-packed indices
+/**
+ * Each distinct block model is stored only once, in the palette.
+ * Every block then only stores the index of its palette entry,
+ * packed into 1, 2, 4, 8, or 16 bits depending on how many palette entries there are.
+ * As most chunks only contain a handful of different blocks,
+ * this uses a small fraction of the memory of a dense array of block models.
+ *
+ * When a block is written with a block model that is not yet in the palette,
+ * the palette grows, and the indices will be repacked with more bits if needed.
+ * Palette entries that are no longer used by any block will be reused.
+ *
+ * If every block is the same, then the BlockStorage is uniform. A uniform BlockStorage uses zero bits per block,
+ * and does not allocate any indices at all, until the first write of a different block model.
+ * When a write makes every block the same again, the BlockStorage will return to being uniform.
+ */
+
+class BlockStorage {
+public:
+    /// Creates a BlockStorage of num_blocks air blocks
+    BlockStorage(int num_blocks);
+
+    /// Get the block model of the block at the given index
+    int get(int index) const;
+    /// Set the block at the given index to the given block model
+    void set(int index, int block_model);
+    /// Set every block to the given block model, making the BlockStorage uniform
+    void fill(int block_model);
+
+    /// True if every block has the same block model. If so, that block model is given by get(0)
+    bool is_uniform() const;
+
+    /// Write the block models that are in use into palette, and the index into palette of every block into palette_indices
+    void unpack(vector<int>& palette, uint16_t* palette_indices) const;
+    /// Replace every block, given a palette of block models and the index into it of every block
+    /**
+     * Every palette index must be less than the size of the palette
+     */
+    void pack(const vector<int>& palette, const uint16_t* palette_indices);
+
+    /// The number of bits used to store each palette index
+    int get_bits_per_block() const;
+    /// The number of entries in the palette, including unused entries
+    int get_palette_size() const;
+    /// The number of bytes of memory used by this BlockStorage, including its heap allocations
+    size_t memory_usage() const;
+private:
+    struct PaletteEntry {
+        int block_model;
+        // Number of blocks that use this palette entry. Zero if the entry is free to be reused
+        int refcount;
+    };
+
+    int num_blocks;
+    int bits_per_block;
+    vector<PaletteEntry> palette;
+    vector<uint64_t> packed_indices;
+
+    int get_palette_index(int index) const;
+    void set_palette_index(int index, int palette_index);
+    // Finds or creates a palette entry for the given block model, and returns its palette index
+    int find_or_add_palette_entry(int block_model);
+    // Repack all of the palette indices using the new number of bits per block
+    void repack(int new_bits_per_block);
+};
+
+/**@}*/
+
+#endif
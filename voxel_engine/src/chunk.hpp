@@ -3,10 +3,12 @@
 
 #include "utils.hpp"
 #include "block.hpp"
+#include "block_storage.hpp"
 #include "texture_atlasser.hpp"
 #include "gl_utils.hpp"
 
 #define SERIALIZED_CHUNK_SIZE (CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE*3)
+#define SERIALIZED_UNIFORM_CHUNK_SIZE 3
 
 /**
  *\addtogroup VoxelEngine
@@ -16,60 +18,163 @@
 /// The amount of blocks wide a @ref Chunk is in any direction
 #define CHUNK_SIZE 16
 
-/// A function that maps block-coordinate into BlockData*
-using fn_get_block = function<BlockData*(int, int, int)>;
+struct ChunkMesh;
+
+/// A function that maps block-coordinate into a block model, where 0 represents an air block
+using fn_get_block = function<int(int, int, int)>;
+
+/// The blocks of a @ref Chunk, unpacked into a palette and the palette index of every block
+/**
+ * This is the form that every @ref ChunkCodec encodes from and decodes into.
+ * A chunk's @ref BlockStorage is already paletted, so unpacking and packing a chunk never searches the palette per block.
+ */
+struct UnpackedChunk {
+    /// The distinct block models of the chunk
+    vector<int> palette;
+    /// The index into palette of every block, by block index
+    uint16_t palette_indices[CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE];
+    /// The break amount of every damaged block by block index, in 256ths
+    vector<pair<int, byte>> break_amounts;
+};
+
+/// The block contents of a @ref Chunk, which may be shared between the chunk and any number of @ref ChunkSnapshot "ChunkSnapshots"
+struct ChunkContents {
+    /// Initialize the contents of a chunk of all airblocks
+    ChunkContents();
+    /// Copy the blocks of other. The copy is not shared with any snapshots
+    ChunkContents(const ChunkContents& other);
+
+    /// The block model of every block in the chunk
+    BlockStorage blocks;
+    /// The break amount of every damaged block in the chunk, by block index.
+    /// Only the few blocks currently being mined are damaged, so this is almost always empty
+    vector<pair<int, float>> break_amounts;
+
+    /// Get the break amount of the block at the given block index
+    float get_break_amount(int index) const;
+    /// Unpack the contents into the given @ref UnpackedChunk
+    void unpack(UnpackedChunk& chunk) const;
+
+    /// The number of @ref ChunkSnapshot "ChunkSnapshots" that share these contents
+    mutable std::atomic<int> num_snapshots{0};
+};
+
+/// A read-only view of the contents of a @ref Chunk, at the moment that the snapshot was taken
+/**
+ * Taking a snapshot with @ref Chunk::snapshot is O(1), as the snapshot shares the chunk's storage.
+ * The next write to the chunk will then clone that chunk's storage, so that the snapshot never changes.
+ *
+ * A ChunkSnapshot is safe to read, copy and destroy from any thread, while the main thread continues to modify the chunk.
+ */
+
+class ChunkSnapshot {
+public:
+    /// Take a snapshot of contents that may not belong to any @ref Chunk, such as the chunks built by tests and benchmarks
+    ChunkSnapshot(shared_ptr<const ChunkContents> contents);
+    /// Copies a snapshot, sharing the same contents
+    ChunkSnapshot(const ChunkSnapshot& other);
+    /// Copies a snapshot, sharing the same contents
+    ChunkSnapshot& operator=(const ChunkSnapshot& other);
+    /// Releases the snapshot's share of the contents
+    ~ChunkSnapshot();
+
+    /// Get the block at the given x, y, z, or nullopt if it's an air block. Each coordinate must range between 0 and BLOCK_SIZE-1
+    optional<BlockData> get_block(int x, int y, int z) const;
+    /// Get only the model of the block at the given x, y, z, or 0 if it's an air block. Each coordinate must range between 0 and BLOCK_SIZE-1
+    int get_block_model(int x, int y, int z) const;
+    /// True if every block in the snapshot is the same, and undamaged
+    bool is_uniform() const;
+    /// Unpack the snapshot into the given @ref UnpackedChunk, so that it can be encoded with a @ref ChunkCodec
+    void unpack(UnpackedChunk& chunk) const;
+private:
+    shared_ptr<const ChunkContents> contents;
+};
 
 /// A collection of @ref CHUNK_SIZE x @ref CHUNK_SIZE x @ref CHUNK_SIZE blocks
 
 class Chunk {
 public:
-    /// All of the blockdata for this chunk
-    BlockData blocks[CHUNK_SIZE][CHUNK_SIZE][CHUNK_SIZE];
-
     /// Initialize a chunk of all airblocks.
     Chunk();
 
     /// Set a block to a particular blocktype. Each coordinate must range between 0 and BLOCK_SIZE-1
     void set_block(int x, int y, int z, int model);
 
+    /// Set a block to the given blockdata. Each coordinate must range between 0 and BLOCK_SIZE-1
+    void set_block(int x, int y, int z, const BlockData& data);
+
+    /// Set every block in the chunk to the given blocktype, removing all damage
+    void fill(int model);
+
     /// Get the block at the given x, y, z. Each coordinate must range between 0 and BLOCK_SIZE-1
-    BlockData* get_block(int x, int y, int z);
+    /**
+     * Returns nullopt if the block is an air block.
+     */
+    optional<BlockData> get_block(int x, int y, int z);
+
+    /// Get only the model of the block at the given x, y, z, or 0 if it's an air block. Each coordinate must range between 0 and BLOCK_SIZE-1
+    int get_block_model(int x, int y, int z);
+
+    /// Get one plus the y of the topmost non-air block at the given x and z, or 0 if every block there is air. Each coordinate must range between 0 and BLOCK_SIZE-1
+    int get_column_height(int x, int z);
+
+    /// True if every block in this chunk is the same, and undamaged
+    bool is_uniform();
+
+    /// Take a read-only snapshot of the current contents of the chunk, in O(1)
+    ChunkSnapshot snapshot();
 
-    /// Render the chunk
+    /// Upload the given mesh of this chunk, as built by a @ref ChunkMesher
+    /**
+     * @param mesh The mesh to upload
+     * @param texture_atlas The texture atlas that the mesh's bitmap IDs refer to
+     * @param cache_version The @ref get_cache_version of the chunk when the contents that were meshed were snapshotted.
+     * The rendering data is only marked as cached if the cache hasn't been invalidated since then.
+     * Otherwise, the mesh is still drawn until the chunk is meshed again.
+     */
+    void upload_mesh(const ChunkMesh& mesh, const TextureAtlasser& texture_atlas, int cache_version);
+
+    /// Render the most recently uploaded mesh of the chunk, even if the cache is out of date. Nothing is rendered if no mesh has ever been uploaded
     /**
      * @param P The projection matrix to use for rendering
      * @param V The view matrix to use for rendering
      * @param location The location in chunk-coordinates for where to render it (Not in block-coordinates)
-     * @param texture_atlas The texture atlas to use for rendering each block
-     * @param get_block The function used to get blockdata from neighboring blocks in block-coordinates
-     * @param dont_rerender If true, do not rerender this chunk, even if the cache is out of date.
-     * Simply render the out-of-date version of this chunk, and if there is no cache at all, then do not render the chunk.
-     * This is to ensure that the render() function returns quickly, if needed, as rerendering a chunk takes a lengthy 5-12ms.
      */
-    void render(const mat4& P, const mat4& V, ivec3 location, const TextureAtlasser& texture_atlas, fn_get_block get_block, bool dont_rerender);
-
-    /// Serialize the chunk into a byte array
-    pair<byte*, int> serialize();
+    void render(const mat4& P, const mat4& V, ivec3 location);
 
-    /// Deserialize a chunk from a byte array
-    void deserialize(byte* buffer, int size);
+    /// Replace every block of the chunk with the blocks of the given @ref UnpackedChunk, as decoded by a @ref ChunkCodec
+    void pack(const UnpackedChunk& chunk);
 
-    /// True if the rendering data is cached (Ie, render() will not trigger a rerender)
+    /// True if the rendering data is cached (Ie, the uploaded mesh is up-to-date)
     bool is_cached();
 
-    /// Invalidate the cache, so that the next call to render() will trigger a rerender. This function must be called if any blockdata changes.
+    /// Invalidate the cache, so that the chunk will be meshed again. This function must be called if any blockdata changes, or any neighboring block changes.
     void invalidate_cache();
+    /// Get the number of times that the cache has been invalidated
+    int get_cache_version();
+
+    /// The number of bytes of memory used by this chunk, including its heap allocations
+    size_t memory_usage();
 private:
+    // The blocks of this chunk. They're shared with every snapshot of this chunk, so they must only be modified through mutable_contents()
+    shared_ptr<ChunkContents> contents;
+    // Get the contents for writing, first cloning them if they're shared with a snapshot
+    ChunkContents& mutable_contents();
+    void set_break_amount(int index, float break_amount);
+
+#ifndef VOXELCRAFT_HEADLESS
+    // Headless builds never upload a mesh, and don't link OpenGL to free the buffer with
     GLArrayBuffer opengl_vertex_buffer;
-    GLArrayBuffer opengl_uv_buffer;
-    GLArrayBuffer opengl_break_amount_buffer;
-    
+#endif
+
     // Render a chunk efficiently using the cache. Requires is_cached() to be equal to true
-    void cached_render(const mat4& P, const mat4& V);
+    void cached_render(const mat4& P, const mat4& V, ivec3 bottom_left);
     // Cache
     GLuint opengl_texture_atlas_cache;
-    int num_triangles_cache = 0;
+    vec4 atlas_grid_layout_cache;
+    int num_quads_cache = 0;
     bool chunk_rendering_cached = false;
+    int cache_version = 0;
     bool has_ever_cached = false;
 };
 
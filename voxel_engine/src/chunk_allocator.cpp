@@ -0,0 +1,161 @@
+#include "chunk_allocator.hpp"
+#include "megachunk.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+static_assert(CHUNKS_PER_PAGE == 64, "ChunkAllocator pages use a 64-bit allocation mask");
+
+// Size of a page, rounded up to a multiple of the 4KB OS page size
+#define PAGE_ALIGNMENT 4096
+#define PAGE_SIZE (((CHUNKS_PER_PAGE*sizeof(ChunkData) + PAGE_ALIGNMENT - 1) / PAGE_ALIGNMENT) * PAGE_ALIGNMENT)
+
+// Allocators of different worlds may be used from different threads, so the statistics are atomic
+static struct {
+    std::atomic<int> num_chunks;
+    std::atomic<int> num_pages;
+    std::atomic<size_t> bytes_reserved;
+    std::atomic<long long> total_allocations;
+    std::atomic<long long> total_frees;
+    std::atomic<long long> total_pages_released;
+} statistics = {};
+
+// Reserve memory for a page directly from the OS
+static byte* os_alloc_page() {
+#ifdef _WIN32
+    void* memory = VirtualAlloc(NULL, PAGE_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!memory) {
+#else
+    void* memory = mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+#endif
+        dbg("ERROR: Failed to allocate ChunkAllocator page!");
+        CRASH();
+    }
+    return (byte*)memory;
+}
+
+// Release the memory of a page back to the OS
+static void os_free_page(byte* memory) {
+#ifdef _WIN32
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    munmap(memory, PAGE_SIZE);
+#endif
+}
+
+ChunkAllocator::ChunkAllocator() {
+}
+
+ChunkAllocator::~ChunkAllocator() {
+    for(Page& page : pages) {
+        release_page(page);
+    }
+}
+
+ChunkAllocator::ChunkAllocator(ChunkAllocator&& other) noexcept {
+    std::swap(pages, other.pages);
+}
+
+ChunkAllocator& ChunkAllocator::operator=(ChunkAllocator&& other) noexcept {
+    std::swap(pages, other.pages);
+    return *this;
+}
+
+int ChunkAllocator::alloc() {
+    // Find the first page with a free slot
+    int page_index = -1;
+    for(int i = 0; i < (int)pages.size(); i++) {
+        if (pages[i].allocated_mask != ~0ULL) {
+            page_index = i;
+            break;
+        }
+    }
+    if (page_index == -1) {
+        pages.push_back(Page{nullptr, 0});
+        page_index = pages.size() - 1;
+    }
+
+    Page& page = pages[page_index];
+    if (!page.memory) {
+        page.memory = os_alloc_page();
+        statistics.num_pages++;
+        statistics.bytes_reserved += PAGE_SIZE;
+    }
+
+    // Find the first free slot in that page
+    int slot = 0;
+    while ((page.allocated_mask >> slot) & 1) {
+        slot++;
+    }
+    page.allocated_mask |= 1ULL << slot;
+
+    // Construct the ChunkData in-place
+    new (page.memory + slot*sizeof(ChunkData)) ChunkData();
+
+    statistics.num_chunks++;
+    statistics.total_allocations++;
+
+    return page_index*CHUNKS_PER_PAGE + slot;
+}
+
+ChunkData* ChunkAllocator::get(int chunkdata_id) {
+    Page& page = pages[chunkdata_id / CHUNKS_PER_PAGE];
+    return (ChunkData*)(page.memory + (chunkdata_id % CHUNKS_PER_PAGE)*sizeof(ChunkData));
+}
+
+void ChunkAllocator::free(int chunkdata_id) {
+    Page& page = pages[chunkdata_id / CHUNKS_PER_PAGE];
+    int slot = chunkdata_id % CHUNKS_PER_PAGE;
+    if (!((page.allocated_mask >> slot) & 1)) {
+        dbg("ERROR: Freeing a ChunkData that isn't allocated! %d", chunkdata_id);
+        return;
+    }
+
+    get(chunkdata_id)->~ChunkData();
+    page.allocated_mask &= ~(1ULL << slot);
+
+    statistics.num_chunks--;
+    statistics.total_frees++;
+
+    if (page.allocated_mask == 0) {
+        release_page(page);
+        statistics.total_pages_released++;
+    }
+}
+
+void ChunkAllocator::release_page(Page& page) {
+    if (!page.memory) {
+        return;
+    }
+    // Destroy any ChunkData that are still allocated
+    for(int slot = 0; slot < CHUNKS_PER_PAGE; slot++) {
+        if ((page.allocated_mask >> slot) & 1) {
+            ((ChunkData*)(page.memory + slot*sizeof(ChunkData)))->~ChunkData();
+            statistics.num_chunks--;
+            statistics.total_frees++;
+        }
+    }
+    page.allocated_mask = 0;
+
+    os_free_page(page.memory);
+    page.memory = nullptr;
+    statistics.num_pages--;
+    statistics.bytes_reserved -= PAGE_SIZE;
+}
+
+ChunkAllocatorStatistics ChunkAllocator::get_statistics() {
+    return ChunkAllocatorStatistics{
+        statistics.num_chunks,
+        statistics.num_pages,
+        statistics.bytes_reserved,
+        statistics.total_allocations,
+        statistics.total_frees,
+        statistics.total_pages_released,
+    };
+}
@@ -0,0 +1,81 @@
+#ifndef _CHUNK_ALLOCATOR_HPP_
+#define _CHUNK_ALLOCATOR_HPP_
+
+#include "utils.hpp"
+
+class ChunkData;
+
+/**
+ *\addtogroup VoxelEngine
+ * @{
+ */
+
+/// Statistics over every @ref ChunkAllocator, as given by @ref ChunkAllocator::get_statistics
+struct ChunkAllocatorStatistics {
+    /// The number of @ref ChunkData that are currently allocated
+    int num_chunks;
+    /// The number of pages that are currently reserved from the OS
+    int num_pages;
+    /// The number of bytes that are currently reserved from the OS
+    size_t bytes_reserved;
+    /// The total number of @ref ChunkData allocations ever made
+    long long total_allocations;
+    /// The total number of @ref ChunkData frees ever made
+    long long total_frees;
+    /// The total number of empty pages that have been released back to the OS
+    long long total_pages_released;
+};
+
+/// The number of @ref ChunkData slots in a single page of a @ref ChunkAllocator
+#define CHUNKS_PER_PAGE 64
+
+/// The ChunkAllocator class is a slab allocator for @ref ChunkData
+/**
+ * @ref ChunkData are allocated out of pages of @ref CHUNKS_PER_PAGE slots each,
+ * which are reserved directly from the OS. Each @ref MegaChunk has its own ChunkAllocator,
+ * so that all of the chunks of a megachunk are contiguous in memory.
+ *
+ * A new allocation is constructed in-place in the lowest free slot, to keep the pages densely packed.
+ * Freeing a @ref ChunkData will destroy it in-place, and once every slot in a page is free,
+ * the whole page is released back to the OS.
+ */
+
+class ChunkAllocator {
+public:
+    /// Creates a ChunkAllocator with no pages
+    ChunkAllocator();
+    /// Frees every @ref ChunkData that is still allocated, and releases all pages
+    ~ChunkAllocator();
+    /// ChunkAllocators cannot be copied, as they own their pages
+    ChunkAllocator(const ChunkAllocator& other) = delete;
+    /// ChunkAllocators cannot be copied, as they own their pages
+    ChunkAllocator& operator=(const ChunkAllocator& other) = delete;
+    /// Moves the pages of a ChunkAllocator
+    ChunkAllocator(ChunkAllocator&& other) noexcept;
+    /// Moves the pages of a ChunkAllocator
+    ChunkAllocator& operator=(ChunkAllocator&& other) noexcept;
+
+    /// Allocate a new blank @ref ChunkData, and return its chunkdata ID
+    int alloc();
+    /// Get the @ref ChunkData from the given chunkdata ID
+    ChunkData* get(int chunkdata_id);
+    /// Free the @ref ChunkData with the given chunkdata ID
+    void free(int chunkdata_id);
+
+    /// Get statistics over every ChunkAllocator
+    static ChunkAllocatorStatistics get_statistics();
+private:
+    struct Page {
+        // nullptr if the page has been released
+        byte* memory;
+        // (allocated_mask >> i) & 1 == 1 if and only if the i'th slot has been allocated
+        uint64_t allocated_mask;
+    };
+    vector<Page> pages;
+
+    void release_page(Page& page);
+};
+
+/**@}*/
+
+#endif
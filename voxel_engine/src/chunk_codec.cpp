@@ -0,0 +1,469 @@
+#include "chunk_codec.hpp"
+
+#define NUM_BLOCKS (CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE)
+// Index of a block within an UnpackedChunk, which is the same as its index within a chunk's BlockStorage
+#define BLOCK_INDEX(x, y, z) (((x)*CHUNK_SIZE + (y))*CHUNK_SIZE + (z))
+
+static void write_u16(byte*& cur, uint16_t value) {
+    cur[0] = value % 256;
+    cur[1] = value / 256;
+    cur += 2;
+}
+
+static uint16_t read_u16(const byte*& cur) {
+    uint16_t value = cur[0] + cur[1]*256;
+    cur += 2;
+    return value;
+}
+
+static void write_u32(byte*& cur, uint32_t value) {
+    write_u16(cur, value % 65536);
+    write_u16(cur, value / 65536);
+}
+
+static uint32_t read_u32(const byte*& cur) {
+    uint32_t low = read_u16(cur);
+    return low + read_u16(cur)*65536u;
+}
+
+/*
+ * Shared by the palette codecs.
+ * The palette is stored as [u16 palette size][u16 block model]...
+ * and the damaged blocks as [u16 number of damaged blocks]([u16 block index][u8 break amount])...
+ */
+
+static int get_palette_encoded_size(const UnpackedChunk& chunk) {
+    return 2 + 2*chunk.palette.size() + 2 + 3*chunk.break_amounts.size();
+}
+
+static void write_palette(byte*& cur, const UnpackedChunk& chunk) {
+    write_u16(cur, chunk.palette.size());
+    for(int block_model : chunk.palette) {
+        write_u16(cur, block_model);
+    }
+}
+
+static bool read_palette(const byte*& cur, const byte* end, UnpackedChunk& chunk) {
+    if (end - cur < 2) {
+        return false;
+    }
+    int palette_size = read_u16(cur);
+    if (palette_size == 0 || palette_size > NUM_BLOCKS || end - cur < 2*palette_size) {
+        return false;
+    }
+    chunk.palette.resize(palette_size);
+    for(int i = 0; i < palette_size; i++) {
+        chunk.palette[i] = read_u16(cur);
+    }
+    return true;
+}
+
+static void write_break_amounts(byte*& cur, const UnpackedChunk& chunk) {
+    write_u16(cur, chunk.break_amounts.size());
+    for(auto& p : chunk.break_amounts) {
+        write_u16(cur, p.first);
+        *cur++ = p.second;
+    }
+}
+
+static bool read_break_amounts(const byte*& cur, const byte* end, UnpackedChunk& chunk) {
+    if (end - cur < 2) {
+        return false;
+    }
+    int num_damaged = read_u16(cur);
+    if (end - cur != 3*num_damaged) {
+        return false;
+    }
+    chunk.break_amounts.resize(num_damaged);
+    for(auto& p : chunk.break_amounts) {
+        p.first = read_u16(cur);
+        p.second = *cur++;
+        if (p.first >= NUM_BLOCKS) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * RAW
+ */
+
+static int raw_get_encoded_size(const UnpackedChunk& chunk) {
+    if (chunk.palette.size() == 1 && chunk.break_amounts.empty()) {
+        return SERIALIZED_UNIFORM_CHUNK_SIZE;
+    }
+    return SERIALIZED_CHUNK_SIZE;
+}
+
+// First 2 bytes of each block is block_id, 3rd byte is break_amount.
+// Blocks are stored in z-major order, and uniform chunks only write those 3 bytes once, for the whole chunk
+static int raw_encode(const UnpackedChunk& chunk, byte* buffer) {
+    if (raw_get_encoded_size(chunk) == SERIALIZED_UNIFORM_CHUNK_SIZE) {
+        buffer[0] = (chunk.palette[0] >> 8) % 256;
+        buffer[1] = chunk.palette[0] % 256;
+        buffer[2] = 0;
+        return SERIALIZED_UNIFORM_CHUNK_SIZE;
+    }
+    for(int i = 0; i < CHUNK_SIZE; i++) {
+        for(int j = 0; j < CHUNK_SIZE; j++) {
+            for(int k = 0; k < CHUNK_SIZE; k++) {
+                int block_model = chunk.palette[chunk.palette_indices[BLOCK_INDEX(i, j, k)]];
+                int index = (k*CHUNK_SIZE*CHUNK_SIZE + j*CHUNK_SIZE + i)*3;
+                buffer[index] = (block_model >> 8) % 256;
+                buffer[index + 1] = block_model % 256;
+                buffer[index + 2] = 0;
+            }
+        }
+    }
+    for(auto& p : chunk.break_amounts) {
+        int i = p.first / (CHUNK_SIZE*CHUNK_SIZE);
+        int j = (p.first / CHUNK_SIZE) % CHUNK_SIZE;
+        int k = p.first % CHUNK_SIZE;
+        buffer[(k*CHUNK_SIZE*CHUNK_SIZE + j*CHUNK_SIZE + i)*3 + 2] = p.second;
+    }
+    return SERIALIZED_CHUNK_SIZE;
+}
+
+static bool raw_decode(const byte* buffer, int size, UnpackedChunk& chunk) {
+    chunk.break_amounts.clear();
+    if (size == SERIALIZED_UNIFORM_CHUNK_SIZE) {
+        // Uniform chunks are never damaged
+        chunk.palette.assign(1, buffer[0]*256 + buffer[1]);
+        memset(chunk.palette_indices, 0, sizeof(chunk.palette_indices));
+        return true;
+    }
+    if (size != SERIALIZED_CHUNK_SIZE) {
+        return false;
+    }
+
+    chunk.palette.clear();
+    // Map from every 16-bit block model to its palette index, or -1. Only the entries of the palette are ever set,
+    // and they're reset at the end, so the table never has to be cleared as a whole
+    thread_local vector<int> palette_lookup(1 << 16, -1);
+    for(int i = 0; i < CHUNK_SIZE; i++) {
+        for(int j = 0; j < CHUNK_SIZE; j++) {
+            for(int k = 0; k < CHUNK_SIZE; k++) {
+                int index = (k*CHUNK_SIZE*CHUNK_SIZE + j*CHUNK_SIZE + i)*3;
+                int block_model = buffer[index]*256 + buffer[index + 1];
+                int& palette_index = palette_lookup[block_model];
+                if (palette_index < 0) {
+                    palette_index = chunk.palette.size();
+                    chunk.palette.push_back(block_model);
+                }
+                chunk.palette_indices[BLOCK_INDEX(i, j, k)] = palette_index;
+                if (buffer[index + 2]) {
+                    chunk.break_amounts.push_back({BLOCK_INDEX(i, j, k), buffer[index + 2]});
+                }
+            }
+        }
+    }
+    for(int block_model : chunk.palette) {
+        palette_lookup[block_model] = -1;
+    }
+    return true;
+}
+
+/*
+ * PALETTE_RLE
+ *
+ * After the palette, [u16 number of runs]([u16 run length][palette index]...)...
+ * where each palette index is one byte if the palette has at most 256 entries, and two bytes otherwise.
+ * Terrain is mostly horizontal layers, so blocks are visited in y-major order to make the runs as long as possible
+ */
+
+#define FOR_EACH_BLOCK_Y_MAJOR(index) \
+    for(int y = 0; y < CHUNK_SIZE; y++) \
+        for(int x = 0; x < CHUNK_SIZE; x++) \
+            for(int z = 0, index = BLOCK_INDEX(x, y, z); z < CHUNK_SIZE; z++, index++)
+
+static int palette_rle_get_encoded_size(const UnpackedChunk& chunk) {
+    int num_runs = 0;
+    int last_palette_index = -1;
+    FOR_EACH_BLOCK_Y_MAJOR(index) {
+        if (chunk.palette_indices[index] != last_palette_index) {
+            num_runs++;
+            last_palette_index = chunk.palette_indices[index];
+        }
+    }
+    int index_size = chunk.palette.size() <= 256 ? 1 : 2;
+    return get_palette_encoded_size(chunk) + 2 + num_runs*(2 + index_size);
+}
+
+static int palette_rle_encode(const UnpackedChunk& chunk, byte* buffer) {
+    byte* cur = buffer;
+    write_palette(cur, chunk);
+    bool wide_indices = chunk.palette.size() > 256;
+
+    // The number of runs is only known at the end
+    byte* num_runs_location = cur;
+    cur += 2;
+    int num_runs = 0;
+    int run_palette_index = -1;
+    int run_length = 0;
+    auto write_run = [&]() {
+        write_u16(cur, run_length);
+        if (wide_indices) {
+            write_u16(cur, run_palette_index);
+        } else {
+            *cur++ = run_palette_index;
+        }
+        num_runs++;
+    };
+    FOR_EACH_BLOCK_Y_MAJOR(index) {
+        if (chunk.palette_indices[index] == run_palette_index) {
+            run_length++;
+            continue;
+        }
+        if (run_length > 0) {
+            write_run();
+        }
+        run_palette_index = chunk.palette_indices[index];
+        run_length = 1;
+    }
+    write_run();
+    write_u16(num_runs_location, num_runs);
+
+    write_break_amounts(cur, chunk);
+    return cur - buffer;
+}
+
+static bool palette_rle_decode(const byte* buffer, int size, UnpackedChunk& chunk) {
+    const byte* cur = buffer;
+    const byte* end = buffer + size;
+    if (!read_palette(cur, end, chunk) || end - cur < 2) {
+        return false;
+    }
+    bool wide_indices = chunk.palette.size() > 256;
+    int num_runs = read_u16(cur);
+    if (end - cur < num_runs*(wide_indices ? 4 : 3)) {
+        return false;
+    }
+
+    // Expand the runs in y-major order, as they were written
+    int run_length = 0;
+    int run_palette_index = 0;
+    FOR_EACH_BLOCK_Y_MAJOR(index) {
+        if (run_length == 0) {
+            if (num_runs-- == 0) {
+                return false;
+            }
+            run_length = read_u16(cur);
+            run_palette_index = wide_indices ? read_u16(cur) : *cur++;
+            if (run_length == 0 || run_palette_index >= (int)chunk.palette.size()) {
+                return false;
+            }
+        }
+        chunk.palette_indices[index] = run_palette_index;
+        run_length--;
+    }
+    if (run_length != 0 || num_runs != 0) {
+        return false;
+    }
+    return read_break_amounts(cur, end, chunk);
+}
+
+/*
+ * PALETTE_BITPACKED
+ *
+ * After the palette, [u8 bits per block] and then the palette index of every block in block index order,
+ * packed least significant bits first. The bits per block is 1, 2, 4, 8 or 16, so that an index never straddles two bytes,
+ * or 0 if the palette only has a single entry
+ */
+
+static int get_bits_per_block(const UnpackedChunk& chunk) {
+    if (chunk.palette.size() == 1) {
+        return 0;
+    }
+    int bits_per_block = 1;
+    while ((1ULL << bits_per_block) < chunk.palette.size()) {
+        bits_per_block *= 2;
+    }
+    return bits_per_block;
+}
+
+static int palette_bitpacked_get_encoded_size(const UnpackedChunk& chunk) {
+    return get_palette_encoded_size(chunk) + 1 + NUM_BLOCKS*get_bits_per_block(chunk)/8;
+}
+
+static int palette_bitpacked_encode(const UnpackedChunk& chunk, byte* buffer) {
+    byte* cur = buffer;
+    write_palette(cur, chunk);
+    int bits_per_block = get_bits_per_block(chunk);
+    *cur++ = bits_per_block;
+
+    if (bits_per_block == 16) {
+        for(int i = 0; i < NUM_BLOCKS; i++) {
+            write_u16(cur, chunk.palette_indices[i]);
+        }
+    } else if (bits_per_block > 0) {
+        int indices_per_byte = 8 / bits_per_block;
+        for(int i = 0; i < NUM_BLOCKS; i += indices_per_byte) {
+            byte packed = 0;
+            for(int j = 0; j < indices_per_byte; j++) {
+                packed |= chunk.palette_indices[i + j] << (j*bits_per_block);
+            }
+            *cur++ = packed;
+        }
+    }
+
+    write_break_amounts(cur, chunk);
+    return cur - buffer;
+}
+
+static bool palette_bitpacked_decode(const byte* buffer, int size, UnpackedChunk& chunk) {
+    const byte* cur = buffer;
+    const byte* end = buffer + size;
+    if (!read_palette(cur, end, chunk) || end - cur < 1) {
+        return false;
+    }
+    int bits_per_block = *cur++;
+    if (bits_per_block != get_bits_per_block(chunk) || end - cur < NUM_BLOCKS*bits_per_block/8) {
+        return false;
+    }
+
+    if (bits_per_block == 0) {
+        memset(chunk.palette_indices, 0, sizeof(chunk.palette_indices));
+    } else if (bits_per_block == 16) {
+        for(int i = 0; i < NUM_BLOCKS; i++) {
+            chunk.palette_indices[i] = read_u16(cur);
+        }
+    } else {
+        int indices_per_byte = 8 / bits_per_block;
+        int mask = (1 << bits_per_block) - 1;
+        for(int i = 0; i < NUM_BLOCKS; i += indices_per_byte) {
+            byte packed = *cur++;
+            for(int j = 0; j < indices_per_byte; j++) {
+                chunk.palette_indices[i + j] = (packed >> (j*bits_per_block)) & mask;
+            }
+        }
+    }
+    // Indices that fit in the bits per block may still be past the end of the palette
+    for(int i = 0; i < NUM_BLOCKS; i++) {
+        if (chunk.palette_indices[i] >= (int)chunk.palette.size()) {
+            return false;
+        }
+    }
+    return read_break_amounts(cur, end, chunk);
+}
+
+/*
+ * GENERATOR_DELTA
+ *
+ * [u32 generator id][u32 low bits of the seed][u32 high bits of the seed]
+ * [u16 number of edited blocks]([u16 block index][u16 block model])...
+ * and then the damaged blocks, as for the palette codecs. Generators never damage blocks, so every damaged block is an edit
+ */
+
+#define GENERATOR_DELTA_HEADER_SIZE (4 + 4 + 4)
+
+int encode_generator_delta(const UnpackedChunk& chunk, const ChunkGenerator& generator, ivec3 chunk_coords, int max_size, byte* buffer) {
+    thread_local int generated[NUM_BLOCKS];
+    generator.generate(chunk_coords, generator.seed, generated);
+
+    int num_edits = 0;
+    for(int i = 0; i < NUM_BLOCKS; i++) {
+        if (chunk.palette[chunk.palette_indices[i]] != generated[i]) {
+            num_edits++;
+        }
+    }
+    int size = GENERATOR_DELTA_HEADER_SIZE + 2 + 4*num_edits + 2 + 3*chunk.break_amounts.size();
+    if (size >= max_size) {
+        return 0;
+    }
+
+    byte* cur = buffer;
+    write_u32(cur, generator.id);
+    write_u32(cur, generator.seed % (1ull << 32));
+    write_u32(cur, generator.seed >> 32);
+    write_u16(cur, num_edits);
+    for(int i = 0; i < NUM_BLOCKS; i++) {
+        int block_model = chunk.palette[chunk.palette_indices[i]];
+        if (block_model != generated[i]) {
+            write_u16(cur, i);
+            write_u16(cur, block_model);
+        }
+    }
+    write_break_amounts(cur, chunk);
+    return cur - buffer;
+}
+
+bool decode_generator_delta(const byte* buffer, int size, const ChunkGenerator* generator, ivec3 chunk_coords, UnpackedChunk& chunk) {
+    const byte* cur = buffer;
+    const byte* end = buffer + size;
+    if (end - cur < GENERATOR_DELTA_HEADER_SIZE + 2) {
+        return false;
+    }
+    uint32_t generator_id = read_u32(cur);
+    uint64_t seed = read_u32(cur);
+    seed |= (uint64_t)read_u32(cur) << 32;
+    if (!generator || generator->id != generator_id) {
+        dbg("ERROR: Chunk was saved by world generator %u, which isn't the world's generator!", generator_id);
+        return false;
+    }
+
+    thread_local int blocks[NUM_BLOCKS];
+    generator->generate(chunk_coords, seed, blocks);
+
+    int num_edits = read_u16(cur);
+    if (end - cur < 4*num_edits) {
+        return false;
+    }
+    for(int i = 0; i < num_edits; i++) {
+        int index = read_u16(cur);
+        int block_model = read_u16(cur);
+        if (index >= NUM_BLOCKS) {
+            return false;
+        }
+        blocks[index] = block_model;
+    }
+    if (!read_break_amounts(cur, end, chunk)) {
+        return false;
+    }
+
+    // Same as raw_decode, the lookup table only ever has the entries of the palette set
+    chunk.palette.clear();
+    thread_local vector<int> palette_lookup(1 << 16, -1);
+    for(int i = 0; i < NUM_BLOCKS; i++) {
+        // Block models are stored in 16 bits, as with every codec
+        uint16_t block_model = blocks[i];
+        int& palette_index = palette_lookup[block_model];
+        if (palette_index < 0) {
+            palette_index = chunk.palette.size();
+            chunk.palette.push_back(block_model);
+        }
+        chunk.palette_indices[i] = palette_index;
+    }
+    for(int block_model : chunk.palette) {
+        palette_lookup[block_model] = -1;
+    }
+    return true;
+}
+
+static const ChunkCodec chunk_codecs[NUM_CHUNK_CODECS] = {
+    {ChunkCodecType::RAW, "raw", raw_get_encoded_size, raw_encode, raw_decode},
+    {ChunkCodecType::PALETTE_RLE, "palette+rle", palette_rle_get_encoded_size, palette_rle_encode, palette_rle_decode},
+    {ChunkCodecType::PALETTE_BITPACKED, "palette+bitpacked", palette_bitpacked_get_encoded_size, palette_bitpacked_encode, palette_bitpacked_decode},
+};
+
+const ChunkCodec* get_chunk_codec(ChunkCodecType type) {
+    for(const ChunkCodec& codec : chunk_codecs) {
+        if (codec.type == type) {
+            return &codec;
+        }
+    }
+    return NULL;
+}
+
+const ChunkCodec* choose_chunk_codec(const UnpackedChunk& chunk) {
+    const ChunkCodec* best_codec = NULL;
+    int best_size = 0;
+    for(const ChunkCodec& codec : chunk_codecs) {
+        int size = codec.get_encoded_size(chunk);
+        if (!best_codec || size < best_size) {
+            best_codec = &codec;
+            best_size = size;
+        }
+    }
+    return best_codec;
+}
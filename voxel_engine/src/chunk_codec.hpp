@@ -0,0 +1,90 @@
+#ifndef _CHUNK_CODEC_HPP_
+#define _CHUNK_CODEC_HPP_
+
+#include "utils.hpp"
+#include "chunk.hpp"
+
+/**
+ *\addtogroup VoxelEngine
+ * @{
+ */
+
+/// The number of bytes that a buffer must have, to be able to hold the encoding of any chunk with any @ref ChunkCodec
+#define MAX_ENCODED_CHUNK_SIZE (2 + CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE*(2 + 4 + 3) + 2 + 2)
+
+/// Identifies the @ref ChunkCodec that a chunk payload was encoded with. These values are stored on disk, so they must never change
+enum class ChunkCodecType : uint8_t {
+    /// A 16-bit block model and an 8-bit break amount for every block, or only one block model for a uniform chunk.
+    /// This is the same format as the chunks of the .data files that predate region files
+    RAW = 0,
+    /// @ref ChunkCodecType::RAW, deflated with the compressor of the bundled zip library.
+    /// This isn't a @ref ChunkCodec of the engine, it's only compared against by tests/chunk_codec_benchmark.cpp
+    RAW_DEFLATE = 1,
+    /// The palette, followed by runs of blocks that have the same palette index
+    PALETTE_RLE = 2,
+    /// The palette, followed by the palette index of every block, packed into the fewest bits that fit every index
+    PALETTE_BITPACKED = 3,
+    /// The id and seed of a @ref ChunkGenerator, followed by every block that differs from what it generates.
+    /// This isn't a @ref ChunkCodec, as it needs the generator and the chunk's location, see @ref encode_generator_delta
+    GENERATOR_DELTA = 4,
+};
+
+/// The number of @ref ChunkCodec "ChunkCodecs"
+#define NUM_CHUNK_CODECS 3
+
+/// A ChunkCodec encodes an @ref UnpackedChunk into bytes, and decodes it back
+/**
+ * Encoding is lossless, except that break amounts are stored in 256ths, and block models are stored in 16 bits.
+ * Every codec is stateless, and may be used from any thread at once.
+ *
+ * Use @ref choose_chunk_codec to pick the codec that encodes a given chunk in the fewest bytes.
+ */
+struct ChunkCodec {
+    /// The type that identifies this codec
+    ChunkCodecType type;
+    /// The name of this codec, for printing
+    const char* name;
+    /// Get the exact number of bytes that encode will write for the given chunk
+    int (*get_encoded_size)(const UnpackedChunk& chunk);
+    /// Encode the chunk into the buffer, which must be at least @ref MAX_ENCODED_CHUNK_SIZE bytes long. Returns the number of bytes written, or 0 on failure
+    int (*encode)(const UnpackedChunk& chunk, byte* buffer);
+    /// Decode a chunk that was encoded by encode. Returns false if the buffer is malformed
+    bool (*decode)(const byte* buffer, int size, UnpackedChunk& chunk);
+};
+
+/// Get the codec with the given type, or NULL if there is no such codec
+const ChunkCodec* get_chunk_codec(ChunkCodecType type);
+/// Get the codec that encodes the given chunk in the fewest bytes
+const ChunkCodec* choose_chunk_codec(const UnpackedChunk& chunk);
+
+/// Callback type for a world generator. It must fill the buffer with the block model of every block of the chunk, by block index, using 0 for air
+using fn_generate_chunk = std::function<void(ivec3 chunk_coords, uint64_t seed, int* buffer)>;
+
+/// A deterministic world generator, that generated chunks can be stored as a list of edits against
+/**
+ * generate must always produce the same blocks for the same chunk-coordinates and seed, and must be safe to call from any thread at once,
+ * as chunks are regenerated by the background threads that load them. If what it generates ever changes, then it must be given a new id,
+ * so that chunks saved with the old generator are not regenerated with the new one.
+ */
+struct ChunkGenerator {
+    /// Identifies the generator in saved chunks
+    uint32_t id;
+    /// The seed that is passed to generate
+    uint64_t seed;
+    /// Generates the blocks of a chunk
+    fn_generate_chunk generate;
+};
+
+/// Encode the chunk as the blocks that differ from what the generator generates at the given chunk-coordinates, as @ref ChunkCodecType::GENERATOR_DELTA
+/**
+ * The buffer must be at least @ref MAX_ENCODED_CHUNK_SIZE bytes long.
+ *
+ * @returns The number of bytes written, or 0 if the encoding would be max_size bytes or more, in which case the chunk is better stored by a @ref ChunkCodec
+ */
+int encode_generator_delta(const UnpackedChunk& chunk, const ChunkGenerator& generator, ivec3 chunk_coords, int max_size, byte* buffer);
+/// Decode a chunk that was encoded by @ref encode_generator_delta, by regenerating it. Returns false if the buffer is malformed, or if it was encoded with a different generator
+bool decode_generator_delta(const byte* buffer, int size, const ChunkGenerator* generator, ivec3 chunk_coords, UnpackedChunk& chunk);
+
+/**@}*/
+
+#endif
@@ -0,0 +1,77 @@
+#include "chunk.hpp"
+
+// Index of a block within the chunk's BlockStorage, matching the memory layout of a [x][y][z] array
+#define BLOCK_INDEX(x, y, z) (((x)*CHUNK_SIZE + (y))*CHUNK_SIZE + (z))
+
+ChunkContents::ChunkContents() : blocks(CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE) {
+}
+
+ChunkContents::ChunkContents(const ChunkContents& other) : blocks(other.blocks), break_amounts(other.break_amounts) {
+}
+
+float ChunkContents::get_break_amount(int index) const {
+    for(auto& p : break_amounts) {
+        if (p.first == index) {
+            return p.second;
+        }
+    }
+    return 0.0f;
+}
+
+void ChunkContents::unpack(UnpackedChunk& chunk) const {
+    blocks.unpack(chunk.palette, chunk.palette_indices);
+    chunk.break_amounts.clear();
+    for(auto& p : break_amounts) {
+        byte break_amount = ((int)(p.second * 256)) % 256;
+        // Damage too small to be stored is dropped, as undamaged blocks are not kept in the side-table
+        if (break_amount) {
+            chunk.break_amounts.push_back({p.first, break_amount});
+        }
+    }
+}
+
+ChunkSnapshot::ChunkSnapshot(shared_ptr<const ChunkContents> contents) : contents(std::move(contents)) {
+    this->contents->num_snapshots.fetch_add(1, std::memory_order_relaxed);
+}
+
+ChunkSnapshot::ChunkSnapshot(const ChunkSnapshot& other) : contents(other.contents) {
+    contents->num_snapshots.fetch_add(1, std::memory_order_relaxed);
+}
+
+ChunkSnapshot& ChunkSnapshot::operator=(const ChunkSnapshot& other) {
+    other.contents->num_snapshots.fetch_add(1, std::memory_order_relaxed);
+    contents->num_snapshots.fetch_sub(1, std::memory_order_release);
+    contents = other.contents;
+    return *this;
+}
+
+ChunkSnapshot::~ChunkSnapshot() {
+    // Releases our reads of the contents, so that they happen before the chunk next writes to them in-place
+    contents->num_snapshots.fetch_sub(1, std::memory_order_release);
+}
+
+optional<BlockData> ChunkSnapshot::get_block(int x, int y, int z) const {
+    int block_model = get_block_model(x, y, z);
+    // Return nullopt if it's an air block
+    if (!block_model) {
+        return nullopt;
+    }
+    BlockData block(block_model);
+    block.break_amount = contents->get_break_amount(BLOCK_INDEX(x, y, z));
+    return block;
+}
+
+int ChunkSnapshot::get_block_model(int x, int y, int z) const {
+    if (x < 0 || x >= CHUNK_SIZE || y < 0 || y >= CHUNK_SIZE || z < 0 || z >= CHUNK_SIZE) {
+        return 0;
+    }
+    return contents->blocks.get(BLOCK_INDEX(x, y, z));
+}
+
+bool ChunkSnapshot::is_uniform() const {
+    return contents->blocks.is_uniform() && contents->break_amounts.empty();
+}
+
+void ChunkSnapshot::unpack(UnpackedChunk& chunk) const {
+    contents->unpack(chunk);
+}
@@ -0,0 +1,69 @@
+#ifndef _CHUNK_LOCK_HPP_
+#define _CHUNK_LOCK_HPP_
+
+#include "utils.hpp"
+
+/**
+ *\addtogroup VoxelEngine
+ * @{
+ */
+
+/// The ChunkLock class is a reader/writer lock that is small enough to embed in every chunk
+/**
+ * Any number of threads may hold the lock in shared mode, or a single thread may hold it exclusively.
+ * It satisfies the Lockable and SharedLockable requirements, so it can be used with std::unique_lock and std::shared_lock.
+ *
+ * Chunk locks are only ever held for the duration of a single block access or chunk operation,
+ * so waiting threads spin, yielding their timeslice, instead of sleeping.
+ * Readers are never blocked by waiting writers, so a thread that already holds some chunk locks
+ * in shared mode may always acquire another one in shared mode, as long as that chunk isn't held exclusively.
+ */
+
+class ChunkLock {
+public:
+    /// Creates an unlocked ChunkLock
+    ChunkLock() {
+    }
+    /// ChunkLocks cannot be copied
+    ChunkLock(const ChunkLock& other) = delete;
+    /// ChunkLocks cannot be copied
+    ChunkLock& operator=(const ChunkLock& other) = delete;
+
+    /// Acquire the lock exclusively
+    void lock() {
+        int expected = 0;
+        while (!state.compare_exchange_weak(expected, WRITER, std::memory_order_acquire, std::memory_order_relaxed)) {
+            expected = 0;
+            std::this_thread::yield();
+        }
+    }
+    /// Release the lock from exclusive mode
+    void unlock() {
+        state.store(0, std::memory_order_release);
+    }
+
+    /// Acquire the lock in shared mode
+    void lock_shared() {
+        int readers = state.load(std::memory_order_relaxed);
+        while (true) {
+            if (readers == WRITER) {
+                std::this_thread::yield();
+                readers = state.load(std::memory_order_relaxed);
+            } else if (state.compare_exchange_weak(readers, readers + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+                return;
+            }
+        }
+    }
+    /// Release the lock from shared mode
+    void unlock_shared() {
+        state.fetch_sub(1, std::memory_order_release);
+    }
+private:
+    static constexpr int WRITER = -1;
+    // WRITER if the lock is held exclusively, and otherwise the number of threads that hold it in shared mode
+    std::atomic<int> state{0};
+};
+
+/**@}*/
+
+#endif
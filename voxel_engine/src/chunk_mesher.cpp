@@ -0,0 +1,291 @@
+#include "chunk_mesher.hpp"
+
+// Offsets of the six neighboring blocks, in the same order as Mesh::get_mesh_data
+static const ivec3 neighbor_offsets[6] = {ivec3(-1, 0, 0), ivec3(1, 0, 0), ivec3(0, -1, 0), ivec3(0, 1, 0), ivec3(0, 0, -1), ivec3(0, 0, 1)};
+
+void ChunkBorders::set_neighbor(int dir, const ChunkSnapshot& neighbor) {
+    int axis = dir / 2;
+    // The neighbor in the negative direction touches us with its last layer, and the one in the positive direction with its first
+    int layer = (dir & 1) ? 0 : CHUNK_SIZE - 1;
+    for(int u = 0; u < CHUNK_SIZE; u++) {
+        for(int v = 0; v < CHUNK_SIZE; v++) {
+            ivec3 pos;
+            pos[axis] = layer;
+            pos[axis == 0 ? 1 : 0] = u;
+            pos[axis == 2 ? 1 : 2] = v;
+            blocks[dir][BORDER_INDEX(u, v)] = neighbor.get_block_model(pos.x, pos.y, pos.z);
+        }
+    }
+}
+
+void ChunkMesh::clear() {
+    vertices.clear();
+    num_quads = 0;
+}
+
+// Pack the position and face of a ChunkVertex, from its position relative to the corner of the chunk
+static uint32_t pack_position(vec3 position, int face) {
+    uint32_t packed = face << 27;
+    for(int axis = 0; axis < 3; axis++) {
+        // Vertices too far outside of the chunk are clamped
+        int coordinate = clamp((int)round((position[axis] + CHUNK_VERTEX_POSITION_BIAS) * 16.0f), 0, 511);
+        packed |= coordinate << (9*axis);
+    }
+    return packed;
+}
+
+// Pack the texture and break amount of a ChunkVertex, along with either its uv or its texture's orientation
+static uint32_t pack_texture(int tile, uint32_t uv_bits, float break_amount) {
+    // Every bitmap ID is checked by get_block_model_info, so the mask only guards the other bits of the vertex
+    return (tile & CHUNK_VERTEX_MAX_TILE) | (uv_bits << 12) | ((uint32_t)round(clamp(break_amount, 0.0f, 1.0f) * 255.0f) << 22);
+}
+
+// Pack a uv on a texture into the uv bits of a ChunkVertex
+static uint32_t pack_uv(vec2 uv) {
+    return clamp((int)round(uv.x * 16.0f), 0, 16) | (clamp((int)round(uv.y * 16.0f), 0, 16) << 5);
+}
+
+// Find the orientation bits of a ChunkVertex, from the uv_transform of a CubeFace
+static uint32_t get_orientation(const mat2& uv_transform) {
+    // Either the u of the texture follows the u of the face, or u and v are swapped
+    bool swap = uv_transform[0].x == 0.0f;
+    vec2 signs = swap ? vec2(uv_transform[1].x, uv_transform[0].y) : vec2(uv_transform[0].x, uv_transform[1].y);
+    return (swap ? 1 : 0) | (signs.x < 0.0f ? 2 : 0) | (signs.y < 0.0f ? 4 : 0);
+}
+
+ChunkMesher::ChunkMesher(fn_get_mesher_components get_components) : get_components(std::move(get_components)) {
+}
+
+void ChunkMesher::set_greedy(bool greedy) {
+    this->greedy = greedy;
+}
+
+const ChunkMesher::BlockModelInfo& ChunkMesher::get_block_model_info(int block_model) {
+    if (block_model >= (int)block_models.size()) {
+        block_models.resize(block_model + 1);
+    }
+    BlockModelInfo& info = block_models[block_model];
+    if (info.cached) {
+        return info;
+    }
+    info.cached = true;
+    // Air blocks are never opaque, and have nothing to mesh
+    if (block_model == 0) {
+        return info;
+    }
+
+    info.components = get_components(block_model);
+    // A bitmap ID that doesn't fit in a ChunkVertex would spill into the vertex's other bits,
+    // so a block model with one is meshed as nothing, and doesn't hide the faces of its neighbors
+    for(const MesherComponent& component : info.components) {
+        for(int tile : component.texture_tiles) {
+            if (tile < 0 || tile > CHUNK_VERTEX_MAX_TILE) {
+                dbg("ERROR: Bitmap ID %d of block model %d doesn't fit in a chunk vertex! The block model won't be meshed", tile, block_model);
+                info.components.clear();
+                return info;
+            }
+        }
+    }
+    for(const MesherComponent& component : info.components) {
+        // If any of the components are opaque in the given direction,
+        // then this block is opaque in that direction
+        for(int dir = 0; dir < 6; dir++) {
+            if (component.opacities[dir]) {
+                info.opaque_faces |= 1 << dir;
+            }
+        }
+    }
+
+    // The opaque faces of a block model that's a single unit cube can be merged.
+    // Faces of different block models are merged together if they have the same texture and orientation
+    if (info.components.size() == 1) {
+        const MesherComponent& component = info.components[0];
+        const vector<CubeFace>& cube_faces = component.cube_faces;
+        for(int dir = 0; dir < (int)cube_faces.size(); dir++) {
+            if ((info.opaque_faces >> dir) & 1) {
+                int tile = component.texture_tiles.at(cube_faces[dir].texture);
+                info.greedy_faces[dir] = tile*8 + get_orientation(cube_faces[dir].uv_transform);
+            }
+        }
+    }
+    return info;
+}
+
+void ChunkMesher::mesh_greedy_layer(int dir, int layer, ChunkMesh& mesh) {
+    int axis = dir / 2;
+    // The two other axes, in x, y, z order
+    int u_axis = axis == 0 ? 1 : 0;
+    int v_axis = axis == 2 ? 1 : 2;
+
+    // Going around the corners of a rectangle in order is counter-clockwise when looking down the cross product of the u and v axes,
+    // which is +x, -y, or +z. Faces that point the other way are wound the other way, so that they aren't culled as back faces
+    static const int forward_order[4] = {0, 1, 2, 3};
+    static const int backward_order[4] = {0, 3, 2, 1};
+    bool forward = (axis != 1) == (bool)(dir & 1);
+    const int* order = forward ? forward_order : backward_order;
+
+    GreedyCell* cells = &greedy_cells[(dir*CHUNK_SIZE + layer)*CHUNK_SIZE*CHUNK_SIZE];
+    for(int u = 0; u < CHUNK_SIZE; u++) {
+        for(int v = 0; v < CHUNK_SIZE; v++) {
+            GreedyCell cell = cells[BORDER_INDEX(u, v)];
+            if (!cell.face) {
+                continue;
+            }
+            auto matches = [&](int u2, int v2) {
+                const GreedyCell& other = cells[BORDER_INDEX(u2, v2)];
+                return other.face == cell.face && other.break_amount == cell.break_amount;
+            };
+
+            // Grow the rectangle along v as far as it can go, and then along u for as long as every row matches
+            int height = 1;
+            while (v + height < CHUNK_SIZE && matches(u, v + height)) {
+                height++;
+            }
+            int width = 1;
+            for(; u + width < CHUNK_SIZE; width++) {
+                bool row_matches = true;
+                for(int h = 0; h < height && row_matches; h++) {
+                    row_matches = matches(u + width, v + h);
+                }
+                if (!row_matches) {
+                    break;
+                }
+            }
+            for(int w = 0; w < width; w++) {
+                for(int h = 0; h < height; h++) {
+                    cells[BORDER_INDEX(u + w, v + h)].face = 0;
+                }
+            }
+
+            // The uvs come from the position on the face, so that the texture repeats once per block
+            int face = cell.face - 1;
+            uint32_t texture = pack_texture(face / 8, face % 8, cell.break_amount);
+            vec2 corners[4] = {vec2(u, v), vec2(u + width, v), vec2(u + width, v + height), vec2(u, v + height)};
+            for(int vert = 0; vert < 4; vert++) {
+                vec2 corner = corners[order[vert]];
+                vec3 vertex;
+                vertex[axis] = layer + (dir & 1);
+                vertex[u_axis] = corner.x;
+                vertex[v_axis] = corner.y;
+                mesh.vertices.push_back(ChunkVertex{pack_position(vertex, dir), texture});
+            }
+            mesh.num_quads++;
+        }
+    }
+}
+
+void ChunkMesher::mesh(const ChunkSnapshot& chunk, const ChunkBorders& borders, ChunkMesh& mesh) {
+    mesh.clear();
+
+    if (greedy_cells.empty()) {
+        greedy_cells.resize(6*CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE);
+    }
+
+    // A uniform chunk of air has nothing to mesh
+    bool is_uniform = chunk.is_uniform();
+    if (is_uniform && chunk.get_block_model(0, 0, 0) == 0) {
+        return;
+    }
+
+    // A uniform chunk of a block that's opaque on every side can only have visible faces on its border,
+    // so we only have to look at the blocks on the border
+    bool only_border = is_uniform && get_block_model_info(chunk.get_block_model(0, 0, 0)).opaque_faces == (1 << 6) - 1;
+
+    // Get the block model of a block in the chunk, or of a block that shares a face with the chunk
+    auto get_neighboring_block = [&](ivec3 pos) {
+        if (pos.x < 0) {
+            return borders.blocks[0][BORDER_INDEX(pos.y, pos.z)];
+        } else if (pos.x >= CHUNK_SIZE) {
+            return borders.blocks[1][BORDER_INDEX(pos.y, pos.z)];
+        } else if (pos.y < 0) {
+            return borders.blocks[2][BORDER_INDEX(pos.x, pos.z)];
+        } else if (pos.y >= CHUNK_SIZE) {
+            return borders.blocks[3][BORDER_INDEX(pos.x, pos.z)];
+        } else if (pos.z < 0) {
+            return borders.blocks[4][BORDER_INDEX(pos.x, pos.y)];
+        } else if (pos.z >= CHUNK_SIZE) {
+            return borders.blocks[5][BORDER_INDEX(pos.x, pos.y)];
+        }
+        return chunk.get_block_model(pos.x, pos.y, pos.z);
+    };
+
+    for(int i = 0; i < CHUNK_SIZE; i++) {
+        for(int j = 0; j < CHUNK_SIZE; j++) {
+            // When only looking at the border, skip from the first to the last block of interior rows
+            bool interior_row = only_border && i > 0 && i < CHUNK_SIZE-1 && j > 0 && j < CHUNK_SIZE-1;
+            for(int k = 0; k < CHUNK_SIZE; k += interior_row ? CHUNK_SIZE-1 : 1) {
+                // If the block has a block type of 0, just skip it (It's an air block)
+                int block_model = chunk.get_block_model(i, j, k);
+                if (!block_model) {
+                    continue;
+                }
+
+                // A face is visible unless the neighbor it faces is opaque in the opposite direction
+                bool visible_neighbors[6];
+                bool any_visible = false;
+                for(int dir = 0; dir < 6; dir++) {
+                    int neighbor = get_neighboring_block(ivec3(i, j, k) + neighbor_offsets[dir]);
+                    visible_neighbors[dir] = !((get_block_model_info(neighbor).opaque_faces >> (dir ^ 1)) & 1);
+                    any_visible |= visible_neighbors[dir];
+                }
+                if (!any_visible) {
+                    continue;
+                }
+
+                vec3 fpos(i, j, k);
+                float break_amount = chunk.get_block(i, j, k)->break_amount;
+                const BlockModelInfo& info = get_block_model_info(block_model);
+
+                // Faces that can be merged are left for mesh_greedy_layer, and culled from the block's own mesh
+                int num_greedy_faces = 0;
+                for(int dir = 0; dir < 6; dir++) {
+                    int greedy_face = info.greedy_faces[dir];
+                    if (!greedy || greedy_face == -1) {
+                        continue;
+                    }
+                    if (visible_neighbors[dir]) {
+                        int axis = dir / 2;
+                        ivec3 pos(i, j, k);
+                        int layer = pos[axis];
+                        int border_index = BORDER_INDEX(pos[axis == 0 ? 1 : 0], pos[axis == 2 ? 1 : 2]);
+                        GreedyCell& cell = greedy_cells[(dir*CHUNK_SIZE + layer)*CHUNK_SIZE*CHUNK_SIZE + border_index];
+                        cell.face = greedy_face + 1;
+                        cell.break_amount = break_amount;
+                        greedy_layers_used[dir][layer] = true;
+                        visible_neighbors[dir] = false;
+                    }
+                    num_greedy_faces++;
+                }
+                if (num_greedy_faces == 6) {
+                    continue;
+                }
+
+                for(const MesherComponent& component : info.components) {
+                    auto p = component.get_tile_mesh_data(visible_neighbors);
+                    vec3* vertex_buf = (vec3*)get<0>(p);
+                    vec2* uv_buf = (vec2*)get<1>(p);
+                    int* tile_buf = (int*)get<2>(p);
+                    int num_model_quads = get<3>(p);
+
+                    // Loop over each vertex of every quad in the model, and add it to the chunk's mesh
+                    for(int vert = 0; vert < num_model_quads*4; vert++) {
+                        uint32_t position = pack_position(vertex_buf[vert] + fpos, CHUNK_VERTEX_NO_FACE);
+                        uint32_t texture = pack_texture(tile_buf[vert / 4], pack_uv(uv_buf[vert]), break_amount);
+                        mesh.vertices.push_back(ChunkVertex{position, texture});
+                    }
+
+                    mesh.num_quads += num_model_quads;
+                }
+            }
+        }
+    }
+
+    for(int dir = 0; dir < 6; dir++) {
+        for(int layer = 0; layer < CHUNK_SIZE; layer++) {
+            if (greedy_layers_used[dir][layer]) {
+                mesh_greedy_layer(dir, layer, mesh);
+                greedy_layers_used[dir][layer] = false;
+            }
+        }
+    }
+}
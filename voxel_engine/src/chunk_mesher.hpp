@@ -0,0 +1,135 @@
+#ifndef _CHUNK_MESHER_HPP_
+#define _CHUNK_MESHER_HPP_
+
+#include "utils.hpp"
+#include "chunk.hpp"
+#include "mesh.hpp"
+
+/**
+ *\addtogroup VoxelEngine
+ * @{
+ */
+
+/// The index of a block within one of the borders of a @ref ChunkBorders, from the two chunk-local coordinates that aren't along that border's axis, in x, y, z order
+#define BORDER_INDEX(u, v) ((u)*CHUNK_SIZE + (v))
+
+/// The blocks just outside of each face of a chunk, which are needed to know which faces of the chunk's outermost blocks are visible
+struct ChunkBorders {
+    /// For each of the six neighboring chunks, in the same order as Mesh::get_mesh_data, the block model of every block
+    /// in the layer of that chunk which touches this chunk, by @ref BORDER_INDEX. Neighbors that don't exist are air
+    int blocks[6][CHUNK_SIZE*CHUNK_SIZE] = {};
+
+    /// Copy the border in the given direction out of a snapshot of the neighboring chunk in that direction
+    void set_neighbor(int dir, const ChunkSnapshot& neighbor);
+};
+
+// The offset of a ChunkVertex's position from the corner of its chunk, in blocks, so that vertices slightly outside of the chunk can be packed
+#define CHUNK_VERTEX_POSITION_BIAS 8
+// The face of a ChunkVertex that isn't on a face of a unit cube
+#define CHUNK_VERTEX_NO_FACE 7
+// The largest bitmap ID that a ChunkVertex can refer to. Block models with larger ones are meshed as nothing
+#define CHUNK_VERTEX_MAX_TILE 4095
+
+/// A vertex of a @ref ChunkMesh, packed into 8 bytes. See assets/shaders/chunk.vert for how it's unpacked
+/**
+ * position:
+ * - Bits 0-26: The x, y, and z of the vertex, 9 bits each. Each is in 1/16ths of a block, from @ref CHUNK_VERTEX_POSITION_BIAS blocks below the corner of the chunk.
+ * Vertices of meshes that aren't on a 1/16th grid are rounded onto it
+ * - Bits 27-29: The direction that the vertex's face points in, in the same order as Mesh::get_mesh_data,
+ * if it's on a face of a unit cube (See @ref Mesh::get_cube_faces). Otherwise, @ref CHUNK_VERTEX_NO_FACE
+ *
+ * texture:
+ * - Bits 0-11: The bitmap ID on the texture atlas of the vertex's texture
+ * - Bits 12-21: For a vertex on the face of a unit cube, its uv comes from its position on the face, and bits 12-14 orient the texture.
+ * Bit 12 swaps u and v, and then bits 13 and 14 mirror u and v respectively. Otherwise, the u and v of the vertex on its texture, in 1/16ths, 5 bits each
+ * - Bits 22-29: The break amount of the vertex's block, in 1/255ths
+ */
+struct ChunkVertex {
+    /// The position and face of the vertex
+    uint32_t position;
+    /// The texture, uv, and break amount of the vertex
+    uint32_t texture;
+};
+
+/// The mesh of a chunk, as built by a @ref ChunkMesher. Every four vertices are a quad, which is drawn with GL::draw_quads
+struct ChunkMesh {
+    /// Every vertex of the mesh
+    vector<ChunkVertex> vertices;
+    /// The number of quads in the mesh
+    int num_quads = 0;
+
+    /// Remove every quad, while keeping the buffers allocated
+    void clear();
+};
+
+/// A component of a block model, as seen by a @ref ChunkMesher
+/**
+ * This is everything that the mesher needs to know about a @ref Component, so that the mesher doesn't depend on the @ref Universe,
+ * and can be given block models that were never registered with it.
+ */
+struct MesherComponent {
+    /// Whether or not the component is opaque on each side, in the same order as Mesh::get_mesh_data. See Component::get_opacities
+    bool opacities[6] = {};
+    /// The bitmap ID on the texture atlas of each of the component's textures. See Component::get_texture_tiles
+    vector<int> texture_tiles;
+    /// The six faces of the component's mesh if it's a unit cube, or nothing otherwise. See Component::get_cube_faces
+    vector<CubeFace> cube_faces;
+    /// Get the quads of the component that aren't culled by the given visible neighbors. See Component::get_tile_mesh_data
+    function<tuple<byte*, byte*, byte*, int>(bool*)> get_tile_mesh_data;
+};
+
+/// A function that maps a block model other than air into its components, with one component chosen from each ComponentPossibilities
+using fn_get_mesher_components = function<vector<MesherComponent>(int)>;
+
+/// The ChunkMesher class builds the mesh of a chunk, from a snapshot of the chunk and its borders
+/**
+ * Meshing doesn't touch OpenGL, or the chunk itself, so it can be done without a display, and the resulting @ref ChunkMesh
+ * is uploaded afterwards with @ref Chunk::upload_mesh.
+ *
+ * Faces that are hidden by an opaque neighbor are culled. The components of each block model are cached by the mesher,
+ * so that they're only looked up once per block model. A ChunkMesher must therefore only be used by one thread at a time.
+ *
+ * By default, the mesher is greedy: the opaque faces of block models that are a single unit cube (See @ref Mesh::get_cube_faces)
+ * are merged with coplanar faces that have the same texture, orientation, and break amount, into rectangles that are as large as possible.
+ * A flat 16x16 surface of grass is then 1 quad rather than 256. The texture of a merged face is repeated once per block by chunk.frag.
+ */
+
+class ChunkMesher {
+public:
+    /// Create a mesher that looks up the components of each block model with the given function
+    ChunkMesher(fn_get_mesher_components get_components);
+    /// Build the mesh of a chunk, replacing the contents of mesh. The mesh is relative to the corner of the chunk, so it doesn't depend on where the chunk is
+    void mesh(const ChunkSnapshot& chunk, const ChunkBorders& borders, ChunkMesh& mesh);
+    /// Set whether or not faces of unit cubes are merged. If not, every visible face is meshed on its own
+    void set_greedy(bool greedy);
+private:
+    struct BlockModelInfo {
+        bool cached = false;
+        // (opaque_faces >> dir) & 1 == 1 if and only if the block model is opaque in the direction dir
+        int opaque_faces = 0;
+        // The component of every ComponentPossibilities of the block model
+        vector<MesherComponent> components;
+        // The face in every direction that can be merged, as its bitmap ID times 8 plus its orientation, or -1 if that face can't be merged
+        int greedy_faces[6] = {-1, -1, -1, -1, -1, -1};
+    };
+    struct GreedyCell {
+        // 1 + the greedy face of BlockModelInfo, or 0 if there's no face
+        int face = 0;
+        float break_amount = 0.0f;
+    };
+    bool greedy = true;
+    fn_get_mesher_components get_components;
+    // By block model
+    vector<BlockModelInfo> block_models;
+    const BlockModelInfo& get_block_model_info(int block_model);
+    // The faces waiting to be merged, by direction, then by layer along that direction's axis, and then by the BORDER_INDEX of the two other coordinates
+    vector<GreedyCell> greedy_cells;
+    // Whether or not any face is waiting to be merged, by direction and layer
+    bool greedy_layers_used[6][CHUNK_SIZE] = {};
+    // Merge the faces of the given direction and layer into rectangles, and add them to the mesh
+    void mesh_greedy_layer(int dir, int layer, ChunkMesh& mesh);
+};
+
+/**@}*/
+
+#endif
@@ -0,0 +1,82 @@
+#include "chunk.hpp"
+#include "gl_utils.hpp"
+#include "texture_atlasser.hpp"
+#include "chunk_mesher.hpp"
+
+// The parts of Chunk that touch OpenGL, which headless builds leave out
+
+static bool loaded_chunk_shader = false;
+static GLuint chunk_shader_id;
+
+void Chunk::upload_mesh(const ChunkMesh& mesh, const TextureAtlasser& texture_atlas, int cache_version) {
+    opengl_vertex_buffer.reuse((const GLuint*)mesh.vertices.data(), mesh.vertices.size()*sizeof(ChunkVertex));
+
+    // If the chunk changed while it was being meshed, then it will have to be meshed again
+    this->chunk_rendering_cached = cache_version == this->cache_version;
+    this->has_ever_cached = true;
+    this->num_quads_cache = mesh.num_quads;
+
+    this->opengl_texture_atlas_cache = texture_atlas.get_atlas_texture();
+    this->atlas_grid_layout_cache = texture_atlas.get_grid_layout();
+}
+
+void Chunk::render(const mat4& P, const mat4& V, ivec3 location) {
+    // If it's never been cached, then there's nothing to draw
+    if (!this->has_ever_cached) {
+        return;
+    }
+
+    // Check aabb of chunk against the view frustum
+    ivec3 bottom_left = location*CHUNK_SIZE;
+    AABB aabb(bottom_left, vec3(bottom_left) + vec3(CHUNK_SIZE));
+    if (aabb.test_frustum(P*V)) {
+        cached_render(P, V, bottom_left);
+    }
+}
+
+// Render the chunk presuming all of its rendering data has been cached
+void Chunk::cached_render(const mat4& P, const mat4& V, ivec3 bottom_left) {
+    if (num_quads_cache == 0) {
+        // No need to render if there are no quads
+        return;
+    }
+
+    // Statically load chunk shaders
+    if (!loaded_chunk_shader) {
+        chunk_shader_id = load_shaders("assets/shaders/chunk.vert", "assets/shaders/chunk.frag");
+        loaded_chunk_shader = true;
+    }
+
+    glUseProgram(chunk_shader_id);
+    
+    GLuint shader_texture_id = glGetUniformLocation(chunk_shader_id, "my_texture");
+    // shader_texture_id = &fragment_shader.myTextureSampler;
+    
+    bind_texture(1, shader_texture_id, opengl_texture_atlas_cache);
+
+    // Get a handle for our "MVP" uniform
+    // Only during the initialisation
+    GLuint P_matrix_shader_pointer = glGetUniformLocation(chunk_shader_id, "P");
+    GLuint V_matrix_shader_pointer = glGetUniformLocation(chunk_shader_id, "V");
+    
+    // Send our transformation to the currently bound shader, in the "MVP" uniform
+    // This is done in the main loop since each model will have a different MVP matrix (At least for the M part)
+    glUniformMatrix4fv(P_matrix_shader_pointer, 1, GL_FALSE, &P[0][0]);
+    glUniformMatrix4fv(V_matrix_shader_pointer, 1, GL_FALSE, &V[0][0]);
+    //"vertex_shader.MVP = &mvp[0][0]"
+
+    // The vertices are relative to the corner of the chunk, and refer to their textures by bitmap ID
+    GLuint chunk_position_shader_pointer = glGetUniformLocation(chunk_shader_id, "chunk_position");
+    GLuint atlas_grid_shader_pointer = glGetUniformLocation(chunk_shader_id, "atlas_grid");
+    glUniform3f(chunk_position_shader_pointer, bottom_left.x, bottom_left.y, bottom_left.z);
+    glUniform4f(atlas_grid_shader_pointer, atlas_grid_layout_cache.x, atlas_grid_layout_cache.y, atlas_grid_layout_cache.z, atlas_grid_layout_cache.w);
+
+    // Draw nothing, see you in tutorial 2 !
+    // 1st attribute buffer : packed vertices, see ChunkVertex
+    opengl_vertex_buffer.bind_integer(0, 2);
+
+    // Draw the quads !
+    draw_quads(num_quads_cache);
+
+    glDisableVertexAttribArray(0);
+}
@@ -0,0 +1,182 @@
+#ifndef _COORDINATE_MAP_HPP_
+#define _COORDINATE_MAP_HPP_
+
+#include "utils.hpp"
+
+/**
+ *\addtogroup VoxelEngine
+ * @{
+ */
+
+/// The CoordinateMap class is a hash map from ivec3 coordinates to values of type T
+/**
+ * Coordinates are packed into a single 64-bit key, with 21 bits per axis, so each coordinate must lie within
+ * [-2^20, 2^20). This is always true of megachunk coordinates.
+ *
+ * The map uses open addressing with linear probing. The packed keys are stored in their own flat array,
+ * so that a lookup usually touches a single cache line, and no lookup ever allocates or follows a pointer.
+ * Erasing uses backward-shift deletion, so the table never fills up with tombstones.
+ *
+ * Pointers to values are invalidated by any insertion or erasure.
+ */
+
+template<typename T>
+class CoordinateMap {
+public:
+    /// Creates an empty CoordinateMap
+    CoordinateMap() {
+        clear();
+    }
+
+    /// Get a pointer to the value at the given coordinates, or NULL if there is no such value
+    T* find(ivec3 coords) {
+        uint64_t key = pack(coords);
+        for(size_t i = home_slot(key); keys[i] != EMPTY_KEY; i = (i + 1) & mask) {
+            if (keys[i] == key) {
+                return &values[i];
+            }
+        }
+        return NULL;
+    }
+
+    /// Get the value at the given coordinates, inserting a default-constructed value if there is no such value
+    T& operator[](ivec3 coords) {
+        uint64_t key = pack(coords);
+        size_t i = home_slot(key);
+        for(; keys[i] != EMPTY_KEY; i = (i + 1) & mask) {
+            if (keys[i] == key) {
+                return values[i];
+            }
+        }
+
+        // Keep the load factor at or below 1/2, so that probe sequences stay short
+        if (2*(num_elements + 1) > keys.size()) {
+            rehash(2*keys.size());
+            return (*this)[coords];
+        }
+
+        keys[i] = key;
+        num_elements++;
+        return values[i];
+    }
+
+    /// Returns 1 if there is a value at the given coordinates, and 0 otherwise
+    int count(ivec3 coords) {
+        return find(coords) ? 1 : 0;
+    }
+
+    /// Erase the value at the given coordinates. Returns true if there was such a value
+    bool erase(ivec3 coords) {
+        uint64_t key = pack(coords);
+        size_t i = home_slot(key);
+        for(; keys[i] != key; i = (i + 1) & mask) {
+            if (keys[i] == EMPTY_KEY) {
+                return false;
+            }
+        }
+
+        // Shift back any later entries of the probe sequence that would no longer be reachable
+        size_t j = i;
+        while(true) {
+            j = (j + 1) & mask;
+            if (keys[j] == EMPTY_KEY) {
+                break;
+            }
+            // If the entry at j has its home slot cyclically within (i, j], then it's still reachable
+            size_t home = home_slot(keys[j]);
+            if (((j - home) & mask) < ((j - i) & mask)) {
+                continue;
+            }
+            keys[i] = keys[j];
+            values[i] = std::move(values[j]);
+            i = j;
+        }
+
+        keys[i] = EMPTY_KEY;
+        values[i] = T();
+        num_elements--;
+        return true;
+    }
+
+    /// Erase every value
+    void clear() {
+        keys.assign(MIN_CAPACITY, EMPTY_KEY);
+        values.clear();
+        values.resize(MIN_CAPACITY);
+        mask = MIN_CAPACITY - 1;
+        num_elements = 0;
+    }
+
+    /// The number of values in the map
+    size_t size() {
+        return num_elements;
+    }
+
+    /// Call the given function on every (coordinates, value) pair. The function must not insert or erase
+    template<typename F>
+    void for_each(F f) {
+        for(size_t i = 0; i < keys.size(); i++) {
+            if (keys[i] != EMPTY_KEY) {
+                f(unpack(keys[i]), values[i]);
+            }
+        }
+    }
+private:
+    static constexpr uint64_t EMPTY_KEY = ~0ULL;
+    static constexpr size_t MIN_CAPACITY = 16;
+    static constexpr int BITS_PER_AXIS = 21;
+    static constexpr uint64_t AXIS_MASK = (1ULL << BITS_PER_AXIS) - 1;
+
+    // Every packed key is less than 2^63, so it can never collide with EMPTY_KEY
+    static uint64_t pack(ivec3 coords) {
+        return (((uint64_t)coords.x & AXIS_MASK) << (2*BITS_PER_AXIS))
+             | (((uint64_t)coords.y & AXIS_MASK) << BITS_PER_AXIS)
+             | ((uint64_t)coords.z & AXIS_MASK);
+    }
+
+    static ivec3 unpack(uint64_t key) {
+        // Shift each axis up to the top of an int, and then back down to sign-extend it
+        int shift = 32 - BITS_PER_AXIS;
+        return ivec3(
+            (int)((uint)(key >> (2*BITS_PER_AXIS)) << shift) >> shift,
+            (int)((uint)((key >> BITS_PER_AXIS) & AXIS_MASK) << shift) >> shift,
+            (int)((uint)(key & AXIS_MASK) << shift) >> shift
+        );
+    }
+
+    size_t home_slot(uint64_t key) {
+        // Fibonacci hashing, so that nearby coordinates are spread across the table
+        return (key * 0x9E3779B97F4A7C15ULL >> 32) & mask;
+    }
+
+    void rehash(size_t new_capacity) {
+        vector<uint64_t> old_keys = std::move(keys);
+        vector<T> old_values = std::move(values);
+
+        keys.assign(new_capacity, EMPTY_KEY);
+        values.clear();
+        values.resize(new_capacity);
+        mask = new_capacity - 1;
+
+        for(size_t i = 0; i < old_keys.size(); i++) {
+            if (old_keys[i] == EMPTY_KEY) {
+                continue;
+            }
+            size_t j = home_slot(old_keys[i]);
+            while (keys[j] != EMPTY_KEY) {
+                j = (j + 1) & mask;
+            }
+            keys[j] = old_keys[i];
+            values[j] = std::move(old_values[i]);
+        }
+    }
+
+    vector<uint64_t> keys;
+    vector<T> values;
+    size_t mask;
+    size_t num_elements;
+};
+
+/**@}*/
+
+#endif
@@ -1,6 +1,7 @@
 #include "drop.hpp"
 #include "player.hpp"
 #include "../api.hpp"
+#include "../universe.hpp"
 
 extern int on_break_event;
 extern int on_pickup_event;
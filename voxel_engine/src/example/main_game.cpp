@@ -3,6 +3,7 @@
 #include "../texture_renderer.hpp"
 #include "drop.hpp"
 #include "../api.hpp"
+#include "../universe.hpp"
 
 // Mods
 DropMod* drop_mod;
@@ -126,6 +127,8 @@ Game::~Game() {
 
 void Game::restart_world() {
     VoxelEngine::World::restart_world(world_id);
+    // Chunks that were never edited are then saved as just the generator, and regenerated when they're loaded
+    VoxelEngine::World::set_generator(world_id, WORLD_GENERATOR_ID, WORLD_SEED, generate_terrain);
     this->player = Player();
     player.hotbar[0] = dirt_block_model;
     player.hotbar[1] = cobblestone_block_model;
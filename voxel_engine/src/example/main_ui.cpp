@@ -1,4 +1,5 @@
 #include "main_ui.hpp"
+#include "../universe.hpp"
 
 extern Player* g_player;
 
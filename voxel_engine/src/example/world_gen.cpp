@@ -49,11 +49,7 @@ void generate_tree_pyramid(int world_id, ivec3 loc) {
     // Make pyramid
     for(int dy = 2; dy <= 4; dy++) {
         int radius = dy == 2 ? 2 : (dy == 3 ? 1 : 0);
-        for(int dx = -radius; dx <= radius; dx++) {
-            for(int dz = -radius; dz <= radius; dz++) {
-                VoxelEngine::World::set_block(world_id, ivec3(loc.x + dx, loc.y + dy, loc.z + dz), leaf_block_model);
-            }
-        }
+        VoxelEngine::World::fill_box(world_id, loc + ivec3(-radius, dy, -radius), ivec3(2*radius+1, 1, 2*radius+1), leaf_block_model);
     }
     
     VoxelEngine::World::set_block(world_id, ivec3(loc.x, loc.y+2, loc.z), log_block_model);
@@ -86,13 +82,7 @@ void generate_tree_cute(int world_id, ivec3 loc) {
     VoxelEngine::World::set_block(world_id, ivec3(loc.x, loc.y, loc.z), log_block_model);
     VoxelEngine::World::set_block(world_id, ivec3(loc.x, loc.y+1, loc.z), log_block_model);
 
-    for(int dx = -1; dx <= 1; dx++){
-        for(int dz = -1; dz <= 1; dz++){
-            for(int dy = 2; dy <= 3; dy++){
-                VoxelEngine::World::set_block(world_id, ivec3(loc.x + dx, loc.y + dy, loc.z + dz), leaf_block_model);
-            }
-        }
-    }
+    VoxelEngine::World::fill_box(world_id, loc + ivec3(-1, 2, -1), ivec3(3, 2, 3), leaf_block_model);
 
     VoxelEngine::World::set_block(world_id, ivec3(loc.x, loc.y + 4, loc.z), leaf_block_model);
 }
@@ -102,13 +92,7 @@ void generate_tree_overhang(int world_id, ivec3 loc) {
         VoxelEngine::World::set_block(world_id, ivec3(loc.x, loc.y + dy, loc.z), log_block_model);
     }
 
-    for(int dx = -2; dx <= 2; dx++){
-        for(int dz = -2; dz <= 2; dz++){
-            for(int dy = 3; dy <= 4; dy++){
-                VoxelEngine::World::set_block(world_id, ivec3(loc.x + dx, loc.y + dy, loc.z + dz), leaf_block_model);
-            }
-        }
-    }
+    VoxelEngine::World::fill_box(world_id, loc + ivec3(-2, 3, -2), ivec3(5, 2, 5), leaf_block_model);
 
     for(int dy = 3; dy <= 4; dy++){
         for(int dx = -2; dx <= 2; dx += 4){
@@ -118,27 +102,20 @@ void generate_tree_overhang(int world_id, ivec3 loc) {
         }
     }
     
-    for(int dx = -1; dx <= 1; dx++){
-        for(int dz = -1; dz <= 1; dz++){
-            VoxelEngine::World::set_block(world_id, ivec3(loc.x + dx, loc.y + 3, loc.z + dz), air_block);
-        }
-    }
+    VoxelEngine::World::fill_box(world_id, loc + ivec3(-1, 3, -1), ivec3(3, 1, 3), air_block);
 
-    for(int dx = -1; dx <= 1; dx++){
-        for(int dz = -1; dz <= 1; dz++){
-            VoxelEngine::World::set_block(world_id, ivec3(loc.x + dx, loc.y + 5, loc.z + dz), leaf_block_model);
-        }
-    }
+    VoxelEngine::World::fill_box(world_id, loc + ivec3(-1, 5, -1), ivec3(3, 1, 3), leaf_block_model);
 
     VoxelEngine::World::set_block(world_id, ivec3(loc.x, loc.y + 3, loc.z), log_block_model);
 }
 
-void generate_chunk(int world_id, ivec3 chunk_coords) {
+// Get the height of the grass, and of the stone, of every column of the chunk
+static void generate_heights(ivec3 chunk_coords, uint64_t seed, int heights[CHUNK_SIZE][CHUNK_SIZE], int stone_heights[CHUNK_SIZE][CHUNK_SIZE]) {
     module::Perlin perlin_height;
     perlin_height.SetOctaveCount(6);
     perlin_height.SetFrequency(2.0);
     perlin_height.SetPersistence(0.5);
-    perlin_height.SetSeed(1);
+    perlin_height.SetSeed(seed + 1);
 
     const double perlin_height_scale = 128.0;
 
@@ -146,15 +123,66 @@ void generate_chunk(int world_id, ivec3 chunk_coords) {
     perlin_stone_height.SetOctaveCount(6);
     perlin_stone_height.SetFrequency(2.0);
     perlin_stone_height.SetPersistence(0.5);
-    perlin_stone_height.SetSeed(2);
+    perlin_stone_height.SetSeed(seed + 2);
 
     const double perlin_stone_height_scale = 128.0;
 
+    ivec3 start = chunk_coords * CHUNK_SIZE;
+
+    for(int i = 0; i < CHUNK_SIZE; i++) {
+        for(int k = 0; k < CHUNK_SIZE; k++) {
+            ivec3 loc = start + ivec3(i, 0, k);
+            if (loc.y < -5) {
+                heights[i][k] = 0;
+                stone_heights[i][k] = 0;
+                continue;
+            }
+            int height = 11 + 4 * perlin_height.GetValue(loc.x / perlin_height_scale, 0, loc.z / perlin_height_scale);
+            heights[i][k] = height;
+            int stone_height = 4 * perlin_stone_height.GetValue(loc.x / perlin_stone_height_scale, 0, loc.z / perlin_stone_height_scale);
+            stone_heights[i][k] = stone_height;
+        }
+    }
+}
+
+void generate_terrain(ivec3 chunk_coords, uint64_t seed, int* buffer) {
+    // Called from the world's loader threads, so nothing here may be static
+    int heights[CHUNK_SIZE][CHUNK_SIZE];
+    int stone_heights[CHUNK_SIZE][CHUNK_SIZE];
+    generate_heights(chunk_coords, seed, heights, stone_heights);
+
+    ivec3 start = chunk_coords * CHUNK_SIZE;
+
+    for(int i = 0; i < CHUNK_SIZE; i++) {
+        for(int j = 0; j < CHUNK_SIZE; j++) {
+            for(int k = 0; k < CHUNK_SIZE; k++) {
+                ivec3 loc = start + ivec3(i, j, k);
+                int height = heights[i][k];
+                int stone_height = stone_heights[i][k];
+                int& block = buffer[(i*CHUNK_SIZE + j)*CHUNK_SIZE + k];
+                if (chunk_coords.y > 0) {
+                    // Just air
+                    block = 0;
+                } else if (loc.y < stone_height) {
+                    block = stone_block_model;
+                } else if (loc.y < height) {
+                    block = dirt_block_model;
+                } else if (loc.y == height) {
+                    block = grass_block_model;
+                } else {
+                    block = 0;
+                }
+            }
+        }
+    }
+}
+
+void generate_chunk(int world_id, ivec3 chunk_coords) {
     module::Perlin perlin_tree_probability;
     perlin_tree_probability.SetOctaveCount(6);
     perlin_tree_probability.SetFrequency(2.0);
     perlin_tree_probability.SetPersistence(0.5);
-    perlin_tree_probability.SetSeed(3);
+    perlin_tree_probability.SetSeed(WORLD_SEED + 3);
 
     const double perlin_tree_scale = 128.0;
 
@@ -165,8 +193,6 @@ void generate_chunk(int world_id, ivec3 chunk_coords) {
 
     ivec3 start = chunk_coords * CHUNK_SIZE;
 
-    bool print = (start == ivec3(0));
-
     double start_time = glfwGetTime();
 
     if (chunk_coords.y > 0) {
@@ -175,40 +201,22 @@ void generate_chunk(int world_id, ivec3 chunk_coords) {
     } else {
         static int heights[CHUNK_SIZE][CHUNK_SIZE];
         static int stone_heights[CHUNK_SIZE][CHUNK_SIZE];
-
-        for(int i = 0; i < CHUNK_SIZE; i++) {
-            for(int k = 0; k < CHUNK_SIZE; k++) {
-                ivec3 loc = start + ivec3(i, 0, k);
-                if (loc.y < -5) {
-                    heights[i][k] = 0;
-                    stone_heights[i][k] = 0;
-                    continue;
-                }
-                int height = 11 + 4 * perlin_height.GetValue(loc.x / perlin_height_scale, 0, loc.z / perlin_height_scale);
-                heights[i][k] = height;
-                int stone_height = 4 * perlin_stone_height.GetValue(loc.x / perlin_stone_height_scale, 0, loc.z / perlin_stone_height_scale);
-                stone_heights[i][k] = stone_height;
-            }
-        }
-        
-        for(int i = 0; i < CHUNK_SIZE; i++) {
-            for(int j = 0; j < CHUNK_SIZE; j++) {
-                for(int k = 0; k < CHUNK_SIZE; k++) {
-                    ivec3 loc = start + ivec3(i, j, k);
-                    //dbg("Value: (%d, %d, %d) -> %f", loc.x, loc.y, loc.z, myModule.GetValue(loc.x, loc.y, loc.z));
-                    int height = heights[i][k];
-                    int stone_height = stone_heights[i][k];
-                    if (loc.y < stone_height) {
-                        VoxelEngine::World::set_block(world_id, ivec3(loc.x, loc.y, loc.z), stone_block_model);
-                    } else if (loc.y < height) {
-                        VoxelEngine::World::set_block(world_id, ivec3(loc.x, loc.y, loc.z), dirt_block_model);
-                    } else if (loc.y == height) {
-                        VoxelEngine::World::set_block(world_id, ivec3(loc.x, loc.y, loc.z), grass_block_model);
-                    }
-                }
+        generate_heights(chunk_coords, WORLD_SEED, heights, stone_heights);
+
+        // Start from the existing blocks, so that trees from neighboring chunks are kept.
+        // Only the terrain comes from the world generator, so that's all that a save has to regenerate
+        static int blocks[CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE];
+        static int terrain[CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE];
+        VoxelEngine::World::copy_box_to_buffer(world_id, start, ivec3(CHUNK_SIZE), blocks);
+        generate_terrain(chunk_coords, WORLD_SEED, terrain);
+        for(int i = 0; i < CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE; i++) {
+            if (terrain[i]) {
+                blocks[i] = terrain[i];
             }
         }
 
+        VoxelEngine::World::paste_buffer(world_id, start, ivec3(CHUNK_SIZE), blocks);
+
         if (chunk_coords.y == 0) {
             for(int i = 0; i < CHUNK_SIZE; i++) {
                 for(int k = 0; k < CHUNK_SIZE; k++) {
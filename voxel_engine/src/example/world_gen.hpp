@@ -8,9 +8,17 @@
  * @{
  */
 
+/// Identifies @ref generate_terrain in saved chunks. Must be changed whenever generate_terrain generates anything differently
+#define WORLD_GENERATOR_ID 1
+/// The seed of the world generator
+#define WORLD_SEED 0
+
 /// Generate a chunk at the world, with coordinates given the chunk-coords
 void generate_chunk(int world_id, ivec3 chunk_coords);
 
+/// Fill the buffer with the terrain of the given chunk, without its trees. This is the generator that's registered with the world
+void generate_terrain(ivec3 chunk_coords, uint64_t seed, int* buffer);
+
 /**@}*/
 
 #endif
\ No newline at end of file
@@ -56,10 +56,18 @@ void GLArrayBuffer::reuse(const GLfloat* data, int len) {
     }
 }
 
+void GLArrayBuffer::reuse(const GLuint* data, int len) {
+    reuse((const GLfloat*)data, len);
+}
+
 void GLArrayBuffer::bind(int array_num, GLint size) {
     bind_array(array_num, this->array_buffer_id.opengl_id.value(), size);
 }
 
+void GLArrayBuffer::bind_integer(int array_num, GLint size) {
+    bind_integer_array(array_num, this->array_buffer_id.opengl_id.value(), size);
+}
+
 void GLArrayBuffer::init(const GLfloat* data, int len) {
     this->len = len;
     this->array_buffer_id.opengl_id = create_array_buffer(data, len);
@@ -243,6 +251,47 @@ void GL::bind_array(int array_num, GLuint array_buffer, GLint size) {
     );
 }
 
+void GL::bind_integer_array(int array_num, GLuint array_buffer, GLint size) {
+    glEnableVertexAttribArray(array_num); // Must match attribute
+    glBindBuffer(GL_ARRAY_BUFFER, array_buffer);
+    glVertexAttribIPointer(
+        array_num,                        // attribute. Must match the layout in the shader.
+        size,                             // size
+        GL_UNSIGNED_INT,                  // type
+        0,                                // stride
+        (void*)0                          // array buffer offset
+    );
+}
+
+// The smallest number of quads that the shared quad element buffer is allocated with, which fits most chunks
+#define MIN_QUAD_ELEMENT_BUFFER_QUADS 16384
+
+void GL::draw_quads(int num_quads) {
+    static GLuint quad_element_buffer;
+    static int quad_element_buffer_quads = 0;
+
+    if (num_quads > quad_element_buffer_quads) {
+        if (quad_element_buffer_quads == 0) {
+            glGenBuffers(1, &quad_element_buffer);
+        }
+        // Grow geometrically, so that the buffer is rarely regenerated
+        quad_element_buffer_quads = max(max(num_quads, 2*quad_element_buffer_quads), MIN_QUAD_ELEMENT_BUFFER_QUADS);
+        vector<GLuint> indices(quad_element_buffer_quads*6);
+        static const GLuint quad_order[6] = {0, 1, 2, 0, 2, 3};
+        for(int i = 0; i < quad_element_buffer_quads; i++) {
+            for(int j = 0; j < 6; j++) {
+                indices[i*6 + j] = i*4 + quad_order[j];
+            }
+        }
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad_element_buffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size()*sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    }
+
+    // The element buffer binding belongs to the bound vertex array object, so it's bound again on every draw
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad_element_buffer);
+    glDrawElements(GL_TRIANGLES, num_quads*6, GL_UNSIGNED_INT, (void*)0);
+}
+
 // *******************
 // Coordinates for Meshes
 // *******************
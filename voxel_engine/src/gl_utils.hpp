@@ -206,8 +206,12 @@ namespace GL {
         GLArrayBuffer(const GLfloat* data, int len);
         /// reuse the GLArrayBuffer for a new allocation
         void reuse(const GLfloat* data, int len);
+        /// reuse the GLArrayBuffer for a new allocation of integers
+        void reuse(const GLuint* data, int len);
         /// Bind the current GLArrayBuffer
         void bind(int array_num, GLint size);
+        /// Bind the current GLArrayBuffer, as unsigned integers rather than floats
+        void bind_integer(int array_num, GLint size);
     private:
         void init(const GLfloat* data, int len);
         GLReference array_buffer_id;
@@ -225,6 +229,15 @@ namespace GL {
     void reuse_array_buffer(GLuint array_buffer_id, const GLfloat* data, int len);
     /// Bind an OpenGL ArrayBuffer
     void bind_array(int array_num, GLuint array_buffer, GLint size);
+    /// Bind an OpenGL ArrayBuffer of unsigned integers, which the shader reads as integers
+    void bind_integer_array(int array_num, GLuint array_buffer, GLint size);
+
+    /// Draw the given number of quads from the bound vertex arrays, where every 4 vertices are the triangles (0, 1, 2) and (0, 2, 3)
+    /**
+     * The quads are drawn through an element buffer that's shared by every call,
+     * and only ever regenerated when it has to grow to fit more quads than it has before
+     */
+    void draw_quads(int num_quads);
 
     /// Bind a texture
     void bind_texture(int texture_num, GLuint shader_texture_pointer, GLuint opengl_texture_id);
@@ -0,0 +1,104 @@
+#include "heightmap.hpp"
+#include <climits>
+
+// The height of a column of blocks that's entirely air
+#define NO_HEIGHT INT_MIN
+
+#define BLOCK_INDEX(x, y, z) (((x)*CHUNK_SIZE + (y))*CHUNK_SIZE + (z))
+
+bool ChunkHeightmap::is_air() const {
+    for(uint8_t height : heights) {
+        if (height) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void compute_chunk_heightmap(const UnpackedChunk& chunk, ChunkHeightmap& heightmap) {
+    // Most chunks are entirely air or entirely solid, and so don't have to be scanned
+    if (chunk.palette.size() == 1) {
+        memset(heightmap.heights, chunk.palette[0] ? CHUNK_SIZE : 0, sizeof(heightmap.heights));
+        return;
+    }
+
+    for(int x = 0; x < CHUNK_SIZE; x++) {
+        for(int z = 0; z < CHUNK_SIZE; z++) {
+            uint8_t height = 0;
+            for(int y = CHUNK_SIZE - 1; y >= 0; y--) {
+                if (chunk.palette[chunk.palette_indices[BLOCK_INDEX(x, y, z)]]) {
+                    height = y + 1;
+                    break;
+                }
+            }
+            heightmap.heights[HEIGHTMAP_INDEX(x, z)] = height;
+        }
+    }
+}
+
+ColumnHeightmap::ColumnHeightmap() {
+    for(int& height : heights) {
+        height = NO_HEIGHT;
+    }
+}
+
+optional<int> ColumnHeightmap::get_height(int x, int z) const {
+    int height = heights[HEIGHTMAP_INDEX(x, z)];
+    if (height == NO_HEIGHT) {
+        return nullopt;
+    }
+    return height;
+}
+
+void ColumnHeightmap::set_height(int chunk_y, int x, int z, uint8_t height) {
+    int index = HEIGHTMAP_INDEX(x, z);
+    auto found = chunk_heightmaps.find(chunk_y);
+    if (found == chunk_heightmaps.end()) {
+        if (!height) {
+            return;
+        }
+        found = chunk_heightmaps.emplace(chunk_y, ChunkHeightmap()).first;
+    }
+    found->second.heights[index] = height;
+    if (!height && found->second.is_air()) {
+        chunk_heightmaps.erase(found);
+    }
+    update_height(chunk_y, index, height);
+}
+
+void ColumnHeightmap::set_chunk_heightmap(int chunk_y, const ChunkHeightmap& heightmap) {
+    if (heightmap.is_air()) {
+        chunk_heightmaps.erase(chunk_y);
+    } else {
+        chunk_heightmaps[chunk_y] = heightmap;
+    }
+    for(int i = 0; i < CHUNK_SIZE*CHUNK_SIZE; i++) {
+        update_height(chunk_y, i, heightmap.heights[i]);
+    }
+}
+
+bool ColumnHeightmap::is_air() const {
+    return chunk_heightmaps.empty();
+}
+
+void ColumnHeightmap::update_height(int chunk_y, int index, uint8_t height) {
+    int new_height = height ? chunk_y*CHUNK_SIZE + height - 1 : NO_HEIGHT;
+    if (new_height >= heights[index]) {
+        heights[index] = new_height;
+        return;
+    }
+    // Lowering a chunk that isn't the topmost one of this column of blocks doesn't change anything
+    if (floor_div(heights[index], CHUNK_SIZE) != chunk_y) {
+        return;
+    }
+
+    // No chunk above this one has a block here, so search downwards from it
+    heights[index] = NO_HEIGHT;
+    for(auto it = std::make_reverse_iterator(chunk_heightmaps.upper_bound(chunk_y)); it != chunk_heightmaps.rend(); it++) {
+        uint8_t chunk_height = it->second.heights[index];
+        if (chunk_height) {
+            heights[index] = it->first*CHUNK_SIZE + chunk_height - 1;
+            return;
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef _HEIGHTMAP_HPP_
+#define _HEIGHTMAP_HPP_
+
+#include "utils.hpp"
+#include "chunk.hpp"
+
+/**
+ *\addtogroup VoxelEngine
+ * @{
+ */
+
+/// The index of the column of blocks at the given chunk-local x and z, within a @ref ChunkHeightmap
+#define HEIGHTMAP_INDEX(x, z) ((x)*CHUNK_SIZE + (z))
+
+/// The heightmap of a single chunk
+struct ChunkHeightmap {
+    /// For every column of blocks of the chunk, by @ref HEIGHTMAP_INDEX, one plus the chunk-local y of its topmost non-air block, or 0 if every block of the column is air
+    uint8_t heights[CHUNK_SIZE*CHUNK_SIZE] = {};
+
+    /// True if every block of the chunk is air
+    bool is_air() const;
+};
+
+/// Compute the heightmap of a chunk from its @ref UnpackedChunk
+void compute_chunk_heightmap(const UnpackedChunk& chunk, ChunkHeightmap& heightmap);
+
+/// The ColumnHeightmap class tracks the topmost non-air block of every column of blocks, in a column of chunks
+/**
+ * A column of chunks is every chunk with the same x and z chunk-coordinates, and so it has @ref CHUNK_SIZE x @ref CHUNK_SIZE columns of blocks.
+ *
+ * The heightmap of every chunk in the column is kept, along with the height of each column of blocks.
+ * Raising a column of blocks is O(1). When the topmost block of a column of blocks is removed,
+ * the next block down is found by looking at only one height per chunk below it, rather than at every block below it.
+ * Chunks that are entirely air aren't kept.
+ */
+
+class ColumnHeightmap {
+public:
+    /// Creates the heightmap of a column of chunks that are entirely air
+    ColumnHeightmap();
+
+    /// Get the y-coordinate of the topmost non-air block at the given chunk-local x and z, or nullopt if every block there is air
+    optional<int> get_height(int x, int z) const;
+    /// Set the height of one column of blocks of the chunk with the given y chunk-coordinate, as it would be in that chunk's @ref ChunkHeightmap
+    void set_height(int chunk_y, int x, int z, uint8_t height);
+    /// Replace the heightmap of the chunk with the given y chunk-coordinate
+    void set_chunk_heightmap(int chunk_y, const ChunkHeightmap& heightmap);
+    /// True if every chunk of the column is entirely air
+    bool is_air() const;
+private:
+    // The heightmap of every chunk that isn't entirely air, by y chunk-coordinate
+    map<int, ChunkHeightmap> chunk_heightmaps;
+    // The y-coordinate of the topmost non-air block of every column of blocks, or NO_HEIGHT if it's entirely air
+    int heights[CHUNK_SIZE*CHUNK_SIZE];
+
+    // Update the height of a column of blocks, after the height of one of its chunks has changed
+    void update_height(int chunk_y, int index, uint8_t height);
+};
+
+/**@}*/
+
+#endif
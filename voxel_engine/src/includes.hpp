@@ -1,6 +1,7 @@
 #ifndef _INCLUDES_HPP_
 #define _INCLUDES_HPP_
 
+#ifndef VOXELCRAFT_HEADLESS
 // Include Sciter
 #include <sciter/sciter-x-lite.hpp>
 
@@ -9,6 +10,18 @@
 
 // Include GLFW
 #include <GLFW/glfw3.h>
+#else
+// Headless builds link none of Sciter, OpenGL or GLFW,
+// so only the OpenGL types that appear in declarations are defined
+typedef unsigned int GLuint;
+typedef int GLint;
+typedef float GLfloat;
+// And the world times itself with std::chrono, rather than with GLFW's timer
+#include <chrono>
+inline double glfwGetTime() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
 
 // Include GLM
 #include <glm/glm.hpp>
@@ -19,6 +32,13 @@ using namespace glm;
 #include <cstring>
 // Include standard library
 #include <functional>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <deque>
 #include <vector>
 #include <optional>
 #include <map>
@@ -0,0 +1,233 @@
+#include "io_ring.hpp"
+
+#ifdef IO_URING_SUPPORTED
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// There's no libc wrapper for these system calls, so they're called directly
+static int io_uring_setup(unsigned entries, io_uring_params* params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+// The kernel reads and writes the heads and tails of the rings concurrently
+static unsigned load_acquire(unsigned* p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static void store_release(unsigned* p, unsigned value) {
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+#endif
+
+IoRing::IoRing() {
+}
+
+IoRing::~IoRing() {
+    close();
+}
+
+#ifdef IO_URING_SUPPORTED
+
+bool IoRing::init(unsigned entries) {
+    close();
+
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = io_uring_setup(entries, &params);
+    if (fd < 0) {
+        // Either the kernel is too old, or io_uring has been disabled, such as by a container's seccomp filter
+        return false;
+    }
+    ring_fd = fd;
+
+    sq_ring_size = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries*sizeof(io_uring_cqe);
+    // Newer kernels map both rings with a single mapping
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+    sq_ring = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) {
+        sq_ring = NULL;
+        close();
+        return false;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        cq_ring = sq_ring;
+    } else {
+        cq_ring = mmap(NULL, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED) {
+            cq_ring = NULL;
+            close();
+            return false;
+        }
+    }
+    sqes_size = params.sq_entries*sizeof(io_uring_sqe);
+    sqes = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        sqes = NULL;
+        close();
+        return false;
+    }
+
+    byte* sq = (byte*)sq_ring;
+    sq_head = (unsigned*)(sq + params.sq_off.head);
+    sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    sq_array = (unsigned*)(sq + params.sq_off.array);
+    byte* cq = (byte*)cq_ring;
+    cq_head = (unsigned*)(cq + params.cq_off.head);
+    cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    cqes = cq + params.cq_off.cqes;
+    sq_entries = params.sq_entries;
+    cq_entries = params.cq_entries;
+    return true;
+}
+
+void IoRing::close() {
+    if (ring_fd < 0) {
+        return;
+    }
+    // The kernel may still be reading from or writing into the buffers of requests in flight
+    if (sqes) {
+        wait_all();
+    }
+    if (sqes) {
+        munmap(sqes, sqes_size);
+    }
+    if (cq_ring && cq_ring != sq_ring) {
+        munmap(cq_ring, cq_ring_size);
+    }
+    if (sq_ring) {
+        munmap(sq_ring, sq_ring_size);
+    }
+    ::close(ring_fd);
+    ring_fd = -1;
+    sq_ring = cq_ring = sqes = NULL;
+    num_queued = 0;
+    num_in_flight = 0;
+}
+
+void IoRing::queue(int opcode, int fd, const void* buffer, unsigned length, uint64_t offset, IoRequest* request) {
+    // The submission queue must have a free entry, and the completion queue must have room for every request, or completions could be dropped
+    if (num_queued == sq_entries) {
+        submit();
+    }
+    while (num_in_flight + num_queued + 1 > cq_entries) {
+        enter(1);
+    }
+
+    request->done = false;
+    request->result = 0;
+
+    unsigned tail = *sq_tail;
+    unsigned index = tail & *sq_mask;
+    io_uring_sqe* sqe = &((io_uring_sqe*)sqes)[index];
+    memset(sqe, 0, sizeof(io_uring_sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)buffer;
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->user_data = (uint64_t)request;
+    sq_array[index] = index;
+    store_release(sq_tail, tail + 1);
+    num_queued++;
+}
+
+void IoRing::read(int fd, void* buffer, unsigned length, uint64_t offset, IoRequest* request) {
+    queue(IORING_OP_READ, fd, buffer, length, offset, request);
+}
+
+void IoRing::write(int fd, const void* buffer, unsigned length, uint64_t offset, IoRequest* request) {
+    queue(IORING_OP_WRITE, fd, buffer, length, offset, request);
+}
+
+void IoRing::submit() {
+    if (num_queued > 0) {
+        enter(0);
+    }
+}
+
+void IoRing::enter(unsigned min_complete) {
+    unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    int submitted = io_uring_enter(ring_fd, num_queued, min_complete, flags);
+    if (submitted < 0) {
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            dbg("ERROR: io_uring_enter failed: %s", strerror(errno));
+            CRASH();
+        }
+    } else {
+        num_queued -= submitted;
+        num_in_flight += submitted;
+    }
+    reap();
+}
+
+void IoRing::reap() {
+    unsigned head = *cq_head;
+    unsigned tail = load_acquire(cq_tail);
+    while (head != tail) {
+        io_uring_cqe* cqe = &((io_uring_cqe*)cqes)[head & *cq_mask];
+        IoRequest* request = (IoRequest*)cqe->user_data;
+        request->result = cqe->res;
+        request->done = true;
+        num_in_flight--;
+        head++;
+    }
+    store_release(cq_head, head);
+}
+
+void IoRing::wait(IoRequest* request) {
+    submit();
+    while (!request->done) {
+        enter(1);
+    }
+}
+
+void IoRing::wait_all() {
+    submit();
+    while (num_in_flight > 0 || num_queued > 0) {
+        enter(1);
+    }
+}
+
+#else
+
+// Without io_uring, no ring can ever be created
+bool IoRing::init(unsigned entries) {
+    UNUSED(entries);
+    return false;
+}
+
+void IoRing::close() {
+}
+
+void IoRing::read(int fd, void* buffer, unsigned length, uint64_t offset, IoRequest* request) {
+    UNUSED(fd); UNUSED(buffer); UNUSED(length); UNUSED(offset); UNUSED(request);
+    CRASH();
+}
+
+void IoRing::write(int fd, const void* buffer, unsigned length, uint64_t offset, IoRequest* request) {
+    UNUSED(fd); UNUSED(buffer); UNUSED(length); UNUSED(offset); UNUSED(request);
+    CRASH();
+}
+
+void IoRing::submit() {
+}
+
+void IoRing::wait(IoRequest* request) {
+    UNUSED(request);
+}
+
+void IoRing::wait_all() {
+}
+
+#endif
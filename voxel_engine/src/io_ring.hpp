@@ -0,0 +1,91 @@
+#ifndef _IO_RING_HPP_
+#define _IO_RING_HPP_
+
+#include "utils.hpp"
+
+/**
+ *\addtogroup VoxelEngine
+ * @{
+ */
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+/// Defined if @ref IoRing can be backed by io_uring on this platform. Even then, the kernel may refuse to create one at runtime
+#define IO_URING_SUPPORTED
+#endif
+
+/// A single read or write queued on an @ref IoRing
+struct IoRequest {
+    /// The number of bytes transferred, or a negative errno. Only valid once done is true
+    int result = 0;
+    /// Set once the request has completed
+    bool done = false;
+};
+
+/// The IoRing class batches reads and writes into io_uring submissions, completing them asynchronously
+/**
+ * Requests are queued with @ref read and @ref write, and are only handed to the kernel by @ref submit,
+ * so many requests cost a single system call. Every buffer must stay alive until its request is done.
+ *
+ * An IoRing must only be used by one thread at a time, and so each thread that does I/O should have its own.
+ */
+
+class IoRing {
+public:
+    /// Creates an uninitialized IoRing
+    IoRing();
+    /// Waits for every request that's still in flight, and then closes the ring
+    ~IoRing();
+    /// IoRings cannot be copied, as they own their ring
+    IoRing(const IoRing& other) = delete;
+    /// IoRings cannot be copied, as they own their ring
+    IoRing& operator=(const IoRing& other) = delete;
+
+    /// Create a ring that can hold the given number of queued requests. Returns false if io_uring isn't available, in which case nothing else may be called
+    bool init(unsigned entries);
+    /// Queue a read of length bytes at the given offset of the file into the buffer, submitting earlier requests if the queue is full
+    void read(int fd, void* buffer, unsigned length, uint64_t offset, IoRequest* request);
+    /// Queue a write of length bytes from the buffer to the given offset of the file, submitting earlier requests if the queue is full
+    void write(int fd, const void* buffer, unsigned length, uint64_t offset, IoRequest* request);
+    /// Hand every queued request to the kernel, without waiting for any of them
+    void submit();
+    /// Submit every queued request, and then wait until the given request is done
+    void wait(IoRequest* request);
+    /// Submit every queued request, and then wait until every request is done
+    void wait_all();
+
+private:
+    int ring_fd = -1;
+    // The submission and completion rings, which are shared with the kernel
+    void* sq_ring = NULL;
+    size_t sq_ring_size = 0;
+    void* cq_ring = NULL;
+    size_t cq_ring_size = 0;
+    void* sqes = NULL;
+    size_t sqes_size = 0;
+    unsigned* sq_head = NULL;
+    unsigned* sq_tail = NULL;
+    unsigned* sq_mask = NULL;
+    unsigned* sq_array = NULL;
+    unsigned* cq_head = NULL;
+    unsigned* cq_tail = NULL;
+    unsigned* cq_mask = NULL;
+    void* cqes = NULL;
+    unsigned sq_entries = 0;
+    unsigned cq_entries = 0;
+    // Requests that have been queued, but not yet submitted
+    unsigned num_queued = 0;
+    // Requests that have been submitted, but haven't completed yet
+    unsigned num_in_flight = 0;
+
+    // Queue a request, making room for it first if necessary
+    void queue(int opcode, int fd, const void* buffer, unsigned length, uint64_t offset, IoRequest* request);
+    // Submit every queued request, and wait for at least min_complete requests to complete
+    void enter(unsigned min_complete);
+    // Mark every request that has completed as done
+    void reap();
+    void close();
+};
+
+/**@}*/
+
+#endif
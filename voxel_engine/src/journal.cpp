@@ -0,0 +1,281 @@
+#include "journal.hpp"
+
+// Written at the start of every journal file, so that a stray file is never replayed
+static const char JOURNAL_MAGIC[4] = {'V', 'C', 'J', '1'};
+
+// Each record is stored as [uint32 body length][body][uint32 checksum of the body],
+// where the body is the record type followed by its fields
+#define RECORD_OVERHEAD (2*sizeof(uint32_t))
+
+// FNV-1a, which is plenty to detect a record that was torn by a crash
+static uint32_t checksum(const byte* data, size_t length) {
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+template<typename T>
+static void write_field(vector<byte>& body, const T& value) {
+    const byte* bytes = (const byte*)&value;
+    body.insert(body.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+static T read_field(const byte*& cur) {
+    T value;
+    memcpy(&value, cur, sizeof(T));
+    cur += sizeof(T);
+    return value;
+}
+
+static void write_ivec3(vector<byte>& body, ivec3 v) {
+    write_field<int32_t>(body, v.x);
+    write_field<int32_t>(body, v.y);
+    write_field<int32_t>(body, v.z);
+}
+
+static ivec3 read_ivec3(const byte*& cur) {
+    int x = read_field<int32_t>(cur);
+    int y = read_field<int32_t>(cur);
+    int z = read_field<int32_t>(cur);
+    return ivec3(x, y, z);
+}
+
+Journal::Journal() {
+}
+
+Journal::~Journal() {
+    close();
+}
+
+bool Journal::open(const string& path) {
+    close();
+
+    FILE* f = fopen(path.c_str(), "ab");
+    if (!f) {
+        dbg("ERROR: Failed to open journal %s!", path.c_str());
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    file_size = ftell(f);
+    if (file_size == 0) {
+        fwrite(JOURNAL_MAGIC, 1, sizeof(JOURNAL_MAGIC), f);
+        sync_file(f);
+        file_size = sizeof(JOURNAL_MAGIC);
+    }
+    filepath = path;
+    file = f;
+    return true;
+}
+
+void Journal::close() {
+    FILE* f = file;
+    if (!f) {
+        return;
+    }
+    flush();
+    file = nullptr;
+    fclose(f);
+    file_size = 0;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.clear();
+}
+
+bool Journal::is_open() {
+    return file != nullptr;
+}
+
+void Journal::append_record(const vector<byte>& body) {
+    if (!file) {
+        return;
+    }
+    uint32_t length = body.size();
+    uint32_t sum = checksum(body.data(), body.size());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    write_field(pending, length);
+    pending.insert(pending.end(), body.begin(), body.end());
+    write_field(pending, sum);
+}
+
+void Journal::append_write_block(ivec3 location, int model, float break_amount) {
+    vector<byte> body;
+    write_field(body, JournalRecordType::WRITE_BLOCK);
+    write_ivec3(body, location);
+    write_field<int32_t>(body, model);
+    write_field(body, break_amount);
+    append_record(body);
+}
+
+void Journal::append_fill_box(ivec3 location, ivec3 size, int model) {
+    if (size.x <= 0 || size.y <= 0 || size.z <= 0) {
+        return;
+    }
+    vector<byte> body;
+    write_field(body, JournalRecordType::FILL_BOX);
+    write_ivec3(body, location);
+    write_ivec3(body, size);
+    write_field<int32_t>(body, model);
+    append_record(body);
+}
+
+void Journal::append_paste_buffer(ivec3 location, ivec3 size, const int* buffer) {
+    if (size.x <= 0 || size.y <= 0 || size.z <= 0) {
+        return;
+    }
+    vector<byte> body;
+    write_field(body, JournalRecordType::PASTE_BUFFER);
+    write_ivec3(body, location);
+    write_ivec3(body, size);
+    const byte* data = (const byte*)buffer;
+    body.insert(body.end(), data, data + size.x*size.y*size.z*sizeof(int));
+    append_record(body);
+}
+
+void Journal::append_apply_mask(ivec3 location, ivec3 size, const byte* mask, int model) {
+    if (size.x <= 0 || size.y <= 0 || size.z <= 0) {
+        return;
+    }
+    vector<byte> body;
+    write_field(body, JournalRecordType::APPLY_MASK);
+    write_ivec3(body, location);
+    write_ivec3(body, size);
+    write_field<int32_t>(body, model);
+    body.insert(body.end(), mask, mask + size.x*size.y*size.z);
+    append_record(body);
+}
+
+void Journal::append_mark_generated(ivec3 chunk_coords) {
+    vector<byte> body;
+    write_field(body, JournalRecordType::MARK_GENERATED);
+    write_ivec3(body, chunk_coords);
+    append_record(body);
+}
+
+void Journal::flush() {
+    FILE* f = file;
+    if (!f) {
+        return;
+    }
+
+    // Take the pending records, so that other threads can keep appending while they're written
+    vector<byte> records;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending.empty()) {
+            return;
+        }
+        std::swap(records, pending);
+    }
+
+    fwrite(records.data(), 1, records.size(), f);
+    sync_file(f);
+    file_size += records.size();
+}
+
+void Journal::clear() {
+    FILE* f = file;
+    if (!f) {
+        return;
+    }
+    file = nullptr;
+    fclose(f);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.clear();
+    }
+
+    // Truncate the file back down to just the magic
+    f = fopen(filepath.c_str(), "wb");
+    if (!f) {
+        dbg("ERROR: Failed to truncate journal %s!", filepath.c_str());
+        return;
+    }
+    fwrite(JOURNAL_MAGIC, 1, sizeof(JOURNAL_MAGIC), f);
+    sync_file(f);
+    file_size = sizeof(JOURNAL_MAGIC);
+    file = f;
+}
+
+size_t Journal::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return file_size + pending.size();
+}
+
+int Journal::replay(const string& path, const function<void(const JournalRecord&)>& on_record) {
+    std::ifstream journal_file(path, std::ios::binary);
+    if (!journal_file) {
+        // No journal means that there are no edits since the last save
+        return 0;
+    }
+    vector<byte> contents((std::istreambuf_iterator<char>(journal_file)), std::istreambuf_iterator<char>());
+
+    if (contents.size() < sizeof(JOURNAL_MAGIC) || memcmp(contents.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0) {
+        dbg("ERROR: %s is not a journal!", path.c_str());
+        return -1;
+    }
+
+    int num_records = 0;
+    size_t offset = sizeof(JOURNAL_MAGIC);
+    while (offset < contents.size()) {
+        const byte* cur = &contents[offset];
+        size_t remaining = contents.size() - offset;
+        if (remaining < RECORD_OVERHEAD) {
+            break;
+        }
+        uint32_t length = read_field<uint32_t>(cur);
+        if (length == 0 || remaining < RECORD_OVERHEAD + length) {
+            break;
+        }
+        const byte* body = cur;
+        cur += length;
+        if (read_field<uint32_t>(cur) != checksum(body, length)) {
+            break;
+        }
+        offset += RECORD_OVERHEAD + length;
+
+        // The checksum matched, so the body has exactly the layout that it was appended with
+        cur = body;
+        JournalRecord record;
+        record.type = read_field<JournalRecordType>(cur);
+        record.location = read_ivec3(cur);
+        switch (record.type) {
+        case JournalRecordType::WRITE_BLOCK:
+            record.model = read_field<int32_t>(cur);
+            record.break_amount = read_field<float>(cur);
+            break;
+        case JournalRecordType::FILL_BOX:
+            record.size = read_ivec3(cur);
+            record.model = read_field<int32_t>(cur);
+            break;
+        case JournalRecordType::PASTE_BUFFER:
+            record.size = read_ivec3(cur);
+            record.data = cur;
+            break;
+        case JournalRecordType::APPLY_MASK:
+            record.size = read_ivec3(cur);
+            record.model = read_field<int32_t>(cur);
+            record.data = cur;
+            break;
+        case JournalRecordType::MARK_GENERATED:
+            break;
+        default:
+            dbg("ERROR: Unknown journal record type %d!", (int)record.type);
+            continue;
+        }
+        on_record(record);
+        num_records++;
+    }
+
+    if (offset < contents.size()) {
+        // Cut off the torn record, or else records appended after it would never be replayed
+        dbg("Journal %s ends with %zu bytes of a torn record, which will be discarded", path.c_str(), contents.size() - offset);
+        journal_file.close();
+        std::error_code ec;
+        std::filesystem::resize_file(path, offset, ec);
+    }
+    return num_records;
+}
@@ -0,0 +1,111 @@
+#ifndef _JOURNAL_HPP_
+#define _JOURNAL_HPP_
+
+#include "utils.hpp"
+
+/**
+ *\addtogroup VoxelEngine
+ * @{
+ */
+
+/// The type of a @ref JournalRecord
+enum class JournalRecordType : uint8_t {
+    /// A single block was written, with the given model and break amount
+    WRITE_BLOCK = 1,
+    /// Every block in a box was set to the given model
+    FILL_BOX = 2,
+    /// Every block in a box was set from a buffer of block models
+    PASTE_BUFFER = 3,
+    /// Every block in a box with a nonzero mask byte was set to the given model
+    APPLY_MASK = 4,
+    /// The chunk at the given chunk coordinates was marked as generated
+    MARK_GENERATED = 5,
+};
+
+/// A single edit read back from a @ref Journal
+struct JournalRecord {
+    /// The type of edit
+    JournalRecordType type;
+    /// The block location, or the chunk coordinates for @ref JournalRecordType::MARK_GENERATED
+    ivec3 location;
+    /// The size of the box, for box edits
+    ivec3 size;
+    /// The block model
+    int model = 0;
+    /// The break amount, for @ref JournalRecordType::WRITE_BLOCK
+    float break_amount = 0.0f;
+    /// The buffer of block models for @ref JournalRecordType::PASTE_BUFFER, or the mask for @ref JournalRecordType::APPLY_MASK, in x-major order
+    const byte* data = nullptr;
+};
+
+/// The Journal class is an append-only log of block edits, so that an edit can be persisted without rewriting its chunk
+/**
+ * Appending a record only copies it into memory, and may be done from any thread.
+ * Records reach the disk, and are fsynced, when @ref flush is called.
+ *
+ * Every record is an overwrite of the blocks that it touches, so replaying a journal on top of region files
+ * that already contain some of its edits gives the same result as replaying it on top of the files from before those edits.
+ * Each record is checksummed, so a record that was torn by a crash ends the replay, instead of corrupting the world.
+ */
+
+class Journal {
+public:
+    /// Creates a closed Journal
+    Journal();
+    /// Flushes and closes the Journal
+    ~Journal();
+    /// Journals cannot be copied, as they own their file
+    Journal(const Journal& other) = delete;
+    /// Journals cannot be copied, as they own their file
+    Journal& operator=(const Journal& other) = delete;
+
+    /// Open the journal file at the given filepath, appending to it if it already exists
+    bool open(const string& filepath);
+    /// Flush and close the journal file. Records appended while the journal is closed are dropped
+    void close();
+    /// Whether the journal file is open
+    bool is_open();
+
+    /// @name Appending
+    /// These may be called from any thread
+    ///@{
+    /// Append a @ref JournalRecordType::WRITE_BLOCK record
+    void append_write_block(ivec3 location, int model, float break_amount);
+    /// Append a @ref JournalRecordType::FILL_BOX record
+    void append_fill_box(ivec3 location, ivec3 size, int model);
+    /// Append a @ref JournalRecordType::PASTE_BUFFER record
+    void append_paste_buffer(ivec3 location, ivec3 size, const int* buffer);
+    /// Append a @ref JournalRecordType::APPLY_MASK record
+    void append_apply_mask(ivec3 location, ivec3 size, const byte* mask, int model);
+    /// Append a @ref JournalRecordType::MARK_GENERATED record
+    void append_mark_generated(ivec3 chunk_coords);
+    ///@}
+
+    /// Write every appended record to the journal file, and fsync it
+    void flush();
+    /// Discard every record, both on disk and in memory, as they've all been folded into the region files
+    void clear();
+    /// Get the size of the journal in bytes, including records that haven't been flushed yet
+    size_t size();
+
+    /// Call on_record for every record of the journal file at the given filepath, in the order that they were appended
+    /**
+     * @return The number of records that were read, or -1 if the file exists but isn't a journal
+     */
+    static int replay(const string& filepath, const function<void(const JournalRecord&)>& on_record);
+private:
+    // Guards pending
+    std::mutex mutex;
+    // Records that have been appended, but not yet written to the file
+    vector<byte> pending;
+    std::atomic<FILE*> file{nullptr};
+    string filepath;
+    size_t file_size = 0;
+
+    // Append a single record with the given body, taking the mutex
+    void append_record(const vector<byte>& body);
+};
+
+/**@}*/
+
+#endif
@@ -1,119 +1,135 @@
 #include "megachunk.hpp"
 
-byte megachunk_serialization_buffer[MAX_MEGACHUNK_SIZE];
-
-MegaChunk::~MegaChunk() {
-    for(int i = 0; i < MEGACHUNK_SIZE; i++) {
-        for(int j = 0; j < MEGACHUNK_SIZE; j++) {
-            for(int k = 0; k < MEGACHUNK_SIZE; k++) {
-                if (chunks[i][j][k]) {
-                    free_chunkdata(chunks[i][j][k].value());
-                }
-            }
-        }
-    }
-}
+#define CHUNK_INDEX(x, y, z) (((x)*MEGACHUNK_SIZE + (y))*MEGACHUNK_SIZE + (z))
+
+// A megachunk never holds more chunks than it has chunk indices, so every chunkdata ID plus one fits in a uint16_t
+static_assert(MEGACHUNK_SIZE*MEGACHUNK_SIZE*MEGACHUNK_SIZE <= 65535, "Chunk indices must fit in a uint16_t");
 
 ChunkData* MegaChunk::create_chunk(ivec3 chunk_coords) {
-    auto& optional_chunkdata = chunks[pos_mod(chunk_coords.x, MEGACHUNK_SIZE)][pos_mod(chunk_coords.y, MEGACHUNK_SIZE)][pos_mod(chunk_coords.z, MEGACHUNK_SIZE)];
+    uint16_t& chunk_index = chunk_indices[CHUNK_INDEX(pos_mod(chunk_coords.x, MEGACHUNK_SIZE), pos_mod(chunk_coords.y, MEGACHUNK_SIZE), pos_mod(chunk_coords.z, MEGACHUNK_SIZE))];
 
     // Verify that chunk has not yet been created
-    if (optional_chunkdata) {
+    if (chunk_index) {
         dbg("ERROR: Chunk already exists!");
         return NULL;
     }
 
     // Create chunk
-    optional_chunkdata = alloc_chunkdata();
-    ChunkData* cd = get_allocated_chunkdata(optional_chunkdata.value());
+    int chunkdata_id = chunk_allocator.alloc();
+    chunk_index = chunkdata_id + 1;
+    chunk_count++;
 
-    return cd;
+    return chunk_allocator.get(chunkdata_id);
 }
 
 ChunkData* MegaChunk::get_chunk(ivec3 chunk_coords) {
-    auto opt_chunk = chunks[chunk_coords.x][chunk_coords.y][chunk_coords.z];
-    if (opt_chunk) {
-        return get_allocated_chunkdata(opt_chunk.value());
+    uint16_t chunk_index = chunk_indices[CHUNK_INDEX(chunk_coords.x, chunk_coords.y, chunk_coords.z)];
+    if (chunk_index) {
+        return chunk_allocator.get(chunk_index - 1);
     } else {
         return NULL;
     }
 }
 
-// Note: The return buffer must be freed by the caller!
-pair<byte*, int> MegaChunk::serialize() {
-    int num_chunks = 0;
-    for(int i = 0; i < MEGACHUNK_SIZE; i++) {
-        for(int j = 0; j < MEGACHUNK_SIZE; j++) {
-            for(int k = 0; k < MEGACHUNK_SIZE; k++) {
-                if (chunks[i][j][k]) {
-                    num_chunks++;
-                }
-            }
+void MegaChunk::mark_dirty(ChunkData* chunkdata) {
+    // Most writes are to chunks that are already dirty, so only do the read-modify-write when the chunk is clean
+    if (chunkdata->state.load(std::memory_order_relaxed) & CHUNK_STATE_DIRTY) {
+        return;
+    }
+    if (!(chunkdata->state.fetch_or(CHUNK_STATE_DIRTY) & CHUNK_STATE_DIRTY)) {
+        num_dirty_chunks++;
+    }
+}
+
+void MegaChunk::mark_clean() {
+    for(int i = 0; i < MEGACHUNK_SIZE*MEGACHUNK_SIZE*MEGACHUNK_SIZE; i++) {
+        if (chunk_indices[i]) {
+            chunk_allocator.get(chunk_indices[i] - 1)->state &= ~(CHUNK_STATE_DIRTY | CHUNK_STATE_UNJOURNALED);
         }
     }
+    num_dirty_chunks = 0;
+}
 
-    int buffer_size = MEGACHUNK_METADATA_SIZE + num_chunks*TOTAL_SERIALIZED_CHUNK_SIZE;
-    
-    byte* buffer = megachunk_serialization_buffer;
-    
-    // ***************
-    // Serialize MegaChunk Metadata (The Location of the MegaChunk)
-    // ***************
-    
-    //char negatives; // "00000XXX"
+int MegaChunk::serialize_chunk(ivec3 chunk_coords, byte* buffer, const ChunkGenerator* generator) {
+    ChunkData* cd = get_chunk(ivec3(pos_mod(chunk_coords.x, MEGACHUNK_SIZE), pos_mod(chunk_coords.y, MEGACHUNK_SIZE), pos_mod(chunk_coords.z, MEGACHUNK_SIZE)));
+    if (!cd) {
+        return 0;
+    }
+
+    // Reused between chunks, to avoid reallocating the palette
+    thread_local UnpackedChunk unpacked;
+    cd->chunk.snapshot().unpack(unpacked);
+    const ChunkCodec* codec = choose_chunk_codec(unpacked);
+
+    // The payload is the first byte of the chunk metadata, which also holds the codec, followed by the encoded chunk.
+    // The region file already knows where the chunk is, so the coordinates aren't needed
     buffer[0] = 0;
-    buffer[0] |= (location.x < 0 ? 1 : 0) << 2;
-    buffer[0] |= (location.y < 0 ? 1 : 0) << 1;
-    buffer[0] |= (location.z < 0 ? 1 : 0) << 0;
-    
-    // Save coordinate of megachunk
-    // (from most significant bit, to least significant bit)
-    write_integer(buffer, 1, location.x);
-    write_integer(buffer, 4, location.y);
-    write_integer(buffer, 7, location.z);
+    buffer[0] |= ((cd->state & CHUNK_STATE_GENERATED) ? 1 : 0) << CHUNK_METADATA_GENERATED_BIT;
+    buffer[0] |= (unpacked.palette.size() == 1 && unpacked.break_amounts.empty() ? 1 : 0) << CHUNK_METADATA_UNIFORM_BIT;
+
+    // A generated chunk that has barely been edited is much smaller as its edits, and is regenerated when it's loaded
+    if (generator && (cd->state & CHUNK_STATE_GENERATED)) {
+        int delta_size = encode_generator_delta(unpacked, *generator, chunk_coords, codec->get_encoded_size(unpacked), &buffer[1]);
+        if (delta_size > 0) {
+            buffer[0] |= (int)ChunkCodecType::GENERATOR_DELTA << CHUNK_METADATA_CODEC_SHIFT;
+            return 1 + delta_size;
+        }
+    }
 
-    int index = 10;
-    
-    for(uint i = 0; i < MEGACHUNK_SIZE; i++) {
-        for(int j = 0; j < MEGACHUNK_SIZE; j++) {
-            for(int k = 0; k < MEGACHUNK_SIZE; k++) {
-                if (!chunks[i][j][k]) {
-                    continue;
-                }
-                
-                ChunkData* cd = get_allocated_chunkdata(chunks[i][j][k].value());
-                Chunk& chunk = cd->chunk;
-
-                // ***************
-                // Serialize Chunk Metadata
-                // ***************
-
-                buffer[index] = cd->generated ? 1 : 0;
-
-                // Save each coordinate
-                buffer[index+1] = i;
-                buffer[index+2] = j;
-                buffer[index+3] = k;
-                
-                // ***************
-                // Serialize Chunk
-                // ***************
-
-                // Serialize individual chunk
-                auto [chunk_buffer, chunk_buffer_size] = chunk.serialize();
-                memcpy(&buffer[index+4], chunk_buffer, chunk_buffer_size);
-
-                index += TOTAL_SERIALIZED_CHUNK_SIZE;
-            }
+    buffer[0] |= (int)codec->type << CHUNK_METADATA_CODEC_SHIFT;
+    return 1 + codec->encode(unpacked, &buffer[1]);
+}
+
+void MegaChunk::deserialize_chunk(ivec3 chunk_coords, const byte* buffer, int size, const ChunkGenerator* generator) {
+    if (size < 1) {
+        dbg("ERROR: Chunk payload is empty!");
+        return;
+    }
+    bool was_generated = (buffer[0] >> CHUNK_METADATA_GENERATED_BIT) & 1;
+    // Payloads from before chunk codecs have zeroes here, which is the codec of their format
+    ChunkCodecType codec_type = (ChunkCodecType)(buffer[0] >> CHUNK_METADATA_CODEC_SHIFT);
+
+    thread_local UnpackedChunk unpacked;
+    bool decoded;
+    if (codec_type == ChunkCodecType::GENERATOR_DELTA) {
+        decoded = decode_generator_delta(&buffer[1], size - 1, generator, chunk_coords, unpacked);
+    } else {
+        const ChunkCodec* codec = get_chunk_codec(codec_type);
+        decoded = codec && codec->decode(&buffer[1], size - 1, unpacked);
+    }
+    if (!decoded) {
+        dbg("ERROR: Failed to decode chunk %d, %d, %d! Its payload will be kept as it is", chunk_coords.x, chunk_coords.y, chunk_coords.z);
+        undecodable_payloads.push_back({chunk_coords, vector<byte>(buffer, buffer + size)});
+        return;
+    }
+
+    ChunkData* cd = create_chunk(chunk_coords);
+    if (!cd) {
+        return;
+    }
+    cd->chunk.pack(unpacked);
+    cd->state = was_generated ? CHUNK_STATE_GENERATED : 0;
+
+    // The chunk is already unpacked, so this is much cheaper than scanning the chunk later
+    ChunkHeightmap heightmap;
+    compute_chunk_heightmap(unpacked, heightmap);
+    if (!heightmap.is_air()) {
+        deserialized_heightmaps.push_back({chunk_coords, heightmap});
+    }
+}
+
+const vector<byte>* MegaChunk::get_undecodable_payload(ivec3 chunk_coords) {
+    for(auto& [coords, payload] : undecodable_payloads) {
+        if (coords == chunk_coords) {
+            return &payload;
         }
     }
-    
-    return {buffer, buffer_size};
+    return NULL;
 }
 
 void MegaChunk::deserialize(byte* buffer, int size) {
-    if ((size - MEGACHUNK_METADATA_SIZE) % TOTAL_SERIALIZED_CHUNK_SIZE != 0) {
-        dbg("Size is not a multiple of TOTAL_SERIALIZED_CHUNK_SIZE! %d", size);
+    if (size < MEGACHUNK_METADATA_SIZE) {
+        dbg("Size is smaller than MEGACHUNK_METADATA_SIZE! %d", size);
         return;
     }
 
@@ -136,8 +152,14 @@ void MegaChunk::deserialize(byte* buffer, int size) {
 
     int index = 10;
 
-    while(index < size) {
-        bool was_generated = buffer[index];
+    while(index + CHUNK_METADATA_SIZE <= size) {
+        bool was_generated = (buffer[index] >> CHUNK_METADATA_GENERATED_BIT) & 1;
+        bool is_uniform = (buffer[index] >> CHUNK_METADATA_UNIFORM_BIT) & 1;
+        int chunk_buffer_size = is_uniform ? SERIALIZED_UNIFORM_CHUNK_SIZE : SERIALIZED_CHUNK_SIZE;
+
+        if (index + CHUNK_METADATA_SIZE + chunk_buffer_size > size) {
+            break;
+        }
 
         int i = buffer[index+1];
         int j = buffer[index+2];
@@ -145,10 +167,13 @@ void MegaChunk::deserialize(byte* buffer, int size) {
 
         ChunkData* cd = create_chunk(chunk_location + ivec3(i, j, k));
 
-        cd->chunk.deserialize(&buffer[index+4], SERIALIZED_CHUNK_SIZE);
-        cd->generated = was_generated;
+        // The chunks of .data files are all in the RAW format
+        thread_local UnpackedChunk unpacked;
+        get_chunk_codec(ChunkCodecType::RAW)->decode(&buffer[index+4], chunk_buffer_size, unpacked);
+        cd->chunk.pack(unpacked);
+        cd->state = was_generated ? CHUNK_STATE_GENERATED : 0;
 
-        index += TOTAL_SERIALIZED_CHUNK_SIZE;
+        index += CHUNK_METADATA_SIZE + chunk_buffer_size;
     }
 
     if (index != size) {
@@ -157,30 +182,20 @@ void MegaChunk::deserialize(byte* buffer, int size) {
     }
 }
 
-// Manual Chunk Allocation
-
-vector<ChunkData*>* MegaChunk::chunk_allocations = new vector<ChunkData*>();
-vector<int>* MegaChunk::unused_chunk_allocations = new vector<int>();
-
-int MegaChunk::alloc_chunkdata() {
-    int index;
-    if (unused_chunk_allocations->size() > 0) {
-        index = unused_chunk_allocations->back();
-        unused_chunk_allocations->pop_back();
-        // Regenerate chunk data
-        ChunkData d;
-        std::swap(*(*chunk_allocations)[index], d);
-    } else {
-        chunk_allocations->push_back(new ChunkData());
-        index = chunk_allocations->size() - 1;
-    }
-    return index;
-}
-
-ChunkData* MegaChunk::get_allocated_chunkdata(int chunkdata_id) {
-    return chunk_allocations->at(chunkdata_id);
+int MegaChunk::num_chunks() {
+    return chunk_count;
 }
 
-void MegaChunk::free_chunkdata(int chunkdata_id) {
-    unused_chunk_allocations->push_back(chunkdata_id);
+size_t MegaChunk::memory_usage() {
+    size_t bytes = sizeof(MegaChunk);
+    for(int i = 0; i < MEGACHUNK_SIZE*MEGACHUNK_SIZE*MEGACHUNK_SIZE; i++) {
+        if (chunk_indices[i]) {
+            ChunkData* cd = chunk_allocator.get(chunk_indices[i] - 1);
+            bytes += sizeof(ChunkData) - sizeof(Chunk) + cd->chunk.memory_usage();
+        }
+    }
+    for(auto& undecodable : undecodable_payloads) {
+        bytes += undecodable.second.size();
+    }
+    return bytes;
 }
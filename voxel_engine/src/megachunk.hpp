@@ -2,25 +2,51 @@
 #define _MEGACHUNK_HPP_
 
 #include "chunk.hpp"
-#include "universe.hpp"
+#include "chunk_codec.hpp"
+#include "chunk_allocator.hpp"
+#include "chunk_lock.hpp"
+#include "heightmap.hpp"
 
 /**
  *\addtogroup VoxelEngine
  * @{
  */
 
+/** @name Chunk state flags
+ * Flags of @ref ChunkData::state. CHUNK_STATE_GENERATED is saved along with the chunk, and CHUNK_STATE_DIRTY is set
+ * whenever the chunk changes. The others are claims that a thread is currently working on the chunk, as taken by @ref World::try_claim_chunk.
+ */
+///@{
+/// The chunk has been generated by the world generator
+#define CHUNK_STATE_GENERATED (1 << 0)
+/// A thread is generating the chunk
+#define CHUNK_STATE_GENERATING (1 << 1)
+/// A thread is meshing the chunk
+#define CHUNK_STATE_MESHING (1 << 2)
+/// A thread is saving the chunk
+#define CHUNK_STATE_SAVING (1 << 3)
+/// The chunk has changed since its megachunk was last saved or loaded
+#define CHUNK_STATE_DIRTY (1 << 4)
+/// The chunk was generated, but what the generator generated is neither in the journal nor in the region file yet
+#define CHUNK_STATE_UNJOURNALED (1 << 5)
+/// Every claim flag
+#define CHUNK_STATE_CLAIMS (CHUNK_STATE_GENERATING | CHUNK_STATE_MESHING | CHUNK_STATE_SAVING)
+///@}
+
 /// The ChunkData class represents a Chunk, along with any metadata for that chunk 
 
 class ChunkData {
 public:
     /// Creates a blank ChunkData, with a blank Chunk consisting of only air blocks
     ChunkData();
-    /// The last tick in which this Chunk was marked for render
+    /// The last tick in which this Chunk was marked for render. Only used by the main thread
     int last_render_mark = 0;
-    /// The render priority that this chunk has
+    /// The render priority that this chunk has. Only used by the main thread
     int priority;
-    /// True if this Chunk has been generated by the world generated already
-    bool generated = false;
+    /// The chunk state flags, see @ref CHUNK_STATE_GENERATED
+    std::atomic<uint8_t> state{0};
+    /// Held in shared mode to read the Chunk, and exclusively to modify it
+    ChunkLock lock;
     /// The Chunk itself
     Chunk chunk;
 };
@@ -32,36 +58,69 @@ public:
 
 class MegaChunk {
 public:
-  ~MegaChunk();
   /// Location of the megachunk, in megachunk-coordinates
   ivec3 location;
+  /// The last render iteration in which any chunk of this megachunk was accessed
+  std::atomic<int> last_access{0};
+  /// The number of claims held on chunks of this megachunk. Megachunks with claimed chunks are never evicted
+  std::atomic<int> num_claims{0};
+  /// The number of chunks of this megachunk that have @ref CHUNK_STATE_DIRTY set. The megachunk only has to be saved if this is nonzero
+  std::atomic<int> num_dirty_chunks{0};
   /// Create a new chunk, at the given chunk coordinates (Between 0 and MEGACHUNK_SIZE-1)
   ChunkData* create_chunk(ivec3 chunk_coords);
   /// Get a chunk in this megachunk, at the given chunk coordinates (Between 0 and MEGACHUNK_SIZE-1)
   ChunkData* get_chunk(ivec3 chunk_coords);
-  /// Serialize the megachunk into a buffer
-  pair<byte*, int> serialize();
-  /// Deserialize the megachunk from a buffer
+  /// Mark a chunk of this megachunk as dirty, as it has changed since the megachunk was last saved
+  void mark_dirty(ChunkData* chunkdata);
+  /// Mark every chunk of this megachunk as clean, as the megachunk has just been saved
+  void mark_clean();
+  /// Serialize a single chunk into a payload, at the given chunk coordinates. Returns the number of bytes written, or 0 if the chunk doesn't exist
+  /**
+   * The chunk is encoded with whichever @ref ChunkCodec encodes it in the fewest bytes, which is never more than @ref ChunkCodecType::RAW.
+   * The buffer must therefore be at least @ref TOTAL_SERIALIZED_CHUNK_SIZE bytes long.
+   *
+   * If the chunk has been generated, and a generator is given, then the chunk is instead stored as its edits against the generator,
+   * whenever that's smaller. See @ref encode_generator_delta
+   */
+  int serialize_chunk(ivec3 chunk_coords, byte* buffer, const ChunkGenerator* generator);
+  /// Create a chunk from a payload given by @ref serialize_chunk, at the given chunk coordinates. The generator must be the one it was serialized with, if any
+  /**
+   * Unless the chunk is entirely air, its heightmap is added to @ref deserialized_heightmaps
+   */
+  void deserialize_chunk(ivec3 chunk_coords, const byte* buffer, int size, const ChunkGenerator* generator);
+  /// The chunk coordinates and @ref ChunkHeightmap of every chunk created by @ref deserialize_chunk, until the world merges them into its heightmaps
+  vector<pair<ivec3, ChunkHeightmap>> deserialized_heightmaps;
+  /// The chunk coordinates and payload of every chunk that @ref deserialize_chunk couldn't decode, such as one that needs a different generator.
+  /// The payload is saved again in place of whatever the chunk holds in memory, so that it's never lost
+  vector<pair<ivec3, vector<byte>>> undecodable_payloads;
+  /// Get the payload that @ref deserialize_chunk couldn't decode at the given chunk coordinates, or NULL if there isn't one
+  const vector<byte>* get_undecodable_payload(ivec3 chunk_coords);
+  /// Deserialize the megachunk from a buffer in the .data format that predates region files
   void deserialize(byte* buffer, int size);
+  /// The number of chunks that have been created in this megachunk
+  int num_chunks();
+  /// The number of bytes of memory used by this megachunk and its chunks
+  size_t memory_usage();
 private:
-  /// Array of chunkdata, as an index to the chunk allocation
-  optional<int> chunks[MEGACHUNK_SIZE][MEGACHUNK_SIZE][MEGACHUNK_SIZE];
-
-  static vector<ChunkData*>* chunk_allocations;
-  static vector<int>* unused_chunk_allocations;
-  static int alloc_chunkdata();
-  static ChunkData* get_allocated_chunkdata(int chunkdata_id);
-  static void free_chunkdata(int chunkdata_id);
+  /// Index of every chunk, as one plus its chunkdata ID in chunk_allocator, or 0 if the chunk doesn't exist
+  uint16_t chunk_indices[MEGACHUNK_SIZE*MEGACHUNK_SIZE*MEGACHUNK_SIZE] = {};
+  /// The number of chunks that have been created in this megachunk
+  int chunk_count = 0;
+  /// Allocator that owns the chunkdata of this megachunk, freeing it when the megachunk is destroyed
+  ChunkAllocator chunk_allocator;
 };
 
 /**@}*/
 
 #define CHUNK_METADATA_SIZE (1+3)
+// Bits of the first byte of the chunk metadata
+#define CHUNK_METADATA_GENERATED_BIT 0
+#define CHUNK_METADATA_UNIFORM_BIT 1
+// The upper bits of the first byte of a chunk payload hold its ChunkCodecType
+#define CHUNK_METADATA_CODEC_SHIFT 4
 #define TOTAL_SERIALIZED_CHUNK_SIZE (CHUNK_METADATA_SIZE+SERIALIZED_CHUNK_SIZE)
 
 #define MEGACHUNK_METADATA_SIZE (1+3*3)
 #define MAX_MEGACHUNK_SIZE (MEGACHUNK_METADATA_SIZE+MEGACHUNK_SIZE*MEGACHUNK_SIZE*MEGACHUNK_SIZE*TOTAL_SERIALIZED_CHUNK_SIZE)
 
-extern byte megachunk_serialization_buffer[MAX_MEGACHUNK_SIZE];
-
 #endif
@@ -122,66 +122,196 @@ Mesh::Mesh(const char* filepath) {
                 dbg("ERROR: usetexture has not been used yet!");
             }
 
-            // Add triangle
-            triangle_data.push_back(triangle{
-                {vertex_coords.at(a_v-1), vertex_coords.at(b_v-1), vertex_coords.at(c_v-1)},
-                {uv_coords.at(a_vt-1), uv_coords.at(b_vt-1), uv_coords.at(c_vt-1)},
+            // Add the face, as a quad. A triangle is a quad whose last two vertices are the same
+            quad q = {
+                {vertex_coords.at(a_v-1), vertex_coords.at(b_v-1), vertex_coords.at(c_v-1), vertex_coords.at(c_v-1)},
+                {uv_coords.at(a_vt-1), uv_coords.at(b_vt-1), uv_coords.at(c_vt-1), uv_coords.at(c_vt-1)},
                 current_cull,
                 current_texture,
-            });
+            };
 
-            // If there's a fourth coordinate for a QUAD, add another triangle
+            // If there's a fourth coordinate, then it's a QUAD
             if (read_face_vertex(in, d_v, d_vt, d_vn)) {
-                triangle_data.push_back({
-                    {vertex_coords.at(a_v-1), vertex_coords.at(c_v-1), vertex_coords.at(d_v-1)},
-                    {uv_coords.at(a_vt-1), uv_coords.at(c_vt-1), uv_coords.at(d_vt-1)},
-                    current_cull,
-                    current_texture,
-                });
+                q.vertices[3] = vertex_coords.at(d_v-1);
+                q.uvs[3] = uv_coords.at(d_vt-1);
             }
+            quad_data.push_back(q);
         }
     }
 
-    // 3 vertices per triangle
-    vertex_buffer.resize(triangle_data.size() * 3);
-    uv_buffer.resize(triangle_data.size() * 3);    
-    
     obj_file.close();
+
+    find_cube_faces();
+}
+
+// Tolerance when comparing the coordinates read from a mesh file
+#define CUBE_EPSILON 1e-4f
+
+void Mesh::find_cube_faces() {
+    vector<CubeFace> faces(6);
+    for(int dir = 0; dir < 6; dir++) {
+        int axis = dir / 2;
+        float plane = (dir & 1) ? 1.0f : 0.0f;
+        // The two other axes, in x, y, z order
+        int u_axis = axis == 0 ? 1 : 0;
+        int v_axis = axis == 2 ? 1 : 2;
+
+        bool found = false;
+        float area = 0.0f;
+        for(const quad& q : quad_data) {
+            // A face that's never culled isn't on any side of the cube
+            if (q.cull_condition == -1) {
+                return;
+            }
+            if (q.cull_condition != dir) {
+                continue;
+            }
+
+            // Each quad is the triangles (0, 1, 2) and (0, 2, 3), where the second one is empty if the face was a triangle
+            for(int t = 0; t < 2; t++) {
+                if (t == 1 && q.vertices[3] == q.vertices[2]) {
+                    break;
+                }
+                int corners[3] = {0, 1 + t, 2 + t};
+
+                vec2 points[3];
+                vec2 uvs[3];
+                for(int j = 0; j < 3; j++) {
+                    vec3 vertex = q.vertices[corners[j]];
+                    uvs[j] = q.uvs[corners[j]];
+                    points[j] = vec2(vertex[u_axis], vertex[v_axis]);
+                    if (abs(vertex[axis] - plane) > CUBE_EPSILON
+                     || points[j].x < -CUBE_EPSILON || points[j].x > 1.0f + CUBE_EPSILON
+                     || points[j].y < -CUBE_EPSILON || points[j].y > 1.0f + CUBE_EPSILON) {
+                        return;
+                    }
+                }
+                mat2 edges(points[1] - points[0], points[2] - points[0]);
+                if (abs(determinant(edges)) < CUBE_EPSILON) {
+                    return;
+                }
+
+                // The first triangle of the face decides its texture and uv mapping, which every other triangle must share
+                CubeFace& face = faces[dir];
+                if (!found) {
+                    face.texture = q.texture;
+                    face.uv_transform = mat2(uvs[1] - uvs[0], uvs[2] - uvs[0]) * inverse(edges);
+                    face.uv_offset = uvs[0] - face.uv_transform * points[0];
+                    found = true;
+                }
+                if (q.texture != face.texture) {
+                    return;
+                }
+                for(int j = 0; j < 3; j++) {
+                    if (length(face.uv_transform * points[j] + face.uv_offset - uvs[j]) > CUBE_EPSILON) {
+                        return;
+                    }
+                }
+                area += abs(determinant(edges)) / 2.0f;
+            }
+        }
+        // The triangles must cover the whole side
+        if (!found || abs(area - 1.0f) > CUBE_EPSILON) {
+            return;
+        }
+
+        // The texture may only be rotated or mirrored, so every entry of the transform is 0, 1 or -1
+        CubeFace& face = faces[dir];
+        if (abs(abs(determinant(face.uv_transform)) - 1.0f) > CUBE_EPSILON) {
+            return;
+        }
+        for(int i = 0; i < 2; i++) {
+            for(int j = 0; j < 2; j++) {
+                float entry = face.uv_transform[i][j];
+                if (abs(entry) > CUBE_EPSILON && abs(abs(entry) - 1.0f) > CUBE_EPSILON) {
+                    return;
+                }
+                face.uv_transform[i][j] = round(entry);
+            }
+        }
+        face.uv_offset = round(face.uv_offset);
+        // And the whole face must land on the whole texture
+        for(int corner = 0; corner < 4; corner++) {
+            vec2 uv = face.uv_transform * vec2(corner & 1, corner >> 1) + face.uv_offset;
+            if (uv.x < 0.0f || uv.x > 1.0f || uv.y < 0.0f || uv.y > 1.0f) {
+                return;
+            }
+        }
+    }
+    cube_faces = faces;
 }
 
 // Offset, Scale
 tuple<byte*, byte*, int> Mesh::get_mesh_data(bool visible_neighbors[6], const vector<pair<vec2, vec2>>& texture_transformations) {
+    // Chunks are meshed on several threads at once, so each thread writes into its own buffers
+    static thread_local vector<vec3> vertex_buffer;
+    static thread_local vector<vec2> uv_buffer;
+    // 4 vertices per quad
+    if (vertex_buffer.size() < quad_data.size() * 4) {
+        vertex_buffer.resize(quad_data.size() * 4);
+        uv_buffer.resize(quad_data.size() * 4);
+    }
+
     int vertex_buffer_index = 0;
     int uv_buffer_index = 0;
-    int num_triangles = triangle_data.size();
-    int num_used_triangles = 0;
-    for(int i = 0; i < num_triangles; i++) {
-        triangle& tri = triangle_data[i];
-        // If this triangle should be culled, then we cull it
-        if (tri.cull_condition != -1 && !visible_neighbors[tri.cull_condition]) {
+    int num_quads = quad_data.size();
+    int num_used_quads = 0;
+    for(int i = 0; i < num_quads; i++) {
+        quad& q = quad_data[i];
+        // If this quad should be culled, then we cull it
+        if (q.cull_condition != -1 && !visible_neighbors[q.cull_condition]) {
             continue;
         }
 
-        int texture = tri.texture;
+        int texture = q.texture;
         const pair<vec2, vec2>& transformation = texture_transformations.at(texture);
 
-        for(int j = 0; j < 3; j++) {
+        for(int j = 0; j < 4; j++) {
             // Copy vertex position over
-            vertex_buffer[vertex_buffer_index+j] = tri.vertices[j];
+            vertex_buffer[vertex_buffer_index+j] = q.vertices[j];
             // Copy uv over, making sure to transform the UV to the correct location
-            uv_buffer[uv_buffer_index+j] = transformation.first + tri.uvs[j] * transformation.second;
+            uv_buffer[uv_buffer_index+j] = transformation.first + q.uvs[j] * transformation.second;
         }
-        vertex_buffer_index += 3;
-        uv_buffer_index += 3;
-        num_used_triangles++;
+        vertex_buffer_index += 4;
+        uv_buffer_index += 4;
+        num_used_quads++;
     }
-    return {(byte*)&vertex_buffer[0], (byte*)&uv_buffer[0], num_used_triangles};
+    return {(byte*)vertex_buffer.data(), (byte*)uv_buffer.data(), num_used_quads};
+}
+
+tuple<byte*, byte*, byte*, int> Mesh::get_tile_mesh_data(bool visible_neighbors[6], const vector<int>& texture_tiles) {
+    static thread_local vector<vec3> vertex_buffer;
+    static thread_local vector<vec2> uv_buffer;
+    static thread_local vector<int> tile_buffer;
+    if (vertex_buffer.size() < quad_data.size() * 4) {
+        vertex_buffer.resize(quad_data.size() * 4);
+        uv_buffer.resize(quad_data.size() * 4);
+        tile_buffer.resize(quad_data.size());
+    }
+
+    int num_used_quads = 0;
+    for(const quad& q : quad_data) {
+        if (q.cull_condition != -1 && !visible_neighbors[q.cull_condition]) {
+            continue;
+        }
+        for(int j = 0; j < 4; j++) {
+            vertex_buffer[num_used_quads*4+j] = q.vertices[j];
+            uv_buffer[num_used_quads*4+j] = q.uvs[j];
+        }
+        tile_buffer[num_used_quads] = texture_tiles.at(q.texture);
+        num_used_quads++;
+    }
+    return {(byte*)vertex_buffer.data(), (byte*)uv_buffer.data(), (byte*)tile_buffer.data(), num_used_quads};
 }
 
 const vector<string>& Mesh::get_texture_names() {
     return this->textures;
 }
 
+const vector<CubeFace>& Mesh::get_cube_faces() {
+    return this->cube_faces;
+}
+
 /*
 void Mesh::render(const mat4& PV, mat4& M) {
     glUseProgram(opengl_shader);
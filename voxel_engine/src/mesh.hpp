@@ -10,6 +10,17 @@
  * @{
  */
 
+/// A face of a @ref Mesh that's a unit cube, see @ref Mesh::get_cube_faces
+struct CubeFace {
+    /// The index of the face's texture, in @ref Mesh::get_texture_names
+    int texture;
+    /// Together with uv_offset, maps a point on the face to its uv on the texture.
+    /// The point is given by its two coordinates that aren't along the face's axis, in x, y, z order
+    mat2 uv_transform;
+    /// The uv of the face's corner that's closest to the origin
+    vec2 uv_offset;
+};
+
 /// The Mesh class represents a specific mesh with vertex coordinates, uv coordinates, textures, and shaders applied
 
 class Mesh {
@@ -19,18 +30,34 @@ public:
     /// Create a Mesh from a .obj file
     Mesh(const char* filepath);
 
-    /// Returns (vertex data, uv data, num_triangles)
+    /// Returns (vertex data, uv data, num_quads)
     /**
+     * Every face of the mesh is a quad of 4 vertices, which is drawn as the triangles (0, 1, 2) and (0, 2, 3), see GL::draw_quads.
+     * A face that was a triangle in the mesh file repeats its last vertex, so that its second triangle is empty.
+     *
      * @param visible_neighbors Whether or not the neighbor in a given direction is visible.
-     * If it is, then the mesh_data will render that side. Otherwise, those triangles will be culled.
+     * If it is, then the mesh_data will render that side. Otherwise, those quads will be culled.
      * The array of 6 is expected to be given in the following order:
      * negative x, positive x, negative y, positive y, negative z, positive z
      * @param texture_transformations A mesh consists of N textures on the texture atlas.
      * texture_transformations will describe the offset and scale for each of the N textures, so that
      * the UV coordinates can properly view the texture on the texture atlas.
+     *
+     * This may be called from any thread. The returned buffers belong to the calling thread,
+     * and are only valid until that thread next calls get_mesh_data.
      */
     tuple<byte*, byte*, int> get_mesh_data(bool visible_neighbors[6], const vector<pair<vec2, vec2>>& texture_transformations);
 
+    /// Returns (vertex data, uv data, tile data, num_quads), like get_mesh_data, but with the uvs left on each quad's own texture
+    /**
+     * @param visible_neighbors As in get_mesh_data
+     * @param texture_tiles The bitmap ID on the texture atlas of each of the N textures of the mesh.
+     * The tile data holds the bitmap ID of every quad's texture, as an int per quad.
+     *
+     * This may be called from any thread, with the same restrictions as get_mesh_data.
+     */
+    tuple<byte*, byte*, byte*, int> get_tile_mesh_data(bool visible_neighbors[6], const vector<int>& texture_tiles);
+
     /// Gets the names of the textures for this mesh
     /**
      * For example, cube.obj will return "negative_x", "positive_x", etc.
@@ -39,20 +66,30 @@ public:
      * that texture to where it located on the texture atlas.
      */
     const vector<string>& get_texture_names();
-private:
-    vector<vec3> vertex_buffer;
-    vector<vec2> uv_buffer;
 
-    struct triangle {
-        vec3 vertices[3];
-        vec2 uvs[3];
+    /// Gets the six faces of the mesh, in the same order as get_mesh_data interprets visible_neighbors, if the mesh is a unit cube. Otherwise, it's empty
+    /**
+     * A mesh is a unit cube if it has no faces that are never culled, and each of its faces covers one side of the unit cube,
+     * is culled by the neighbor on that side, and shows exactly the whole of one texture.
+     * The texture may be rotated or mirrored, but not scaled, so that it tiles when the face is stretched across several blocks.
+     */
+    const vector<CubeFace>& get_cube_faces();
+private:
+    // A face of the mesh. Triangles repeat their last vertex
+    struct quad {
+        vec3 vertices[4];
+        vec2 uvs[4];
         int cull_condition;
         int texture;
     };
 
     vector<int> texture_atlas_ids;
     vector<string> textures;
-    vector<triangle> triangle_data;
+    vector<quad> quad_data;
+    vector<CubeFace> cube_faces;
+
+    // Fill cube_faces, if the faces form a unit cube
+    void find_cube_faces();
 
     Mesh();
 };
@@ -14,9 +14,11 @@ Component::Component(map<string, mat4> perspectives, int mesh_id, vec3 pivot, ma
 
     // Find texture transformations for each texture name
     texture_transformations.resize(texture_names.size());
+    texture_tiles.resize(texture_names.size());
     for(uint i = 0; i < texture_names.size(); i++) {
         // For the ith texture name, find the texture_id associated with it
         int atlas_texture_id = textures.at(texture_names[i]);
+        texture_tiles[i] = atlas_texture_id;
         ivec2 itop_left = get_universe()->get_atlasser()->get_top_left(atlas_texture_id);
         vec2 top_left = vec2(itop_left);
 
@@ -41,6 +43,18 @@ tuple<byte*, byte*, int> Component::get_mesh_data(bool visible_neighbors[6]) {
     return get_universe()->get_mesh(this->mesh_id)->get_mesh_data(visible_neighbors, this->texture_transformations);
 }
 
+tuple<byte*, byte*, byte*, int> Component::get_tile_mesh_data(bool visible_neighbors[6]) {
+    return get_universe()->get_mesh(this->mesh_id)->get_tile_mesh_data(visible_neighbors, this->texture_tiles);
+}
+
+const vector<CubeFace>& Component::get_cube_faces() {
+    return get_universe()->get_mesh(this->mesh_id)->get_cube_faces();
+}
+
+const vector<int>& Component::get_texture_tiles() {
+    return this->texture_tiles;
+}
+
 const bool* Component::get_opacities() {
     return this->opacities;
 }
@@ -71,6 +85,10 @@ Model::Model(vector<string> valid_properties, SpecifiedModelGenerator model_gene
     this->model_generator = model_generator;   
 }
 
+// Guards the cache of every model, as chunks are meshed on several threads at once.
+// Cached model instances are never removed, so references to them stay valid after it's released
+static std::mutex model_cache_mutex;
+
 const vector<ComponentPossibilities>& Model::generate_model_instance(const map<string,string>& properties) {
     string key = "";
     for(auto& s : properties) {
@@ -79,6 +97,7 @@ const vector<ComponentPossibilities>& Model::generate_model_instance(const map<s
         key += s.second;
         key += ",";
     }
+    std::lock_guard<std::mutex> lock(model_cache_mutex);
     if (!cache.count(key)) {
         cache[key] = this->model_generator(properties);
     }
@@ -111,12 +130,12 @@ static void mesh_render(const mat4& PV, const mat4& M, tuple<byte*, byte*, int>
     glUniformMatrix4fv(M_matrix_shader_pointer, 1, GL_FALSE, &M[0][0]);
 
 
-    int num_triangles = get<2>(mesh_data);
+    int num_quads = get<2>(mesh_data);
 
     GLuint vertex_buffer;
     GLuint uv_buffer;
-    vertex_buffer = create_array_buffer((GLfloat*)get<0>(mesh_data), num_triangles*3*3*sizeof(GLfloat));
-    uv_buffer = create_array_buffer((GLfloat*)get<1>(mesh_data), num_triangles*3*2*sizeof(GLfloat));
+    vertex_buffer = create_array_buffer((GLfloat*)get<0>(mesh_data), num_quads*4*3*sizeof(GLfloat));
+    uv_buffer = create_array_buffer((GLfloat*)get<1>(mesh_data), num_quads*4*2*sizeof(GLfloat));
 
     // 1st attribute buffer : vertices
     bind_array(0, vertex_buffer, 3);
@@ -124,8 +143,8 @@ static void mesh_render(const mat4& PV, const mat4& M, tuple<byte*, byte*, int>
     // 2nd attribute buffer : colors
     bind_array(1, uv_buffer, 2);
 
-    // Draw the triangle !
-    glDrawArrays(GL_TRIANGLES, 0, num_triangles*3); // Starting from vertex 0; 3 vertices total -> 1 triangle
+    // Draw the quads !
+    draw_quads(num_quads);
 
     glDisableVertexAttribArray(0);
     glDisableVertexAttribArray(1);
@@ -30,6 +30,12 @@ public:
     Component(map<string, mat4> perspectives, int mesh_id, vec3 pivot, map<string,int> textures, bool opacities[6]);
     /// Retrives the mesh and uv data for this component
     tuple<byte*, byte*, int> get_mesh_data(bool visible_neighbors[6]);
+    /// Retrives the mesh and uv data for this component, with the uvs left on each texture's own tile. See Mesh::get_tile_mesh_data
+    tuple<byte*, byte*, byte*, int> get_tile_mesh_data(bool visible_neighbors[6]);
+    /// Retrives the six faces of the component's mesh, if it's a unit cube. See Mesh::get_cube_faces
+    const vector<CubeFace>& get_cube_faces();
+    /// Retrives the bitmap ID on the texture atlas of each of the mesh's textures, in the same order as Mesh::get_texture_names
+    const vector<int>& get_texture_tiles();
     /// Retrives the opacities information
     const bool* get_opacities();
     /// Retrives the matrix that represents a given perspective
@@ -38,6 +44,7 @@ public:
     vec3 get_pivot();
 private:
     vector<pair<vec2, vec2>> texture_transformations;
+    vector<int> texture_tiles;
     map<string, mat4> perspectives;
     int mesh_id;
     vec3 pivot;
@@ -80,6 +87,9 @@ public:
      */
     Model(vector<string> valid_properties, SpecifiedModelGenerator model_generator);
     /// Generate a model instance based on the given properties. This will be an array of components to render. (Will call the internal model_generator)
+    /**
+     * Model instances are cached, so the model_generator is only called once per set of properties. This may be called from any thread.
+     */
     const vector<ComponentPossibilities>& generate_model_instance(const map<string,string>& properties);
     /// Render the model given a selection of parameters
     /**
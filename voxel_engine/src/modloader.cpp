@@ -109,6 +109,11 @@ all_functions[name] = (asObject(getTypedInstanceExport(intrinsicsInstance, name,
   WASM_IMPORT(VoxelEngineWASM::World::set_block);
   WASM_IMPORT(VoxelEngineWASM::World::get_break_amount);
   WASM_IMPORT(VoxelEngineWASM::World::set_break_amount);
+  WASM_IMPORT(VoxelEngineWASM::World::get_height);
+  WASM_IMPORT(VoxelEngineWASM::World::fill_box);
+  WASM_IMPORT(VoxelEngineWASM::World::copy_box_to_buffer);
+  WASM_IMPORT(VoxelEngineWASM::World::paste_buffer);
+  WASM_IMPORT(VoxelEngineWASM::World::apply_mask);
   WASM_IMPORT(VoxelEngineWASM::World::restart_world);
   WASM_IMPORT(VoxelEngineWASM::World::load_world);
   WASM_IMPORT(VoxelEngineWASM::World::save_world);
@@ -0,0 +1,442 @@
+#include "region_file.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// Written at the start of every region file, followed by the format version
+static const char REGION_MAGIC[4] = {'V', 'C', 'R', 'G'};
+#define REGION_VERSION 1
+#define TABLE_OFFSET (sizeof(REGION_MAGIC) + sizeof(uint32_t))
+#define HEADER_SIZE (TABLE_OFFSET + REGION_NUM_CHUNKS*sizeof(TableEntry))
+// Don't bother compacting until at least this many bytes would be reclaimed
+#define COMPACTION_MIN_BYTES (4*1024*1024)
+
+#define REGION_CHUNK_INDEX(x, y, z) (((x)*REGION_CHUNK_SIZE + (y))*REGION_CHUNK_SIZE + (z))
+
+static int get_chunk_index(ivec3 chunk_coords) {
+    return REGION_CHUNK_INDEX(pos_mod(chunk_coords.x, REGION_CHUNK_SIZE), pos_mod(chunk_coords.y, REGION_CHUNK_SIZE), pos_mod(chunk_coords.z, REGION_CHUNK_SIZE));
+}
+
+static std::atomic<StorageBackend> storage_backend{StorageBackend::BLOCKING};
+
+// Get the io_uring of the calling thread, or NULL if io_uring isn't the storage backend
+static IoRing* get_io_ring() {
+    if (storage_backend != StorageBackend::IO_URING) {
+        return NULL;
+    }
+    thread_local unique_ptr<IoRing> io_ring;
+    thread_local bool failed = false;
+    if (!io_ring && !failed) {
+        io_ring.reset(new IoRing());
+        if (!io_ring->init(REGION_IO_RING_ENTRIES)) {
+            dbg("ERROR: Failed to create an io_uring, falling back to blocking I/O on this thread");
+            io_ring.reset();
+            failed = true;
+        }
+    }
+    return io_ring.get();
+}
+
+static int get_fd(FILE* file) {
+#ifdef _WIN32
+    return _fileno(file);
+#else
+    return fileno(file);
+#endif
+}
+
+bool RegionFile::set_storage_backend(StorageBackend backend) {
+    if (backend == StorageBackend::IO_URING) {
+        IoRing test_ring;
+        if (!test_ring.init(1)) {
+            return false;
+        }
+    }
+    storage_backend = backend;
+    return true;
+}
+
+StorageBackend RegionFile::get_storage_backend() {
+    return storage_backend;
+}
+
+RegionFile::RegionFile() {
+}
+
+RegionFile::~RegionFile() {
+    close();
+}
+
+bool RegionFile::open(const string& path) {
+    close();
+
+    FILE* f = fopen(path.c_str(), "r+b");
+    if (!f) {
+        // Create an empty region, whose table points nowhere
+        f = fopen(path.c_str(), "w+b");
+        if (!f) {
+            dbg("ERROR: Failed to create region file %s!", path.c_str());
+            return false;
+        }
+        vector<byte> header(HEADER_SIZE, 0);
+        uint32_t version = REGION_VERSION;
+        memcpy(&header[0], REGION_MAGIC, sizeof(REGION_MAGIC));
+        memcpy(&header[sizeof(REGION_MAGIC)], &version, sizeof(version));
+        fwrite(header.data(), 1, header.size(), f);
+        sync_file(f);
+    }
+
+    std::error_code ec;
+    end_of_file = std::filesystem::file_size(path, ec);
+    if (ec || end_of_file < HEADER_SIZE) {
+        dbg("ERROR: %s is not a region file!", path.c_str());
+        fclose(f);
+        return false;
+    }
+
+    file = f;
+    filepath = path;
+    map();
+    if (!mapping || memcmp(mapping, REGION_MAGIC, sizeof(REGION_MAGIC)) != 0) {
+        dbg("ERROR: %s is not a region file!", path.c_str());
+        close();
+        return false;
+    }
+
+    live_bytes = 0;
+    for(int i = 0; i < REGION_NUM_CHUNKS; i++) {
+        live_bytes += get_entry(i).length;
+    }
+    return true;
+}
+
+void RegionFile::close() {
+    if (!file) {
+        return;
+    }
+    // The kernel may still be reading from the buffers of queued writes
+    finish_writes();
+    unmap();
+    fclose(file);
+    file = nullptr;
+    end_of_file = 0;
+    live_bytes = 0;
+    pending_entries.clear();
+}
+
+bool RegionFile::is_open() {
+    return file != nullptr;
+}
+
+const string& RegionFile::get_filepath() {
+    return filepath;
+}
+
+void RegionFile::map() {
+    // Everything written must be visible to the mapping
+    fflush(file);
+#ifdef _WIN32
+    HANDLE file_handle = (HANDLE)_get_osfhandle(_fileno(file));
+    mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    void* memory = mapping_handle ? MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!memory) {
+#else
+    void* memory = mmap(NULL, end_of_file, PROT_READ, MAP_SHARED, fileno(file), 0);
+    if (memory == MAP_FAILED) {
+#endif
+        dbg("ERROR: Failed to map region file %s!", filepath.c_str());
+        mapping = NULL;
+        return;
+    }
+    mapping = (byte*)memory;
+    mapping_size = end_of_file;
+}
+
+void RegionFile::unmap() {
+    if (!mapping) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(mapping);
+    CloseHandle(mapping_handle);
+    mapping_handle = NULL;
+#else
+    munmap(mapping, mapping_size);
+#endif
+    mapping = NULL;
+    mapping_size = 0;
+}
+
+RegionFile::TableEntry RegionFile::get_entry(int index) {
+    TableEntry entry;
+    memcpy(&entry, mapping + TABLE_OFFSET + index*sizeof(TableEntry), sizeof(TableEntry));
+    // A corrupt entry must never point outside of the mapping
+    if (entry.length && (entry.offset < HEADER_SIZE || (size_t)entry.offset + entry.length > mapping_size)) {
+        dbg("ERROR: Chunk %d of %s is out of bounds!", index, filepath.c_str());
+        return TableEntry{0, 0};
+    }
+    return entry;
+}
+
+bool RegionFile::has_megachunk(ivec3 megachunk_coords) {
+    if (!mapping) {
+        return false;
+    }
+    ivec3 first_chunk = megachunk_coords*MEGACHUNK_SIZE;
+    for(int i = 0; i < MEGACHUNK_SIZE; i++) {
+        for(int j = 0; j < MEGACHUNK_SIZE; j++) {
+            for(int k = 0; k < MEGACHUNK_SIZE; k++) {
+                if (get_entry(get_chunk_index(first_chunk + ivec3(i, j, k))).length) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+pair<const byte*, int> RegionFile::read_chunk(ivec3 chunk_coords) {
+    if (!mapping) {
+        return {NULL, 0};
+    }
+    // Payloads are never overwritten in-place, so until the next flush the table still points at the previous payload
+    TableEntry entry = get_entry(get_chunk_index(chunk_coords));
+    if (!entry.length) {
+        return {NULL, 0};
+    }
+    return {mapping + entry.offset, entry.length};
+}
+
+void RegionFile::read_megachunk(ivec3 megachunk_coords, const function<void(ivec3, const byte*, int)>& on_chunk) {
+    if (!mapping) {
+        return;
+    }
+    IoRing* io_ring = get_io_ring();
+    ivec3 first_chunk = megachunk_coords*MEGACHUNK_SIZE;
+    if (!io_ring) {
+        for(int i = 0; i < MEGACHUNK_SIZE; i++) {
+            for(int j = 0; j < MEGACHUNK_SIZE; j++) {
+                for(int k = 0; k < MEGACHUNK_SIZE; k++) {
+                    auto [payload, payload_size] = read_chunk(first_chunk + ivec3(i, j, k));
+                    if (payload) {
+                        on_chunk(first_chunk + ivec3(i, j, k), payload, payload_size);
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+    // Order the payloads as they're laid out in the file, so that payloads that are next to each other can be read together
+    thread_local vector<pair<TableEntry, ivec3>> entries;
+    entries.clear();
+    for(int i = 0; i < MEGACHUNK_SIZE; i++) {
+        for(int j = 0; j < MEGACHUNK_SIZE; j++) {
+            for(int k = 0; k < MEGACHUNK_SIZE; k++) {
+                TableEntry entry = get_entry(get_chunk_index(first_chunk + ivec3(i, j, k)));
+                if (entry.length) {
+                    entries.push_back({entry, first_chunk + ivec3(i, j, k)});
+                }
+            }
+        }
+    }
+    sort(entries.begin(), entries.end(), [](const pair<TableEntry, ivec3>& a, const pair<TableEntry, ivec3>& b) -> bool {
+        return a.first.offset < b.first.offset;
+    });
+
+    // Payloads are read into the buffer in the same order, so every run of adjacent payloads is a single read
+    thread_local vector<byte> buffer;
+    thread_local vector<IoRequest> requests;
+    // The file offset and length of every read
+    thread_local vector<TableEntry> reads;
+    size_t total_length = 0;
+    reads.clear();
+    for(auto& [entry, chunk_coords] : entries) {
+        if (!reads.empty() && reads.back().offset + reads.back().length == entry.offset) {
+            reads.back().length += entry.length;
+        } else {
+            reads.push_back(entry);
+        }
+        total_length += entry.length;
+    }
+    buffer.resize(total_length);
+    requests.assign(reads.size(), IoRequest());
+    size_t buffer_offset = 0;
+    for(size_t i = 0; i < reads.size(); i++) {
+        io_ring->read(get_fd(file), &buffer[buffer_offset], reads[i].length, reads[i].offset, &requests[i]);
+        buffer_offset += reads[i].length;
+    }
+    io_ring->submit();
+    buffer_offset = 0;
+    for(size_t i = 0; i < reads.size(); i++) {
+        io_ring->wait(&requests[i]);
+        // Short and failed reads are very rare, and the memory mapping always has the payloads
+        if (requests[i].result != (int)reads[i].length) {
+            memcpy(&buffer[buffer_offset], mapping + reads[i].offset, reads[i].length);
+        }
+        buffer_offset += reads[i].length;
+    }
+
+    buffer_offset = 0;
+    for(auto& [entry, chunk_coords] : entries) {
+        on_chunk(chunk_coords, &buffer[buffer_offset], entry.length);
+        buffer_offset += entry.length;
+    }
+}
+
+void RegionFile::write_chunk(ivec3 chunk_coords, const byte* payload, int length) {
+    if (!file) {
+        dbg("ERROR: Writing to a closed region file!");
+        return;
+    }
+    if (end_of_file + length > UINT32_MAX) {
+        dbg("ERROR: Region file %s is full!", filepath.c_str());
+        return;
+    }
+    IoRing* io_ring = get_io_ring();
+    if (io_ring) {
+        // Payloads are appended, so they can be gathered into a single write
+        if (write_buffer.empty()) {
+            write_buffer_offset = end_of_file;
+        }
+        write_buffer.insert(write_buffer.end(), payload, payload + length);
+        if (write_buffer.size() >= REGION_WRITE_BATCH_SIZE) {
+            queue_write_buffer(io_ring);
+            io_ring->submit();
+        }
+    } else {
+        fseek(file, end_of_file, SEEK_SET);
+        fwrite(payload, 1, length, file);
+    }
+
+    int index = get_chunk_index(chunk_coords);
+    TableEntry entry{(uint32_t)end_of_file, (uint32_t)length};
+    end_of_file += length;
+
+    // If the chunk was already written since the last flush, that payload is simply never pointed to
+    for(auto& p : pending_entries) {
+        if (p.first == index) {
+            p.second = entry;
+            return;
+        }
+    }
+    pending_entries.push_back({index, entry});
+}
+
+void RegionFile::queue_write_buffer(IoRing* io_ring) {
+    unique_ptr<InFlightWrite> write(new InFlightWrite());
+    write->buffer.swap(write_buffer);
+    write->offset = write_buffer_offset;
+    write->io_ring = io_ring;
+    io_ring->write(get_fd(file), write->buffer.data(), write->buffer.size(), write->offset, &write->request);
+    in_flight_writes.push_back(std::move(write));
+}
+
+void RegionFile::finish_writes() {
+    if (!write_buffer.empty()) {
+        IoRing* io_ring = get_io_ring();
+        if (io_ring) {
+            queue_write_buffer(io_ring);
+        } else {
+            // The storage backend has changed since these payloads were written
+            fseek(file, write_buffer_offset, SEEK_SET);
+            fwrite(write_buffer.data(), 1, write_buffer.size(), file);
+            write_buffer.clear();
+        }
+    }
+    for(auto& write : in_flight_writes) {
+        write->io_ring->wait(&write->request);
+        // Rewrite whatever the kernel didn't write, with a blocking write
+        size_t written = std::max(write->request.result, 0);
+        if (written < write->buffer.size()) {
+            if (write->request.result < 0) {
+                dbg("ERROR: Failed to write to %s: %s", filepath.c_str(), strerror(-write->request.result));
+            }
+            fseek(file, write->offset + written, SEEK_SET);
+            fwrite(write->buffer.data() + written, 1, write->buffer.size() - written, file);
+        }
+    }
+    in_flight_writes.clear();
+}
+
+void RegionFile::flush() {
+    if (!file || pending_entries.empty()) {
+        return;
+    }
+    finish_writes();
+
+    // The payloads must be on the disk before the table points to them
+    sync_file(file);
+    for(auto& [index, entry] : pending_entries) {
+        live_bytes += entry.length;
+        live_bytes -= get_entry(index).length;
+        fseek(file, TABLE_OFFSET + index*sizeof(TableEntry), SEEK_SET);
+        fwrite(&entry, sizeof(TableEntry), 1, file);
+    }
+    sync_file(file);
+    pending_entries.clear();
+
+    // Remap, so that the mapping covers the new payloads
+    unmap();
+    map();
+
+    size_t unused_bytes = end_of_file - HEADER_SIZE - live_bytes;
+    if (unused_bytes > live_bytes && unused_bytes > COMPACTION_MIN_BYTES) {
+        compact();
+    }
+}
+
+void RegionFile::compact() {
+    string temp_filepath = filepath + ".tmp";
+    FILE* f = fopen(temp_filepath.c_str(), "wb");
+    if (!f) {
+        dbg("ERROR: Failed to create %s!", temp_filepath.c_str());
+        return;
+    }
+
+    // Lay the payloads out back-to-back, in table order
+    vector<TableEntry> old_table(REGION_NUM_CHUNKS);
+    vector<TableEntry> new_table(REGION_NUM_CHUNKS);
+    size_t offset = HEADER_SIZE;
+    for(int i = 0; i < REGION_NUM_CHUNKS; i++) {
+        old_table[i] = get_entry(i);
+        if (old_table[i].length) {
+            new_table[i] = TableEntry{(uint32_t)offset, old_table[i].length};
+            offset += old_table[i].length;
+        } else {
+            new_table[i] = TableEntry{0, 0};
+        }
+    }
+
+    uint32_t version = REGION_VERSION;
+    fwrite(REGION_MAGIC, 1, sizeof(REGION_MAGIC), f);
+    fwrite(&version, sizeof(version), 1, f);
+    fwrite(new_table.data(), sizeof(TableEntry), new_table.size(), f);
+    for(int i = 0; i < REGION_NUM_CHUNKS; i++) {
+        if (old_table[i].length) {
+            fwrite(mapping + old_table[i].offset, 1, old_table[i].length, f);
+        }
+    }
+    sync_file(f);
+    fclose(f);
+
+    // The new file only replaces the old one once it's complete, so a crash leaves one or the other
+    string path = filepath;
+    close();
+    std::error_code ec;
+    std::filesystem::rename(temp_filepath, path, ec);
+    if (ec) {
+        dbg("ERROR: Failed to replace %s with its compacted copy!", path.c_str());
+    }
+    open(path);
+}
+
+size_t RegionFile::file_size() {
+    return end_of_file;
+}
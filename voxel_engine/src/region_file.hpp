@@ -0,0 +1,144 @@
+#ifndef _REGION_FILE_HPP_
+#define _REGION_FILE_HPP_
+
+#include "utils.hpp"
+#include "megachunk.hpp"
+#include "io_ring.hpp"
+
+/**
+ *\addtogroup VoxelEngine
+ * @{
+ */
+
+/// The amount of megachunks wide a region is in any direction
+#define REGION_SIZE 2
+/// The amount of chunks wide a region is in any direction
+#define REGION_CHUNK_SIZE (REGION_SIZE*MEGACHUNK_SIZE)
+/// The number of chunks that a region can hold
+#define REGION_NUM_CHUNKS (REGION_CHUNK_SIZE*REGION_CHUNK_SIZE*REGION_CHUNK_SIZE)
+/// With @ref StorageBackend::IO_URING, written payloads are gathered into batches of this many bytes, each of which is a single write
+#define REGION_WRITE_BATCH_SIZE (1024*1024)
+/// The number of requests that each thread's io_uring can queue at once
+#define REGION_IO_RING_ENTRIES 256
+
+/// The way that every @ref RegionFile reads and writes chunks, see @ref RegionFile::set_storage_backend
+enum class StorageBackend {
+    /// Chunks are read through a memory mapping of the region file, and written with blocking writes
+    BLOCKING,
+    /// Chunk reads and writes are batched into io_uring submissions, which the kernel completes asynchronously. Only available on Linux
+    IO_URING,
+};
+
+/// The RegionFile class stores the chunks of a @ref REGION_SIZE x @ref REGION_SIZE x @ref REGION_SIZE group of megachunks in a single file
+/**
+ * The file starts with a fixed table that has the offset and length of every chunk's payload,
+ * followed by the payloads themselves. Chunks are read straight out of a read-only memory mapping of the file,
+ * so loading a chunk only touches the pages of the table entry and the payload.
+ *
+ * Written payloads are always appended to the end of the file, and the table is only updated by @ref flush,
+ * after the payloads have reached the disk. A crash therefore leaves every chunk at either its old or its new payload.
+ * The space of overwritten payloads is reclaimed by rewriting the file once more than half of it is unused.
+ *
+ * Chunks are given by their world chunk coordinates, and megachunks by their world megachunk coordinates.
+ *
+ * With @ref StorageBackend::IO_URING, every thread uses its own io_uring. Chunks must therefore be written and flushed by the same thread,
+ * which is always the case for the World, as both require its directory lock to be held exclusively.
+ */
+
+class RegionFile {
+public:
+    /// Creates a closed RegionFile
+    RegionFile();
+    /// Closes the RegionFile. Chunks that were written since the last @ref flush are lost
+    ~RegionFile();
+    /// RegionFiles cannot be copied, as they own their file
+    RegionFile(const RegionFile& other) = delete;
+    /// RegionFiles cannot be copied, as they own their file
+    RegionFile& operator=(const RegionFile& other) = delete;
+
+    /// Open the region file at the given filepath, creating an empty one if it doesn't exist
+    bool open(const string& filepath);
+    /// Close the region file. Chunks that were written since the last @ref flush are lost
+    void close();
+    /// Whether the region file is open. A closed RegionFile keeps its filepath, so it can be opened again
+    bool is_open();
+    /// Get the filepath of the region file
+    const string& get_filepath();
+
+    /// Whether any chunk of the given megachunk is stored in the region
+    bool has_megachunk(ivec3 megachunk_coords);
+    /// Get the payload of the given chunk, or {NULL, 0} if it isn't stored in the region
+    /**
+     * The payload points into the memory mapping, and is only valid until the next call to @ref write_chunk.
+     * Chunks that have been written since the last @ref flush cannot be read.
+     */
+    pair<const byte*, int> read_chunk(ivec3 chunk_coords);
+    /// Call on_chunk with the coordinates and payload of every chunk of the given megachunk that's stored in the region
+    /**
+     * The payloads are only valid during the call. With @ref StorageBackend::IO_URING, the payloads are read with a single batch of reads,
+     * in the order that they're in the file, and so that's the order in which on_chunk is called. Any number of threads may read at once.
+     */
+    void read_megachunk(ivec3 megachunk_coords, const function<void(ivec3, const byte*, int)>& on_chunk);
+    /// Append a new payload for the given chunk. It will only replace the old payload once @ref flush is called
+    /**
+     * With @ref StorageBackend::IO_URING, the write is only queued, and so it completes while the caller goes on to other work.
+     */
+    void write_chunk(ivec3 chunk_coords, const byte* payload, int length);
+    /// Wait until every written payload has reached the disk, and then point the table at them
+    void flush();
+
+    /// Set the storage backend of every region file. Returns false, keeping the current backend, if the backend isn't available on this system
+    static bool set_storage_backend(StorageBackend backend);
+    /// Get the storage backend of every region file
+    static StorageBackend get_storage_backend();
+
+    /// Get the size of the region file in bytes
+    size_t file_size();
+private:
+    struct TableEntry {
+        // 0 if the chunk isn't stored
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    string filepath;
+    FILE* file = nullptr;
+    size_t end_of_file = 0;
+    // The total length of every payload that the table points to
+    size_t live_bytes = 0;
+    // Table entries of chunks that have been written, but not yet flushed
+    vector<pair<int, TableEntry>> pending_entries;
+
+    // Payloads that were written with StorageBackend::IO_URING, but haven't been queued yet. They go at write_buffer_offset in the file
+    vector<byte> write_buffer;
+    size_t write_buffer_offset = 0;
+    struct InFlightWrite {
+        vector<byte> buffer;
+        size_t offset;
+        IoRing* io_ring;
+        IoRequest request;
+    };
+    vector<unique_ptr<InFlightWrite>> in_flight_writes;
+    // Queue write_buffer on the given io_uring
+    void queue_write_buffer(IoRing* io_ring);
+    // Wait for every queued write to complete, finishing any that the kernel only partially wrote
+    void finish_writes();
+
+    // The read-only memory mapping of the whole file, or NULL if it isn't mapped
+    byte* mapping = NULL;
+    size_t mapping_size = 0;
+#ifdef _WIN32
+    void* mapping_handle = NULL;
+#endif
+
+    // Get the table entry of the chunk with the given region-local chunk index
+    TableEntry get_entry(int index);
+    void map();
+    void unmap();
+    // Rewrite the file with only the payloads that the table points to
+    void compact();
+};
+
+/**@}*/
+
+#endif
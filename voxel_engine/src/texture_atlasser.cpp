@@ -35,6 +35,13 @@ ivec2 TextureAtlasser::get_top_left(int bitmap_id) const {
     return bmp_locations.at(bitmap_id);
 }
 
+vec4 TextureAtlasser::get_grid_layout() const {
+    if (!atlas_cached) {
+        generate_atlas_cache();
+    }
+    return grid_layout;
+}
+
 void TextureAtlasser::generate_atlas_cache() const {
     int bmps_per_row = (int)(ceil(sqrt(bmps.size())) + 0.5);
     
@@ -75,6 +82,7 @@ void TextureAtlasser::generate_atlas_cache() const {
             bmp_locations.push_back(ivec2(i*tile_size+padding, j*tile_size+padding));
         }
     }
+    this->grid_layout = vec4(bmps_per_row, tile_size / (float)atlas_size, padding / (float)atlas_size, bmps[0].get_width() / (float)atlas_size);
     this->texture_atlas_cache = atlas;
     atlas_cached = true;
 }
@@ -31,6 +31,13 @@ public:
      * This function retrieves the location of a given BMP, via the bitmap ID as originally returned from add_bmp
      */
     ivec2 get_top_left(int bitmap_id) const;
+    /// Gets the layout of the grid that the bitmaps are placed on, so that a bitmap can be found from its bitmap ID alone, such as in a shader
+    /**
+     * The bitmaps are placed row by row, each in its own square cell, and each is expected to be the same size as the first.
+     * @returns (Number of cells per row, size of a cell, offset of a bitmap from the corner of its cell, size of a bitmap).
+     * Every size and offset is a fraction of the size of the atlas
+     */
+    vec4 get_grid_layout() const;
 private:
     vector<BMP> bmps;
     void generate_atlas_cache() const;
@@ -39,6 +46,7 @@ private:
     mutable BMP texture_atlas_cache;
     mutable GLuint atlas_texture;
     mutable vector<ivec2> bmp_locations;
+    mutable vec4 grid_layout;
 };
 
 /**@}*/
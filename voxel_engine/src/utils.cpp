@@ -1,5 +1,11 @@
 #include "utils.hpp"
 
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 size_t hash_ivec3(ivec3 const& key) {
     // Using random primes
     uint hash = 456818903U;
@@ -35,4 +41,13 @@ int bit_to_sign(int a) {
     } else {
         return 1;
     }
-}
\ No newline at end of file
+}
+
+void sync_file(FILE* file) {
+    fflush(file);
+#ifdef _WIN32
+    _commit(_fileno(file));
+#else
+    fsync(fileno(file));
+#endif
+}
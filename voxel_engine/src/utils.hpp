@@ -31,12 +31,21 @@ using std::ifstream;
 using std::ofstream;
 using std::variant;
 using std::get;
+using std::unique_ptr;
+using std::shared_ptr;
+using std::make_shared;
 
 #define UNUSED(x) ((void)x)
 #define CRASH() {int* _CRASHIT_ = 0; printf("%d", *_CRASHIT_);}
 #define len(x) (sizeof(x) / sizeof((x)[0]))
 // Mod, but works on negatives
 #define pos_mod(a, b) ( (((a) % (b)) + (b)) % (b) )
+// Division, but rounds down on negatives
+inline int floor_div(int a, int b) {
+    int d = a / b;
+    int r = a % b;  /* optimizes into single division. */
+    return r ? (d - ((a < 0) ^ (b < 0))) : d;
+}
 
 #define HIDE_DOXYEN /// \cond HIDDEN_SYMBOLS
 
@@ -50,6 +59,8 @@ using std::get;
 #define dbg(fmt, ...) printf("%20s:%-10d " fmt "\n", __FILENAME__, __LINE__, ##__VA_ARGS__)
 
 #define FRAME_TIMER false
+// Periodically print the memory used by the chunks of the world
+#define CHUNK_MEMORY_STATS false
 
 typedef unsigned char byte;
 
@@ -66,4 +77,7 @@ void write_integer(byte* buffer, unsigned index, int integer);
 
 int bit_to_sign(int a);
 
+/// This function will flush the file, and then wait until everything written to it has reached the disk
+void sync_file(FILE* file);
+
 #endif
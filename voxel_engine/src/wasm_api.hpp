@@ -42,6 +42,12 @@ namespace VoxelEngineWASM {
         static void set_block(ContextRuntimeData* wasm_ctx, int32_t world_id, int32_t color_key_x, int32_t color_key_y, int32_t color_key_z, int32_t model_id);
         static float32_t get_break_amount(ContextRuntimeData* wasm_ctx, int32_t world_id, int32_t color_key_x, int32_t color_key_y, int32_t color_key_z);
         static void set_break_amount(ContextRuntimeData* wasm_ctx, int32_t world_id, int32_t color_key_x, int32_t color_key_y, int32_t color_key_z, float32_t break_amount);
+        static int32_t get_height(ContextRuntimeData* wasm_ctx, int32_t world_id, int32_t x, int32_t z);
+
+        static void fill_box(ContextRuntimeData* wasm_ctx, int32_t world_id, int32_t x, int32_t y, int32_t z, int32_t size_x, int32_t size_y, int32_t size_z, int32_t model_id);
+        static void copy_box_to_buffer(ContextRuntimeData* wasm_ctx, int32_t world_id, int32_t x, int32_t y, int32_t z, int32_t size_x, int32_t size_y, int32_t size_z, int32_t buffer);
+        static void paste_buffer(ContextRuntimeData* wasm_ctx, int32_t world_id, int32_t x, int32_t y, int32_t z, int32_t size_x, int32_t size_y, int32_t size_z, int32_t buffer);
+        static void apply_mask(ContextRuntimeData* wasm_ctx, int32_t world_id, int32_t x, int32_t y, int32_t z, int32_t size_x, int32_t size_y, int32_t size_z, int32_t mask, int32_t model_id);
 
         //static optional<ivec3> raycast(ContextRuntimeData* wasm_ctx, int32_t world_id, vec3 position, vec3 direction, float32_t max_distance, int32_t previous_block);
         //static vector<vec3> collide(ContextRuntimeData* wasm_ctx, int32_t world_id, vec3 collision_box_min_point, vec3 collision_box_max_point);
@@ -123,6 +129,11 @@ WASM_DECLARE(I32, VoxelEngineWASM::World::, get_block, I32, I32, I32, I32);
 WASM_DECLARE(void, VoxelEngineWASM::World::, set_block, I32, I32, I32, I32, I32);
 WASM_DECLARE(F32, VoxelEngineWASM::World::, get_break_amount, I32, I32, I32, I32);
 WASM_DECLARE(void, VoxelEngineWASM::World::, set_break_amount, I32, I32, I32, I32, F32);
+WASM_DECLARE(I32, VoxelEngineWASM::World::, get_height, I32, I32, I32);
+WASM_DECLARE(void, VoxelEngineWASM::World::, fill_box, I32, I32, I32, I32, I32, I32, I32, I32);
+WASM_DECLARE(void, VoxelEngineWASM::World::, copy_box_to_buffer, I32, I32, I32, I32, I32, I32, I32, I32);
+WASM_DECLARE(void, VoxelEngineWASM::World::, paste_buffer, I32, I32, I32, I32, I32, I32, I32, I32);
+WASM_DECLARE(void, VoxelEngineWASM::World::, apply_mask, I32, I32, I32, I32, I32, I32, I32, I32, I32);
 WASM_DECLARE(void, VoxelEngineWASM::World::, restart_world, I32);
 WASM_DECLARE(I32, VoxelEngineWASM::World::, load_world, I32, I32);
 WASM_DECLARE(void, VoxelEngineWASM::World::, save_world, I32, I32);
@@ -275,6 +286,45 @@ void memcpy_wasm(ContextRuntimeData* wasm_ctx, i32 ptr_i, void* buffer, u32 leng
     memcpy(&memory_data[data_ptr], buffer, length);
 }
 
+/// Get a pointer to the data of a wasm array, which must be at least length bytes long
+byte* get_wasm_array(ContextRuntimeData* wasm_ctx, i32 ptr_i, u32 length) {
+    // Access memory
+    CompartmentRuntimeData* crd = getCompartmentRuntimeData(wasm_ctx);
+    const MemoryRuntimeData& mrd = crd->memories[0];
+
+    byte* memory_data = (byte*)mrd.base;
+    u32 memory_length = mrd.numPages * 65536;
+
+    u32 ptr = (u32)ptr_i;
+
+    if (ptr >= memory_length - 4) {
+        dbg("ERROR: ptr too large! %d", ptr);
+        exit(-1);
+    }
+
+    u32 data_ptr = *(u32*)&memory_data[ptr];
+
+    if (data_ptr >= UINT32_MAX/2 || length >= UINT32_MAX/2) {
+        dbg("ERROR: ptr/length too large! %d %d", data_ptr, length);
+        exit(-1);
+    }
+    if (data_ptr + length > memory_length) {
+        dbg("ERROR: array out of bounds!");
+        exit(-1);
+    }
+
+    return &memory_data[data_ptr];
+}
+
+/// Get the number of bytes in a box of 32-bit integers, exiting if the box is invalid
+u32 get_wasm_box_length(int32_t size_x, int32_t size_y, int32_t size_z) {
+    if (size_x < 0 || size_y < 0 || size_z < 0 || (int64_t)size_x*size_y*size_z*4 >= UINT32_MAX/2) {
+        dbg("ERROR: Invalid box size! %d %d %d", size_x, size_y, size_z);
+        exit(-1);
+    }
+    return (u32)size_x*size_y*size_z*4;
+}
+
 void VoxelEngineWASM::print(ContextRuntimeData* wasm_ctx, int32_t str) {
     dbg("~~ WASM ~~ %s", get_wasm_string(wasm_ctx, str));
 }
@@ -360,6 +410,39 @@ void VoxelEngineWASM::World::set_break_amount(ContextRuntimeData* wasm_ctx, int3
     VoxelEngine::World::set_break_amount(world_id, ivec3(color_key_x, color_key_y, color_key_z), break_amount);
 }
 
+int32_t VoxelEngineWASM::World::get_height(ContextRuntimeData* wasm_ctx, int32_t world_id, int32_t x, int32_t z) {
+    UNUSED(wasm_ctx);
+    // Mods can't receive an optional, so a column of only air blocks has the lowest possible height
+    optional<int> height = VoxelEngine::World::get_height(world_id, x, z);
+    return height ? *height : INT32_MIN;
+}
+
+void VoxelEngineWASM::World::fill_box(ContextRuntimeData* wasm_ctx, int32_t world_id, int32_t x, int32_t y, int32_t z, int32_t size_x, int32_t size_y, int32_t size_z, int32_t model_id) {
+    UNUSED(wasm_ctx);
+    VoxelEngine::World::fill_box(world_id, ivec3(x, y, z), ivec3(size_x, size_y, size_z), model_id);
+}
+
+void VoxelEngineWASM::World::copy_box_to_buffer(ContextRuntimeData* wasm_ctx, int32_t world_id, int32_t x, int32_t y, int32_t z, int32_t size_x, int32_t size_y, int32_t size_z, int32_t buffer) {
+    int32_t* data = (int32_t*)get_wasm_array(wasm_ctx, buffer, get_wasm_box_length(size_x, size_y, size_z));
+    VoxelEngine::World::copy_box_to_buffer(world_id, ivec3(x, y, z), ivec3(size_x, size_y, size_z), data);
+}
+
+void VoxelEngineWASM::World::paste_buffer(ContextRuntimeData* wasm_ctx, int32_t world_id, int32_t x, int32_t y, int32_t z, int32_t size_x, int32_t size_y, int32_t size_z, int32_t buffer) {
+    int32_t* data = (int32_t*)get_wasm_array(wasm_ctx, buffer, get_wasm_box_length(size_x, size_y, size_z));
+    VoxelEngine::World::paste_buffer(world_id, ivec3(x, y, z), ivec3(size_x, size_y, size_z), data);
+}
+
+void VoxelEngineWASM::World::apply_mask(ContextRuntimeData* wasm_ctx, int32_t world_id, int32_t x, int32_t y, int32_t z, int32_t size_x, int32_t size_y, int32_t size_z, int32_t mask, int32_t model_id) {
+    u32 length = get_wasm_box_length(size_x, size_y, size_z);
+    int32_t* data = (int32_t*)get_wasm_array(wasm_ctx, mask, length);
+    // Mods only have int arrays, so every nonzero int of the mask becomes a nonzero byte
+    vector<byte> mask_bytes(length / 4);
+    for(size_t i = 0; i < mask_bytes.size(); i++) {
+        mask_bytes[i] = data[i] != 0;
+    }
+    VoxelEngine::World::apply_mask(world_id, ivec3(x, y, z), ivec3(size_x, size_y, size_z), mask_bytes.data(), model_id);
+}
+
 void VoxelEngineWASM::World::restart_world(ContextRuntimeData* wasm_ctx, int32_t world_id) {
     UNUSED(wasm_ctx);
     VoxelEngine::World::restart_world(world_id);
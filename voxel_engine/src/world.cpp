@@ -1,4 +1,5 @@
 #include "world.hpp"
+#include "block_cursor.hpp"
 #include <zip.hpp>
 
 ChunkData::ChunkData() : chunk(Chunk()) {  
@@ -7,16 +8,48 @@ ChunkData::ChunkData() : chunk(Chunk()) {
 World::World() {
 }
 
-int floor_div(int a, int b) {
-    int d = a / b;
-    int r = a % b;  /* optimizes into single division. */
-    return r ? (d - ((a < 0) ^ (b < 0))) : d;
+World::~World() {
+    {
+        std::lock_guard<std::mutex> lock(loader_mutex);
+        stop_loaders = true;
+    }
+    loader_cv.notify_all();
+    for(std::thread& thread : loader_threads) {
+        thread.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mesher_mutex);
+        stop_meshers = true;
+    }
+    mesher_cv.notify_all();
+    for(std::thread& thread : mesher_threads) {
+        thread.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(saver_mutex);
+        stop_savers = true;
+    }
+    saver_cv.notify_all();
+    for(std::thread& thread : saver_threads) {
+        thread.join();
+    }
 }
 
-// POINTER WILL NOT BE VALID AFTER A SET_BLOCK
+static ivec3 to_chunk_coords(int x, int y, int z) {
+    return ivec3(floor_div(x, CHUNK_SIZE), floor_div(y, CHUNK_SIZE), floor_div(z, CHUNK_SIZE));
+}
+
+static ivec3 to_megachunk_coords(ivec3 chunk_coords) {
+    return ivec3(floor_div(chunk_coords.x, MEGACHUNK_SIZE), floor_div(chunk_coords.y, MEGACHUNK_SIZE), floor_div(chunk_coords.z, MEGACHUNK_SIZE));
+}
+
+static ivec3 to_region_coords(ivec3 megachunk_coords) {
+    return ivec3(floor_div(megachunk_coords.x, REGION_SIZE), floor_div(megachunk_coords.y, REGION_SIZE), floor_div(megachunk_coords.z, REGION_SIZE));
+}
+
+// POINTER WILL NOT BE VALID AFTER THE DIRECTORY LOCK IS RELEASED
 Chunk* World::get_chunk(int x, int y, int z) {
-    ivec3 chunk_coords(floor_div(x, CHUNK_SIZE), floor_div(y, CHUNK_SIZE), floor_div(z, CHUNK_SIZE));
-    ChunkData* cd = get_chunk_data(chunk_coords);
+    ChunkData* cd = get_chunk_data(to_chunk_coords(x, y, z));
     if (cd) {
         return &cd->chunk;
     } else {
@@ -25,35 +58,39 @@ Chunk* World::get_chunk(int x, int y, int z) {
 }
 
 Chunk* World::make_chunk(int x, int y, int z) {
-    ivec3 chunk_coords(floor_div(x, CHUNK_SIZE), floor_div(y, CHUNK_SIZE), floor_div(z, CHUNK_SIZE));
+    ivec3 chunk_coords = to_chunk_coords(x, y, z);
     dbg("Making %d, %d, %d", chunk_coords.x, chunk_coords.y, chunk_coords.z);
 
     // Inserts into hashmap
-    ivec3 megachunk_coords(floor_div(chunk_coords.x, MEGACHUNK_SIZE), floor_div(chunk_coords.y, MEGACHUNK_SIZE), floor_div(chunk_coords.z, MEGACHUNK_SIZE));
+    ivec3 megachunk_coords = to_megachunk_coords(chunk_coords);
     
-    const auto& found = megachunks.find(megachunk_coords);
+    unique_ptr<MegaChunk>* found = megachunks.find(megachunk_coords);
 
     MegaChunk* megachunk;
-    if (found == megachunks.end()) {
+    if (!found) {
         // If megachunk didn't exist, let's create one and grab a reference
-        MegaChunk& mc = megachunks[megachunk_coords];
+        unique_ptr<MegaChunk>& mc = megachunks[megachunk_coords];
+        mc.reset(new MegaChunk());
         // Update location and keep pointer
-        mc.location = megachunk_coords;
-        megachunk = &mc;
+        mc->location = megachunk_coords;
+        megachunk = mc.get();
     } else {
-        megachunk = &found->second;
+        megachunk = found->get();
     }
+    megachunk->last_access = render_iteration.load();
 
     ChunkData* cd = megachunk->create_chunk(chunk_coords);
+    // A new chunk has never been saved
+    megachunk->mark_dirty(cd);
 
     return &cd->chunk;
 }
 
 void World::load_disk_megachunk(ivec3 megachunk_coords) {
-    const auto& disk_found = disk_megachunks.find(megachunk_coords);
+    RegionFile** disk_found = disk_megachunks.find(megachunk_coords);
     
     // Check for errors
-    if (disk_found == disk_megachunks.end()) {
+    if (!disk_found) {
         dbg("Loading nonexistent megachunk!");
         return;
     }
@@ -62,42 +99,101 @@ void World::load_disk_megachunk(ivec3 megachunk_coords) {
         return;
     }
 
-    string& filename = disk_found->second;
+    insert_disk_megachunk(read_disk_megachunk(megachunk_coords, *disk_found));
+}
 
-    //dbg("Loading (%d, %d, %d) from %s", megachunk_coords.x, megachunk_coords.y, megachunk_coords.z, filename.c_str());
+MegaChunk* World::read_disk_megachunk(ivec3 megachunk_coords, RegionFile* region) {
+    double start = glfwGetTime();
+    MegaChunk* megachunk = new MegaChunk();
+    megachunk->location = megachunk_coords;
 
-    double timer = glfwGetTime();
+    // The cold tier has the same payloads as the region file, without having to touch the disk
+    ColdMegaChunk* cold = cold_megachunks.find(megachunk_coords);
+    if (cold) {
+        size_t offset = 0;
+        for(auto& encoded_chunk : cold->encoded.chunks) {
+            megachunk->deserialize_chunk(encoded_chunk.chunk_coords, &cold->encoded.payloads[offset], encoded_chunk.payload_size, generator ? &*generator : NULL);
+            offset += encoded_chunk.payload_size;
+        }
+        cold_tier_hits++;
+        total_inflate_time += (long long)((glfwGetTime() - start)*1000000);
+        return megachunk;
+    }
 
-    // Opened .data file
-    struct zip_t *zip = zip_open(filename.c_str(), 0, 'r');
-    zip_entry_open(zip, "chunk");
+    if (!reopen_region(region)) {
+        return megachunk;
+    }
+    // Only the chunks that are stored get read
+    region->read_megachunk(megachunk_coords, [&](ivec3 chunk_coords, const byte* payload, int payload_size) {
+        megachunk->deserialize_chunk(chunk_coords, payload, payload_size, generator ? &*generator : NULL);
+    });
+    cold_tier_misses++;
+    total_disk_load_time += (long long)((glfwGetTime() - start)*1000000);
+    return megachunk;
+}
 
-    // Deserialize megachunk
-    int length = zip_entry_size(zip);
-    byte* buf = megachunk_serialization_buffer;
-    zip_entry_noallocread(zip, buf, length);
-    zip_entry_close(zip);
+void World::insert_disk_megachunk(MegaChunk* megachunk) {
+    {
+        std::lock_guard<std::mutex> heightmap_lock(heightmap_mutex);
+        for(auto& [chunk_coords, heightmap] : megachunk->deserialized_heightmaps) {
+            heightmaps[ivec3(chunk_coords.x, 0, chunk_coords.z)].set_chunk_heightmap(chunk_coords.y, heightmap);
+        }
+    }
+    vector<pair<ivec3, ChunkHeightmap>>().swap(megachunk->deserialized_heightmaps);
 
-    // Closes .data file
-    zip_close(zip);
-    
-    // Takes 6-60ms
-    //dbg("Decompress Time: %f", (glfwGetTime() - timer)*1000);
-    timer = glfwGetTime();
+    megachunk->last_access = render_iteration.load();
+    megachunks[megachunk->location].reset(megachunk);
+    disk_megachunks.erase(megachunk->location);
+    // It will be encoded again when it's next evicted, as it may change in the meantime
+    erase_cold_megachunk(megachunk->location);
+}
 
-    // Creates megachunk, and then deserializes buffer
-    megachunks[megachunk_coords].deserialize(buf, length);
-    disk_megachunks.erase(disk_found);
-    
-    // Takes 3-10ms
-    //dbg("Deserialize Time: %f", (glfwGetTime() - timer)*1000);
+void World::insert_cold_megachunk(ivec3 megachunk_coords, EncodedMegaChunk& encoded) {
+    erase_cold_megachunk(megachunk_coords);
+    ColdMegaChunk& cold = cold_megachunks[megachunk_coords];
+    cold.encoded.payloads.swap(encoded.payloads);
+    cold.encoded.payloads.shrink_to_fit();
+    cold.encoded.chunks.swap(encoded.chunks);
+    cold.encoded.chunks.shrink_to_fit();
+    cold.eviction_order = next_eviction_order++;
+    cold_tier_bytes += cold.encoded.payloads.size() + cold.encoded.chunks.size()*sizeof(EncodedMegaChunk::EncodedChunk);
+    trim_cold_tier();
+}
+
+void World::trim_cold_tier() {
+    if (cold_tier_bytes <= cold_tier_size) {
+        return;
+    }
+    // Drop the megachunks that were evicted the longest ago. They're all on disk, so nothing has to be written
+    vector<pair<long long, ivec3>> candidates;
+    cold_megachunks.for_each([&](ivec3 megachunk_coords, ColdMegaChunk& cold) {
+        candidates.push_back({cold.eviction_order, megachunk_coords});
+    });
+    sort(candidates.begin(), candidates.end(), [](pair<long long, ivec3>& a, pair<long long, ivec3>& b) -> bool {
+        return a.first < b.first;
+    });
+    for(auto& p : candidates) {
+        if (cold_tier_bytes <= cold_tier_size) {
+            break;
+        }
+        erase_cold_megachunk(p.second);
+    }
+}
+
+void World::erase_cold_megachunk(ivec3 megachunk_coords) {
+    ColdMegaChunk* cold = cold_megachunks.find(megachunk_coords);
+    if (!cold) {
+        return;
+    }
+    cold_tier_bytes -= cold->encoded.payloads.size() + cold->encoded.chunks.size()*sizeof(EncodedMegaChunk::EncodedChunk);
+    cold_megachunks.erase(megachunk_coords);
 }
 
 void World::save_megachunk(ivec3 megachunk_coords, bool keep_in_memory) {
-    const auto& found = megachunks.find(megachunk_coords); 
+    unique_ptr<MegaChunk>* found = megachunks.find(megachunk_coords);
     
     // Check for errors
-    if (found == megachunks.end()) {
+    if (!found) {
         dbg("Saving nonexistent megachunk!");
         return;
     }
@@ -106,46 +202,346 @@ void World::save_megachunk(ivec3 megachunk_coords, bool keep_in_memory) {
         return;
     }
 
-    auto [buffer, buffer_len] = found->second.serialize();
+    RegionFile* region = get_region(megachunk_coords);
+    if (!region) {
+        return;
+    }
+    // The region file must never be ahead of the journal, or replaying the journal after a crash would apply edits on top of later ones
+    journal.flush();
+
+    if (!keep_in_memory && cold_tier_size > 0) {
+        // Only the dirty chunks are encoded and written. The clean ones are already encoded in the region file, so the cold tier copies them from there
+        EncodedMegaChunk encoded;
+        encode_megachunk(found->get(), false, encoded);
+        if ((*found)->num_dirty_chunks > 0) {
+            write_encoded_megachunk(encoded, false);
+            region->flush();
+        }
+        bool encoded_chunks[MEGACHUNK_SIZE][MEGACHUNK_SIZE][MEGACHUNK_SIZE] = {};
+        ivec3 first_chunk = megachunk_coords*MEGACHUNK_SIZE;
+        for(auto& encoded_chunk : encoded.chunks) {
+            ivec3 local = encoded_chunk.chunk_coords - first_chunk;
+            encoded_chunks[local.x][local.y][local.z] = true;
+        }
+        for(int i = 0; i < MEGACHUNK_SIZE; i++) {
+            for(int j = 0; j < MEGACHUNK_SIZE; j++) {
+                for(int k = 0; k < MEGACHUNK_SIZE; k++) {
+                    if (encoded_chunks[i][j][k]) {
+                        continue;
+                    }
+                    ivec3 chunk_coords = first_chunk + ivec3(i, j, k);
+                    auto [payload, payload_size] = region->read_chunk(chunk_coords);
+                    if (payload) {
+                        encoded.payloads.insert(encoded.payloads.end(), payload, payload + payload_size);
+                        encoded.chunks.push_back({chunk_coords, payload_size, false});
+                    }
+                }
+            }
+        }
+        insert_cold_megachunk(megachunk_coords, encoded);
+    } else if ((*found)->num_dirty_chunks > 0) {
+        // A clean megachunk is identical to what its region file holds, so there's nothing to write
+        write_megachunk(found->get(), false);
+        region->flush();
+    }
+
+    if (!keep_in_memory) {
+        megachunks.erase(megachunk_coords);
+        disk_megachunks[megachunk_coords] = region;
+        disk_generation++;
+    }
+}
+
+size_t World::write_megachunk(MegaChunk* megachunk, bool all_chunks) {
+    EncodedMegaChunk encoded;
+    encode_megachunk(megachunk, all_chunks, encoded);
+    return write_encoded_megachunk(encoded, all_chunks);
+}
 
-    ivec3 loc = found->second.location;
+size_t World::write_megachunks(const vector<MegaChunk*>& megachunks_to_write, bool all_chunks) {
+    int num_threads = std::min((int)megachunks_to_write.size(), (int)std::thread::hardware_concurrency());
+    if (num_threads <= 1) {
+        size_t bytes_written = 0;
+        for(MegaChunk* megachunk : megachunks_to_write) {
+            bytes_written += write_megachunk(megachunk, all_chunks);
+        }
+        return bytes_written;
+    }
 
-    char megachunk_filename[2048];
-    snprintf(megachunk_filename, sizeof(megachunk_filename), "%s/data/%d_%d_%d.data", save_filepath.c_str(), loc.x, loc.y, loc.z);
+    // The save threads encode megachunks in order, and the calling thread writes each one as soon as it's encoded.
+    // Encoded megachunks are freed once they're written, and the save threads wait whenever too many are waiting to be written
+    SaveJob job;
+    job.megachunks = &megachunks_to_write;
+    job.all_chunks = all_chunks;
+    job.encoded.resize(megachunks_to_write.size());
+    job.max_unwritten = SAVE_PIPELINE_DEPTH*num_threads;
+    {
+        std::lock_guard<std::mutex> lock(saver_mutex);
+        // The pool only grows as large as the largest save needs, so that evicting a few megachunks doesn't start a thread per core
+        while ((int)saver_threads.size() < num_threads) {
+            saver_threads.emplace_back(&World::run_saver, this);
+        }
+        save_job = &job;
+    }
+    saver_cv.notify_all();
 
-    struct zip_t *zip = zip_open(megachunk_filename, ZIP_DEFAULT_COMPRESSION_LEVEL, 'w');
-    zip_entry_open(zip, "chunk");
-    zip_entry_write(zip, buffer, buffer_len);
-    zip_entry_close(zip);
-    zip_close(zip);
+    size_t bytes_written = 0;
+    for(size_t i = 0; i < megachunks_to_write.size(); i++) {
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(saver_mutex);
+            saver_cv.wait(lock, [&]() {
+                return !job.encoded_megachunks.empty();
+            });
+            index = job.encoded_megachunks.front();
+            job.encoded_megachunks.pop_front();
+        }
+        bytes_written += write_encoded_megachunk(job.encoded[index], all_chunks);
+        job.encoded[index] = EncodedMegaChunk();
+        {
+            std::lock_guard<std::mutex> lock(saver_mutex);
+            job.num_unwritten--;
+        }
+        saver_cv.notify_all();
+    }
 
-    if (!keep_in_memory) {
-        megachunks.erase(found);
-        disk_megachunks[loc] = megachunk_filename;
+    // Every megachunk has been encoded, so no save thread is using the job anymore
+    std::lock_guard<std::mutex> lock(saver_mutex);
+    save_job = NULL;
+    return bytes_written;
+}
+
+void World::run_saver() {
+    while (true) {
+        SaveJob* job;
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(saver_mutex);
+            saver_cv.wait(lock, [this]() {
+                return stop_savers || (save_job && save_job->next_megachunk < (int)save_job->megachunks->size() && save_job->num_unwritten < save_job->max_unwritten);
+            });
+            if (stop_savers) {
+                return;
+            }
+            job = save_job;
+            index = job->next_megachunk++;
+            job->num_unwritten++;
+        }
+        encode_megachunk((*job->megachunks)[index], job->all_chunks, job->encoded[index]);
+        {
+            std::lock_guard<std::mutex> lock(saver_mutex);
+            job->encoded_megachunks.push_back(index);
+        }
+        saver_cv.notify_all();
     }
 }
 
+void World::encode_megachunk(MegaChunk* megachunk, bool all_chunks, EncodedMegaChunk& encoded) {
+    encoded.megachunk = megachunk;
+    encoded.payloads.clear();
+    encoded.chunks.clear();
+
+    // Each thread serializes into its own buffer, so that any number of threads can encode at once
+    thread_local byte payload[TOTAL_SERIALIZED_CHUNK_SIZE];
+    const ChunkGenerator* chunk_generator = generator ? &*generator : NULL;
+    ivec3 first_chunk = megachunk->location*MEGACHUNK_SIZE;
+    for(int i = 0; i < MEGACHUNK_SIZE; i++) {
+        for(int j = 0; j < MEGACHUNK_SIZE; j++) {
+            for(int k = 0; k < MEGACHUNK_SIZE; k++) {
+                ivec3 chunk_coords = first_chunk + ivec3(i, j, k);
+                // The region file already has a payload that couldn't be decoded, so it's only rewritten when every chunk is, never replaced
+                const vector<byte>* undecodable_payload = megachunk->get_undecodable_payload(chunk_coords);
+                if (undecodable_payload) {
+                    if (all_chunks) {
+                        encoded.payloads.insert(encoded.payloads.end(), undecodable_payload->begin(), undecodable_payload->end());
+                        encoded.chunks.push_back({chunk_coords, (int)undecodable_payload->size(), false});
+                    }
+                    continue;
+                }
+                ChunkData* cd = megachunk->get_chunk(ivec3(i, j, k));
+                if (!cd || (!all_chunks && !(cd->state & CHUNK_STATE_DIRTY))) {
+                    continue;
+                }
+                int payload_size = megachunk->serialize_chunk(chunk_coords, payload, chunk_generator);
+                encoded.payloads.insert(encoded.payloads.end(), payload, payload + payload_size);
+                encoded.chunks.push_back({chunk_coords, payload_size, (cd->state & CHUNK_STATE_DIRTY) != 0});
+            }
+        }
+    }
+}
+
+size_t World::write_encoded_megachunk(const EncodedMegaChunk& encoded, bool all_chunks) {
+    RegionFile* region = get_region(encoded.megachunk->location);
+    if (!region) {
+        return 0;
+    }
+
+    size_t offset = 0;
+    size_t bytes_written = 0;
+    for(auto& encoded_chunk : encoded.chunks) {
+        if (all_chunks || encoded_chunk.dirty) {
+            region->write_chunk(encoded_chunk.chunk_coords, &encoded.payloads[offset], encoded_chunk.payload_size);
+            bytes_written += encoded_chunk.payload_size;
+        }
+        offset += encoded_chunk.payload_size;
+    }
+
+    encoded.megachunk->mark_clean();
+    return bytes_written;
+}
+
+RegionFile* World::get_region(ivec3 megachunk_coords) {
+    ivec3 region_coords = to_region_coords(megachunk_coords);
+    unique_ptr<RegionFile>* found = regions.find(region_coords);
+    if (found) {
+        return reopen_region(found->get()) ? found->get() : NULL;
+    }
+
+    char region_filename[2048];
+    snprintf(region_filename, sizeof(region_filename), "%s/data/r.%d.%d.%d.region", save_filepath.c_str(), region_coords.x, region_coords.y, region_coords.z);
+
+    unique_ptr<RegionFile> region(new RegionFile());
+    if (!region->open(region_filename)) {
+        return NULL;
+    }
+    RegionFile* ret = region.get();
+    regions[region_coords] = std::move(region);
+    return ret;
+}
+
+bool World::reopen_region(RegionFile* region) {
+    std::lock_guard<std::mutex> lock(region_open_mutex);
+    if (region->is_open()) {
+        return true;
+    }
+    return region->open(region->get_filepath());
+}
+
+void World::close_idle_regions() {
+    CoordinateMap<int> used_regions;
+    megachunks.for_each([&](ivec3 megachunk_coords, unique_ptr<MegaChunk>&) {
+        used_regions[to_region_coords(megachunk_coords)] = 1;
+    });
+    cold_megachunks.for_each([&](ivec3 megachunk_coords, ColdMegaChunk&) {
+        used_regions[to_region_coords(megachunk_coords)] = 1;
+    });
+    // Every written chunk has been flushed, so closing loses nothing
+    regions.for_each([&](ivec3 region_coords, unique_ptr<RegionFile>& region) {
+        if (!used_regions.count(region_coords)) {
+            region->close();
+        }
+    });
+}
+
+string World::get_journal_filename() {
+    return save_filepath + "/journal.log";
+}
+
+void World::mark_dirty(ivec3 chunk_coords, ChunkData* cd) {
+    // Skip the megachunk lookup for chunks that are already dirty
+    if (cd->state.load(std::memory_order_relaxed) & CHUNK_STATE_DIRTY) {
+        return;
+    }
+    (*megachunks.find(to_megachunk_coords(chunk_coords)))->mark_dirty(cd);
+}
+
 ChunkData* World::get_chunk_data(ivec3 chunk_coords) {
-    ivec3 megachunk_coords(floor_div(chunk_coords.x, MEGACHUNK_SIZE), floor_div(chunk_coords.y, MEGACHUNK_SIZE), floor_div(chunk_coords.z, MEGACHUNK_SIZE));
-    
-    const auto& found = megachunks.find(megachunk_coords);
-    if (found != megachunks.end()) {
-        ivec3 modded_chunk_coords = ivec3(pos_mod(chunk_coords.x, MEGACHUNK_SIZE), pos_mod(chunk_coords.y, MEGACHUNK_SIZE), pos_mod(chunk_coords.z, MEGACHUNK_SIZE));
-        // Will correctly return NULL if no such chunk is there
-        return found->second.get_chunk(modded_chunk_coords);
-    } else {
-        const auto& disk_found = disk_megachunks.find(megachunk_coords);
-        if (disk_found != disk_megachunks.end()) {
-            load_disk_megachunk(megachunk_coords);
-            // Now that the megachunk has been loaded, run get_chunk_data again
-            return get_chunk_data(chunk_coords);
-        } else {
+    unique_ptr<MegaChunk>* found = megachunks.find(to_megachunk_coords(chunk_coords));
+    if (!found) {
+        return NULL;
+    }
+    MegaChunk* megachunk = found->get();
+    touch_megachunk(megachunk);
+    ivec3 modded_chunk_coords = ivec3(pos_mod(chunk_coords.x, MEGACHUNK_SIZE), pos_mod(chunk_coords.y, MEGACHUNK_SIZE), pos_mod(chunk_coords.z, MEGACHUNK_SIZE));
+    // Will correctly return NULL if no such chunk is there
+    return megachunk->get_chunk(modded_chunk_coords);
+}
+
+void World::touch_megachunk(MegaChunk* megachunk) {
+    // Only write last_access when it changes, so that threads reading the same megachunk don't contend over its cache line
+    int iteration = render_iteration.load(std::memory_order_relaxed);
+    if (megachunk->last_access.load(std::memory_order_relaxed) != iteration) {
+        megachunk->last_access.store(iteration, std::memory_order_relaxed);
+    }
+}
+
+ChunkData* World::acquire_chunk_data(ivec3 chunk_coords, bool create, DirectoryLock& lock) {
+    ivec3 megachunk_coords = to_megachunk_coords(chunk_coords);
+    while (true) {
+        ChunkData* cd = get_chunk_data(chunk_coords);
+        if (cd) {
+            return cd;
+        }
+        if (!create && !disk_megachunks.count(megachunk_coords)) {
             return NULL;
         }
+
+        // A shared_mutex can't be upgraded, so release it before taking it exclusively.
+        // Another thread may load or create the chunk in the meantime, so check again after taking it
+        lock.unlock();
+        {
+            std::unique_lock<std::shared_mutex> exclusive_lock(directory_mutex);
+            if (disk_megachunks.count(megachunk_coords)) {
+                load_disk_megachunk(megachunk_coords);
+            }
+            if (create && !get_chunk_data(chunk_coords)) {
+                make_chunk(chunk_coords.x*CHUNK_SIZE, chunk_coords.y*CHUNK_SIZE, chunk_coords.z*CHUNK_SIZE);
+            }
+        }
+        lock.lock();
+        // The main thread could have evicted the megachunk again before we reacquired the lock, so loop until we find it
+    }
+}
+
+void World::load_megachunks_in_box(ivec3 first_block, ivec3 last_block, DirectoryLock& lock) {
+    ivec3 first_megachunk = to_megachunk_coords(to_chunk_coords(first_block.x, first_block.y, first_block.z));
+    ivec3 last_megachunk = to_megachunk_coords(to_chunk_coords(last_block.x, last_block.y, last_block.z));
+    while (true) {
+        vector<ivec3> on_disk;
+        for(int mx = first_megachunk.x; mx <= last_megachunk.x; mx++) {
+            for(int my = first_megachunk.y; my <= last_megachunk.y; my++) {
+                for(int mz = first_megachunk.z; mz <= last_megachunk.z; mz++) {
+                    if (disk_megachunks.count(ivec3(mx, my, mz))) {
+                        on_disk.push_back(ivec3(mx, my, mz));
+                    }
+                }
+            }
+        }
+        if (on_disk.empty()) {
+            return;
+        }
+
+        // As in acquire_chunk_data, the main thread may evict them again before we reacquire the lock, so loop until they're all resident
+        lock.unlock();
+        {
+            std::unique_lock<std::shared_mutex> exclusive_lock(directory_mutex);
+            for(ivec3 megachunk_coords : on_disk) {
+                if (disk_megachunks.count(megachunk_coords)) {
+                    load_disk_megachunk(megachunk_coords);
+                }
+            }
+        }
+        lock.lock();
     }
 }
 
 void World::mark_chunk(ivec3 chunk_coords, int priority) {
+    DirectoryLock lock(directory_mutex);
+    // Meshing looks up the neighboring chunks, which may be in a different megachunk, so those must be resident too.
+    // Otherwise, the chunk would be meshed as if its neighbors were air
+    bool loading = request_megachunk(to_megachunk_coords(chunk_coords), true) == ChunkResidency::LOADING;
+    ivec3 neighbor_offsets[] = {ivec3(1, 0, 0), ivec3(-1, 0, 0), ivec3(0, 1, 0), ivec3(0, -1, 0), ivec3(0, 0, 1), ivec3(0, 0, -1)};
+    for(ivec3& offset : neighbor_offsets) {
+        ivec3 neighbor_megachunk_coords = to_megachunk_coords(chunk_coords + offset);
+        if (neighbor_megachunk_coords != to_megachunk_coords(chunk_coords)) {
+            loading |= request_megachunk(neighbor_megachunk_coords, true) == ChunkResidency::LOADING;
+        }
+    }
+    if (loading) {
+        // It'll be marked again next frame, by which time it may have been loaded
+        return;
+    }
+
     ChunkData* cd = get_chunk_data(chunk_coords);
     if (cd) {
         cd->last_render_mark = render_iteration;
@@ -156,159 +552,722 @@ void World::mark_chunk(ivec3 chunk_coords, int priority) {
     }
 }
 
+ChunkResidency World::request_chunk(ivec3 chunk_coords) {
+    DirectoryLock lock(directory_mutex);
+    ChunkResidency residency = request_megachunk(to_megachunk_coords(chunk_coords), true);
+    if (residency == ChunkResidency::RESIDENT && !get_chunk_data(chunk_coords)) {
+        return ChunkResidency::NONEXISTENT;
+    }
+    return residency;
+}
+
+ChunkResidency World::request_megachunk(ivec3 megachunk_coords, bool urgent) {
+    unique_ptr<MegaChunk>* found = megachunks.find(megachunk_coords);
+    if (found) {
+        touch_megachunk(found->get());
+        return ChunkResidency::RESIDENT;
+    }
+    if (!disk_megachunks.count(megachunk_coords)) {
+        return ChunkResidency::NONEXISTENT;
+    }
+
+    std::lock_guard<std::mutex> lock(loader_mutex);
+    if (loading_megachunks.count(megachunk_coords)) {
+        // Move it up the queue, unless a loader has already taken it
+        if (urgent) {
+            auto queued = std::find(load_queue.begin(), load_queue.end(), megachunk_coords);
+            if (queued != load_queue.end() && queued != load_queue.begin()) {
+                load_queue.erase(queued);
+                load_queue.push_front(megachunk_coords);
+            }
+        }
+        return ChunkResidency::LOADING;
+    }
+
+    if (loader_threads.empty()) {
+        for(int i = 0; i < NUM_MEGACHUNK_LOADER_THREADS; i++) {
+            loader_threads.emplace_back(&World::run_loader, this);
+        }
+    }
+    loading_megachunks[megachunk_coords] = 1;
+    if (urgent) {
+        load_queue.push_front(megachunk_coords);
+    } else {
+        load_queue.push_back(megachunk_coords);
+    }
+    loader_cv.notify_one();
+    return ChunkResidency::LOADING;
+}
+
+void World::run_loader() {
+    while (true) {
+        ivec3 megachunk_coords;
+        {
+            std::unique_lock<std::mutex> lock(loader_mutex);
+            loader_cv.wait(lock, [this]() {
+                return stop_loaders || !load_queue.empty();
+            });
+            if (stop_loaders) {
+                return;
+            }
+            megachunk_coords = load_queue.front();
+            load_queue.pop_front();
+        }
+
+        while (true) {
+            // Reading and deserializing the megachunk only needs the directory in shared mode, so every other thread keeps running
+            unique_ptr<MegaChunk> megachunk;
+            int generation;
+            {
+                DirectoryLock lock(directory_mutex);
+                RegionFile** disk_found = disk_megachunks.find(megachunk_coords);
+                if (!disk_found) {
+                    // Another thread needed it right away, and loaded it itself
+                    break;
+                }
+                generation = disk_generation;
+                megachunk.reset(read_disk_megachunk(megachunk_coords, *disk_found));
+            }
+
+            std::unique_lock<std::shared_mutex> lock(directory_mutex);
+            if (!disk_megachunks.count(megachunk_coords)) {
+                break;
+            }
+            if (disk_generation != generation) {
+                // It may have been loaded, edited and evicted again, or the world may have been reloaded, so read it again
+                continue;
+            }
+            insert_disk_megachunk(megachunk.release());
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(loader_mutex);
+        loading_megachunks.erase(megachunk_coords);
+    }
+}
+
+void World::set_prefetch_distance(float distance) {
+    prefetch_distance = distance;
+}
+
+void World::prefetch(vec3 camera_position) {
+    if (last_camera_position) {
+        vec3 movement = camera_position - *last_camera_position;
+        // Keep the last direction while the camera is standing still
+        if (length(movement) > 0.001f) {
+            camera_direction = normalize(movement);
+        }
+    }
+    last_camera_position = camera_position;
+    if (prefetch_distance <= 0.0f) {
+        return;
+    }
+
+    const float megachunk_width = MEGACHUNK_SIZE*CHUNK_SIZE;
+    ivec3 camera_megachunk = to_megachunk_coords(to_chunk_coords(floor(camera_position.x), floor(camera_position.y), floor(camera_position.z)));
+    int radius = (int)ceil(prefetch_distance / megachunk_width);
+
+    DirectoryLock lock(directory_mutex);
+    // Megachunks on disk that are ahead of the camera, along with their distance from it
+    vector<pair<float, ivec3>> candidates;
+    for(int dx = -radius; dx <= radius; dx++) {
+        for(int dy = -radius; dy <= radius; dy++) {
+            for(int dz = -radius; dz <= radius; dz++) {
+                ivec3 megachunk_coords = camera_megachunk + ivec3(dx, dy, dz);
+                if (!disk_megachunks.count(megachunk_coords)) {
+                    continue;
+                }
+                vec3 offset = (vec3(megachunk_coords) + vec3(0.5f))*megachunk_width - camera_position;
+                float distance = length(offset);
+                // The megachunks right around the camera are always wanted, whichever way it's moving
+                if (distance > prefetch_distance || dot(offset, camera_direction) < -megachunk_width) {
+                    continue;
+                }
+                candidates.push_back({distance, megachunk_coords});
+            }
+        }
+    }
+
+    // Queue the nearest megachunks first
+    sort(candidates.begin(), candidates.end(), [](pair<float, ivec3>& a, pair<float, ivec3>& b) -> bool {
+        return a.first < b.first;
+    });
+    for(auto& p : candidates) {
+        request_megachunk(p.second, false);
+    }
+}
+
 void World::mark_generated(ivec3 chunk_coords) {
-    ChunkData* cd = get_chunk_data(chunk_coords);
+    DirectoryLock lock(directory_mutex);
+    ChunkData* cd = acquire_chunk_data(chunk_coords, false, lock);
     if (cd) {
-        cd->generated = true;
+        // What the generator generated isn't journaled until the chunk is first edited, as until then the game can simply generate it again
+        cd->state |= CHUNK_STATE_GENERATED | CHUNK_STATE_UNJOURNALED;
+        mark_dirty(chunk_coords, cd);
     } else {
         dbg("Marking generated to nonexistent chunk! (%d, %d, %d)\n", chunk_coords.x, chunk_coords.y, chunk_coords.z);
     }
 }
 
 bool World::is_generated(ivec3 chunk_coords) {
-    ChunkData* cd = get_chunk_data(chunk_coords);
+    DirectoryLock lock(directory_mutex);
+    ChunkData* cd = acquire_chunk_data(chunk_coords, false, lock);
     if (cd) {
-        return cd->generated;
+        return cd->state & CHUNK_STATE_GENERATED;
     } else {
         return false;
     }
 }
 
+void World::set_generator(uint32_t generator_id, uint64_t seed, fn_generate_chunk generate) {
+    // Loader threads use the generator while holding the directory lock
+    std::unique_lock<std::shared_mutex> lock(directory_mutex);
+    generator = ChunkGenerator{generator_id, seed, generate};
+}
+
+bool World::try_claim_chunk(ivec3 chunk_coords, int claim) {
+    DirectoryLock lock(directory_mutex);
+    ChunkData* cd = acquire_chunk_data(chunk_coords, false, lock);
+    if (!cd) {
+        return false;
+    }
+    if (cd->state.fetch_or(claim) & claim) {
+        // Another thread already holds this claim
+        return false;
+    }
+    // Eviction holds the directory lock exclusively, so it can't happen between taking the claim and counting it
+    (*megachunks.find(to_megachunk_coords(chunk_coords)))->num_claims++;
+    return true;
+}
+
+void World::release_chunk(ivec3 chunk_coords, int claim) {
+    DirectoryLock lock(directory_mutex);
+    // Claimed chunks are never evicted, so the chunk must still be resident
+    ChunkData* cd = get_chunk_data(chunk_coords);
+    if (!cd || !(cd->state & claim)) {
+        dbg("Releasing a chunk that isn't claimed! (%d, %d, %d)", chunk_coords.x, chunk_coords.y, chunk_coords.z);
+        return;
+    }
+    cd->state &= ~claim;
+    (*megachunks.find(to_megachunk_coords(chunk_coords)))->num_claims--;
+}
+
 void World::set_block(int x, int y, int z, int model) {
-    Chunk* my_chunk = get_chunk(x, y, z);
-    if (!my_chunk) {
-        my_chunk = make_chunk(x, y, z);
+    DirectoryLock lock(directory_mutex);
+    ivec3 chunk_coords = to_chunk_coords(x, y, z);
+    ChunkData* cd = acquire_chunk_data(chunk_coords, true, lock);
+    {
+        std::unique_lock<ChunkLock> chunk_lock(cd->lock);
+        ivec3 local(pos_mod(x, CHUNK_SIZE), pos_mod(y, CHUNK_SIZE), pos_mod(z, CHUNK_SIZE));
+        // Most writes are below the top of their column, so the heightmap is only locked when the top actually moves
+        int old_height = cd->chunk.get_column_height(local.x, local.z);
+        cd->chunk.set_block(local.x, local.y, local.z, model);
+        if (cd->chunk.get_column_height(local.x, local.z) != old_height) {
+            update_heightmap(chunk_coords, cd->chunk, local, local);
+        }
+        // Journal while holding the chunk lock, so that writes to the same block are journaled in the order that they happened
+        journal_generated_chunk(chunk_coords, cd);
+        journal.append_write_block(ivec3(x, y, z), model, 0.0f);
     }
-    my_chunk->set_block(pos_mod(x, CHUNK_SIZE), pos_mod(y, CHUNK_SIZE), pos_mod(z, CHUNK_SIZE), model);
+    mark_dirty(chunk_coords, cd);
 
     refresh_block(x, y, z);
 }
 
 void World::refresh_block(int x, int y, int z) {
     ivec3 pos(x, y, z);
+    ivec3 diffs[] = {ivec3(1, 0, 0), ivec3(-1, 0, 0), ivec3(0, 1, 0), ivec3(0, -1, 0), ivec3(0, 0, 1), ivec3(0, 0, -1)};
 
-    // Only call get_chunk once if possible
-    int px = pos_mod(x, CHUNK_SIZE);
-    int py = pos_mod(y, CHUNK_SIZE);
-    int pz = pos_mod(z, CHUNK_SIZE);
-    Chunk* main_chunk = NULL;
-    if (px > 0 && px < CHUNK_SIZE - 1
-     && py > 0 && py < CHUNK_SIZE - 1
-     && pz > 0 && pz < CHUNK_SIZE - 1
-    ) {
-        main_chunk = get_chunk(x, y, z);
-    }
+    auto invalidate_chunk = [this](ivec3 chunk_coords) {
+        // Chunks that aren't resident have no render cache to invalidate
+        ChunkData* cd = get_chunk_data(chunk_coords);
+        if (cd) {
+            std::unique_lock<ChunkLock> chunk_lock(cd->lock);
+            cd->chunk.invalidate_cache();
+        }
+    };
 
-    ivec3 diffs[] = {ivec3(1, 0, 0), ivec3(-1, 0, 0), ivec3(0, 1, 0), ivec3(0, -1, 0), ivec3(0, 0, 1), ivec3(0, 0, -1)};
+    // The block's own chunk must be meshed again, along with the chunk of any neighbor that's across a chunk border
+    ivec3 chunk_coords = to_chunk_coords(x, y, z);
+    invalidate_chunk(chunk_coords);
     for(int i = 0; i < 6; i++) {
         ivec3 loc = pos + diffs[i];
-        
-        Chunk* c = main_chunk ? main_chunk : get_chunk(loc.x, loc.y, loc.z);
-        if (c) {
-            c->invalidate_cache();
-            BlockData* b = &c->blocks[pos_mod(loc.x, CHUNK_SIZE)][pos_mod(loc.y, CHUNK_SIZE)][pos_mod(loc.z, CHUNK_SIZE)];
-            if (b) {
-                b->neighbor_cache = 0;
-            }
+        ivec3 neighbor_chunk_coords = to_chunk_coords(loc.x, loc.y, loc.z);
+        if (neighbor_chunk_coords != chunk_coords) {
+            invalidate_chunk(neighbor_chunk_coords);
         }
     }
 }
 
-// Note: Unsafe for public use, as it won't refresh the block if you change data manually
-BlockData* World::get_block(int x, int y, int z) {
-    Chunk* my_chunk = get_chunk(x, y, z);
-    if (my_chunk) {
-        return my_chunk->get_block(pos_mod(x, CHUNK_SIZE), pos_mod(y, CHUNK_SIZE), pos_mod(z, CHUNK_SIZE));
+optional<BlockData> World::get_block(int x, int y, int z) {
+    ChunkData* cd = get_chunk_data(to_chunk_coords(x, y, z));
+    if (cd) {
+        std::shared_lock<ChunkLock> chunk_lock(cd->lock);
+        return cd->chunk.get_block(pos_mod(x, CHUNK_SIZE), pos_mod(y, CHUNK_SIZE), pos_mod(z, CHUNK_SIZE));
     } else {
-        return NULL;
+        return nullopt;
     }
 }
 
-const BlockData* World::read_block(int x, int y, int z) {
-    return get_block(x, y, z);
+int World::get_block_model(int x, int y, int z) {
+    ChunkData* cd = get_chunk_data(to_chunk_coords(x, y, z));
+    if (cd) {
+        std::shared_lock<ChunkLock> chunk_lock(cd->lock);
+        return cd->chunk.get_block_model(pos_mod(x, CHUNK_SIZE), pos_mod(y, CHUNK_SIZE), pos_mod(z, CHUNK_SIZE));
+    } else {
+        return 0;
+    }
+}
+
+optional<BlockData> World::read_block(int x, int y, int z) {
+    DirectoryLock lock(directory_mutex);
+    ChunkData* cd = acquire_chunk_data(to_chunk_coords(x, y, z), false, lock);
+    if (!cd) {
+        return nullopt;
+    }
+    std::shared_lock<ChunkLock> chunk_lock(cd->lock);
+    return cd->chunk.get_block(pos_mod(x, CHUNK_SIZE), pos_mod(y, CHUNK_SIZE), pos_mod(z, CHUNK_SIZE));
 }
 
-const BlockData* World::read_block(ivec3 location) {
+optional<BlockData> World::read_block(ivec3 location) {
     return read_block(location.x, location.y, location.z);
 }
 
 // Will refresh the block 
-BlockData* World::write_block(int x, int y, int z) {
-    Chunk* my_chunk = get_chunk(x,y,z);
-    if (my_chunk) {
+void World::write_block(int x, int y, int z, const BlockData& data) {
+    DirectoryLock lock(directory_mutex);
+    ivec3 chunk_coords = to_chunk_coords(x, y, z);
+    ChunkData* cd = acquire_chunk_data(chunk_coords, false, lock);
+    if (cd) {
+        {
+            std::unique_lock<ChunkLock> chunk_lock(cd->lock);
+            ivec3 local(pos_mod(x, CHUNK_SIZE), pos_mod(y, CHUNK_SIZE), pos_mod(z, CHUNK_SIZE));
+            int old_height = cd->chunk.get_column_height(local.x, local.z);
+            cd->chunk.set_block(local.x, local.y, local.z, data);
+            if (cd->chunk.get_column_height(local.x, local.z) != old_height) {
+                update_heightmap(chunk_coords, cd->chunk, local, local);
+            }
+            journal_generated_chunk(chunk_coords, cd);
+            journal.append_write_block(ivec3(x, y, z), data.block_model, data.break_amount);
+        }
+        mark_dirty(chunk_coords, cd);
         refresh_block(x, y, z);
-        return my_chunk->get_block(pos_mod(x, CHUNK_SIZE), pos_mod(y, CHUNK_SIZE), pos_mod(z, CHUNK_SIZE));
-    } else {
-        return NULL;
     }
 }
 
-BlockData* World::write_block(ivec3 location) {
-    return write_block(location.x, location.y, location.z);
+void World::write_block(ivec3 location, const BlockData& data) {
+    write_block(location.x, location.y, location.z, data);
 }
 
-void World::render(mat4& P, mat4& V, TextureAtlasser& atlasser) {
-    atlasser.get_atlas_texture();
-    
-    fn_get_block my_get_block = [this](int x, int y, int z) {
-        return this->get_block(x, y, z);
-    };
+optional<ChunkSnapshot> World::snapshot_chunk(ivec3 chunk_coords) {
+    DirectoryLock lock(directory_mutex);
+    ChunkData* cd = acquire_chunk_data(chunk_coords, false, lock);
+    if (!cd) {
+        return nullopt;
+    }
+    std::shared_lock<ChunkLock> chunk_lock(cd->lock);
+    return cd->chunk.snapshot();
+}
 
-    sort(marked_chunks.begin(), marked_chunks.end(), [](pair<int, ivec3>& a, pair<int, ivec3>& b) -> bool {
-        return a.first < b.first;
+#define BOX_INDEX(offset, size) (((offset).x*(size).y + (offset).y)*(size).z + (offset).z)
+
+void World::fill_box(ivec3 location, ivec3 size, int model) {
+    DirectoryLock lock(directory_mutex);
+    edit_box(location, size, lock, [&]() {
+        journal.append_fill_box(location, size, model);
+    }, [&](ChunkData* cd, ivec3 chunk_location, ivec3 first, ivec3 last) {
+        Chunk* c = &cd->chunk;
+        // Filling an entire chunk lets it become uniform immediately
+        if (first == ivec3(0) && last == ivec3(CHUNK_SIZE-1)) {
+            c->fill(model);
+        } else {
+            for(int x = first.x; x <= last.x; x++) {
+                for(int y = first.y; y <= last.y; y++) {
+                    for(int z = first.z; z <= last.z; z++) {
+                        c->set_block(x, y, z, model);
+                    }
+                }
+            }
+        }
+        update_heightmap(chunk_location / CHUNK_SIZE, *c, first, last);
     });
+    refresh_box(location, size, lock);
+}
 
-    int number_of_chunks_constructed = 0;
-    for(auto& p : marked_chunks) {
-        int priority = p.first;
-        ChunkData& cd = *get_chunk_data(p.second);
+void World::copy_box_to_buffer(ivec3 location, ivec3 size, int* buffer) {
+    DirectoryLock lock(directory_mutex);
+    for_each_chunk_in_box(location, size, false, lock, [&](ChunkData* cd, ivec3 chunk_location, ivec3 first, ivec3 last) {
+        std::shared_lock<ChunkLock> chunk_lock;
+        if (cd) {
+            chunk_lock = std::shared_lock<ChunkLock>(cd->lock);
+        }
+        Chunk* c = cd ? &cd->chunk : NULL;
+        for(int x = first.x; x <= last.x; x++) {
+            for(int y = first.y; y <= last.y; y++) {
+                for(int z = first.z; z <= last.z; z++) {
+                    ivec3 offset = chunk_location + ivec3(x, y, z) - location;
+                    buffer[BOX_INDEX(offset, size)] = c ? c->get_block_model(x, y, z) : 0;
+                }
+            }
+        }
+    });
+}
 
-        if (cd.last_render_mark == render_iteration) {
-            bool should_render = false;
+void World::paste_buffer(ivec3 location, ivec3 size, const int* buffer) {
+    DirectoryLock lock(directory_mutex);
+    edit_box(location, size, lock, [&]() {
+        journal.append_paste_buffer(location, size, buffer);
+    }, [&](ChunkData* cd, ivec3 chunk_location, ivec3 first, ivec3 last) {
+        Chunk* c = &cd->chunk;
+        for(int x = first.x; x <= last.x; x++) {
+            for(int y = first.y; y <= last.y; y++) {
+                for(int z = first.z; z <= last.z; z++) {
+                    ivec3 offset = chunk_location + ivec3(x, y, z) - location;
+                    c->set_block(x, y, z, buffer[BOX_INDEX(offset, size)]);
+                }
+            }
+        }
+        update_heightmap(chunk_location / CHUNK_SIZE, *c, first, last);
+    });
+    refresh_box(location, size, lock);
+}
 
-            bool is_cached = cd.chunk.is_cached();
-            if (is_cached || cd.priority == 0) {
-                should_render = true;
-            } else {
-                should_render = number_of_chunks_constructed < 1;
+void World::apply_mask(ivec3 location, ivec3 size, const byte* mask, int model) {
+    DirectoryLock lock(directory_mutex);
+    edit_box(location, size, lock, [&]() {
+        journal.append_apply_mask(location, size, mask, model);
+    }, [&](ChunkData* cd, ivec3 chunk_location, ivec3 first, ivec3 last) {
+        Chunk* c = &cd->chunk;
+        for(int x = first.x; x <= last.x; x++) {
+            for(int y = first.y; y <= last.y; y++) {
+                for(int z = first.z; z <= last.z; z++) {
+                    ivec3 offset = chunk_location + ivec3(x, y, z) - location;
+                    if (mask[BOX_INDEX(offset, size)]) {
+                        c->set_block(x, y, z, model);
+                    }
+                }
             }
+        }
+        update_heightmap(chunk_location / CHUNK_SIZE, *c, first, last);
+    });
+    refresh_box(location, size, lock);
+}
+
+void World::edit_box(ivec3 location, ivec3 size, DirectoryLock& lock, const function<void()>& append_journal, const function<void(ChunkData*, ivec3, ivec3, ivec3)>& on_chunk) {
+    if (size.x <= 0 || size.y <= 0 || size.z <= 0) {
+        return;
+    }
+    ivec3 last_block = location + size - ivec3(1);
+    ivec3 first_chunk(floor_div(location.x, CHUNK_SIZE), floor_div(location.y, CHUNK_SIZE), floor_div(location.z, CHUNK_SIZE));
+    ivec3 last_chunk(floor_div(last_block.x, CHUNK_SIZE), floor_div(last_block.y, CHUNK_SIZE), floor_div(last_block.z, CHUNK_SIZE));
 
-            if (should_render) {
-                bool con = false;
-                if (!is_cached) {
-                    number_of_chunks_constructed++;
-                    con = true;
+    // Creating or loading a chunk may release the lock, so once they all exist, look them all up again while holding the lock.
+    // If the main thread evicted any of them in the meantime, then try again
+    vector<ChunkData*> chunks;
+    while (true) {
+        for_each_chunk_in_box(location, size, true, lock, [](ChunkData*, ivec3, ivec3, ivec3) {});
+        chunks.clear();
+        for(int cx = first_chunk.x; cx <= last_chunk.x; cx++) {
+            for(int cy = first_chunk.y; cy <= last_chunk.y; cy++) {
+                for(int cz = first_chunk.z; cz <= last_chunk.z; cz++) {
+                    chunks.push_back(get_chunk_data(ivec3(cx, cy, cz)));
                 }
-                double start = glfwGetTime();
-                UNUSED(start);
-                
-                cd.chunk.render(P, V, p.second, atlasser, my_get_block, false);
-                if (con) {
-                    //dbg("Constructed: %f", (glfwGetTime() - start)*1000);
+            }
+        }
+        if (std::find(chunks.begin(), chunks.end(), nullptr) == chunks.end()) {
+            break;
+        }
+    }
+
+    // Every chunk is locked for the whole edit, so that it's journaled in the same order as it's applied, relative to any other write.
+    // Every box edit locks its chunks in ascending (x, y, z) order, and nothing else holds more than one chunk lock, so this can't deadlock
+    vector<std::unique_lock<ChunkLock>> chunk_locks;
+    for(ChunkData* cd : chunks) {
+        chunk_locks.emplace_back(cd->lock);
+    }
+
+    // Chunks that haven't been generated yet are being filled in by the world generator, which can simply generate them again
+    bool any_generated = false;
+    for(ChunkData* cd : chunks) {
+        any_generated |= (cd->state & CHUNK_STATE_GENERATED) != 0;
+    }
+    int index = 0;
+    for(int cx = first_chunk.x; cx <= last_chunk.x; cx++) {
+        for(int cy = first_chunk.y; cy <= last_chunk.y; cy++) {
+            for(int cz = first_chunk.z; cz <= last_chunk.z; cz++) {
+                if (any_generated) {
+                    journal_generated_chunk(ivec3(cx, cy, cz), chunks[index]);
                 }
-            } else {
-                cd.chunk.render(P, V, p.second, atlasser, my_get_block, true);
+                index++;
+            }
+        }
+    }
+    if (any_generated) {
+        append_journal();
+    }
+
+    index = 0;
+    for(int cx = first_chunk.x; cx <= last_chunk.x; cx++) {
+        for(int cy = first_chunk.y; cy <= last_chunk.y; cy++) {
+            for(int cz = first_chunk.z; cz <= last_chunk.z; cz++) {
+                ivec3 chunk_location = ivec3(cx, cy, cz)*CHUNK_SIZE;
+                ChunkData* cd = chunks[index++];
+                mark_dirty(ivec3(cx, cy, cz), cd);
+                // Intersect the box with this chunk
+                ivec3 first = max(location, chunk_location) - chunk_location;
+                ivec3 last = min(last_block, chunk_location + ivec3(CHUNK_SIZE-1)) - chunk_location;
+                on_chunk(cd, chunk_location, first, last);
             }
         }
     }
+}
 
-    marked_chunks.resize(0);
+void World::journal_generated_chunk(ivec3 chunk_coords, ChunkData* cd) {
+    if (!(cd->state.fetch_and(~CHUNK_STATE_UNJOURNALED) & CHUNK_STATE_UNJOURNALED)) {
+        return;
+    }
+    thread_local int buffer[CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE];
+    for(int x = 0; x < CHUNK_SIZE; x++) {
+        for(int y = 0; y < CHUNK_SIZE; y++) {
+            for(int z = 0; z < CHUNK_SIZE; z++) {
+                buffer[BOX_INDEX(ivec3(x, y, z), ivec3(CHUNK_SIZE))] = cd->chunk.get_block_model(x, y, z);
+            }
+        }
+    }
+    journal.append_paste_buffer(chunk_coords*CHUNK_SIZE, ivec3(CHUNK_SIZE), buffer);
+    journal.append_mark_generated(chunk_coords);
+}
 
+void World::for_each_chunk_in_box(ivec3 location, ivec3 size, bool create, DirectoryLock& lock, const function<void(ChunkData*, ivec3, ivec3, ivec3)>& on_chunk) {
+    if (size.x <= 0 || size.y <= 0 || size.z <= 0) {
+        return;
+    }
+    ivec3 last_block = location + size - ivec3(1);
+    ivec3 first_chunk(floor_div(location.x, CHUNK_SIZE), floor_div(location.y, CHUNK_SIZE), floor_div(location.z, CHUNK_SIZE));
+    ivec3 last_chunk(floor_div(last_block.x, CHUNK_SIZE), floor_div(last_block.y, CHUNK_SIZE), floor_div(last_block.z, CHUNK_SIZE));
+
+    for(int cx = first_chunk.x; cx <= last_chunk.x; cx++) {
+        for(int cy = first_chunk.y; cy <= last_chunk.y; cy++) {
+            for(int cz = first_chunk.z; cz <= last_chunk.z; cz++) {
+                ivec3 chunk_location = ivec3(cx, cy, cz)*CHUNK_SIZE;
+                ChunkData* cd = acquire_chunk_data(ivec3(cx, cy, cz), create, lock);
+                // Intersect the box with this chunk
+                ivec3 first = max(location, chunk_location) - chunk_location;
+                ivec3 last = min(last_block, chunk_location + ivec3(CHUNK_SIZE-1)) - chunk_location;
+                on_chunk(cd, chunk_location, first, last);
+            }
+        }
+    }
+}
+
+void World::update_heightmap(ivec3 chunk_coords, Chunk& chunk, ivec3 first, ivec3 last) {
+    // Scan the chunk before locking the heightmap, so that other threads only wait on the heightmap itself
+    ChunkHeightmap heightmap;
+    for(int x = first.x; x <= last.x; x++) {
+        for(int z = first.z; z <= last.z; z++) {
+            heightmap.heights[HEIGHTMAP_INDEX(x, z)] = chunk.get_column_height(x, z);
+        }
+    }
+
+    std::lock_guard<std::mutex> heightmap_lock(heightmap_mutex);
+    ivec3 column_coords(chunk_coords.x, 0, chunk_coords.z);
+    ColumnHeightmap& column = heightmaps[column_coords];
+    if (first.x == 0 && first.z == 0 && last.x == CHUNK_SIZE-1 && last.z == CHUNK_SIZE-1) {
+        column.set_chunk_heightmap(chunk_coords.y, heightmap);
+    } else {
+        for(int x = first.x; x <= last.x; x++) {
+            for(int z = first.z; z <= last.z; z++) {
+                column.set_height(chunk_coords.y, x, z, heightmap.heights[HEIGHTMAP_INDEX(x, z)]);
+            }
+        }
+    }
+    if (column.is_air()) {
+        heightmaps.erase(column_coords);
+    }
+}
+
+optional<int> World::get_height(int x, int z) {
+    ivec3 chunk_coords = to_chunk_coords(x, 0, z);
+    std::lock_guard<std::mutex> heightmap_lock(heightmap_mutex);
+    ColumnHeightmap* column = heightmaps.find(ivec3(chunk_coords.x, 0, chunk_coords.z));
+    if (!column) {
+        return nullopt;
+    }
+    return column->get_height(pos_mod(x, CHUNK_SIZE), pos_mod(z, CHUNK_SIZE));
+}
+
+void World::get_chunk_borders(ivec3 chunk_coords, ChunkBorders& borders) {
+    // Offsets of the six neighboring chunks, in the same order as Mesh::get_mesh_data
+    ivec3 diffs[] = {ivec3(-1, 0, 0), ivec3(1, 0, 0), ivec3(0, -1, 0), ivec3(0, 1, 0), ivec3(0, 0, -1), ivec3(0, 0, 1)};
+    for(int dir = 0; dir < 6; dir++) {
+        // Neighbors that aren't resident are left as air
+        ChunkData* cd = get_chunk_data(chunk_coords + diffs[dir]);
+        if (cd) {
+            std::shared_lock<ChunkLock> chunk_lock(cd->lock);
+            borders.set_neighbor(dir, cd->chunk.snapshot());
+        }
+    }
+}
+
+void World::refresh_box(ivec3 location, ivec3 size, DirectoryLock& lock) {
+    ivec3 last_block = location + size - ivec3(1);
+    // Every block in the box, and every block that shares a face with the box, may have a changed neighbor
+    for_each_chunk_in_box(location - ivec3(1), size + ivec3(2), false, lock, [&](ChunkData* cd, ivec3 chunk_location, ivec3 first, ivec3 last) {
+        if (!cd) {
+            return;
+        }
+        // Chunks that are outside of the box along more than one axis only touch it diagonally
+        int axes_outside = 0;
+        for(int axis = 0; axis < 3; axis++) {
+            if (chunk_location[axis] + last[axis] < location[axis] || chunk_location[axis] + first[axis] > last_block[axis]) {
+                axes_outside++;
+            }
+        }
+        if (axes_outside > 1) {
+            return;
+        }
+        std::unique_lock<ChunkLock> chunk_lock(cd->lock);
+        cd->chunk.invalidate_cache();
+    });
+}
+
+void World::print_memory_usage() {
+    // Measuring the chunks reads all of their contents, so keep every other thread out
+    std::unique_lock<std::shared_mutex> lock(directory_mutex);
+    int num_chunks = 0;
+    size_t bytes = 0;
+    megachunks.for_each([&](ivec3, unique_ptr<MegaChunk>& megachunk) {
+        num_chunks += megachunk->num_chunks();
+        bytes += megachunk->memory_usage();
+    });
+    if (num_chunks == 0) {
+        return;
+    }
+    // Before the palette, every block was a 12-byte BlockData of block_model, break_amount and neighbor_cache
+    size_t dense_bytes = 12*CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE;
+    dbg("Chunk Memory: %d chunks, %zu bytes per chunk (%zu bytes per chunk as a dense array)", num_chunks, bytes / num_chunks, dense_bytes);
+    ChunkAllocatorStatistics stats = ChunkAllocator::get_statistics();
+    dbg("Chunk Allocator: %d chunks in %d pages (%zu bytes reserved), %lld allocations, %lld frees, %lld pages released",
+        stats.num_chunks, stats.num_pages, stats.bytes_reserved, stats.total_allocations, stats.total_frees, stats.total_pages_released);
+}
+
+void World::set_memory_budget(size_t bytes) {
+    memory_budget = bytes;
+}
+
+void World::set_cold_tier_size(size_t bytes) {
+    std::unique_lock<std::shared_mutex> lock(directory_mutex);
+    cold_tier_size = bytes;
+    trim_cold_tier();
+}
+
+ColdTierStatistics World::get_cold_tier_statistics() {
+    DirectoryLock lock(directory_mutex);
+    ColdTierStatistics statistics;
+    statistics.num_megachunks = cold_megachunks.size();
+    statistics.bytes = cold_tier_bytes;
+    statistics.hits = cold_tier_hits;
+    statistics.misses = cold_tier_misses;
+    if (statistics.hits > 0) {
+        statistics.average_inflate_time = total_inflate_time / 1000.0 / statistics.hits;
+    }
+    if (statistics.misses > 0) {
+        statistics.average_disk_load_time = total_disk_load_time / 1000.0 / statistics.misses;
+    }
+    return statistics;
+}
+
+void World::pin_chunk(ivec3 chunk_coords) {
+    std::unique_lock<std::shared_mutex> lock(directory_mutex);
+    pinned_megachunks[to_megachunk_coords(chunk_coords)]++;
+}
+
+void World::unpin_chunk(ivec3 chunk_coords) {
+    std::unique_lock<std::shared_mutex> lock(directory_mutex);
+    ivec3 megachunk_coords = to_megachunk_coords(chunk_coords);
+    int* found = pinned_megachunks.find(megachunk_coords);
+    if (!found) {
+        dbg("Unpinning a megachunk that isn't pinned! (%d, %d, %d)", megachunk_coords.x, megachunk_coords.y, megachunk_coords.z);
+        return;
+    }
+    if (--(*found) == 0) {
+        pinned_megachunks.erase(megachunk_coords);
+    }
+}
+
+void World::evict_megachunks() {
     render_iteration++;
+    enforce_memory_budget();
+}
+
+void World::enforce_memory_budget() {
+    // Evicted megachunks are saved into the save directory, so without one there's nowhere to evict to
+    if (memory_budget == 0 || save_filepath.empty()) {
+        return;
+    }
+
+    // Eviction destroys megachunks, so no other thread may be looking at them
+    std::unique_lock<std::shared_mutex> lock(directory_mutex);
+
+    size_t bytes = 0;
+    // Megachunks that are allowed to be evicted, as (last_access, megachunk_coords)
+    vector<pair<int, ivec3>> candidates;
+    megachunks.for_each([&](ivec3 megachunk_coords, unique_ptr<MegaChunk>& megachunk) {
+        bytes += megachunk->memory_usage();
+        if (megachunk->last_access != render_iteration && megachunk->num_claims == 0 && !pinned_megachunks.count(megachunk_coords)) {
+            candidates.push_back({megachunk->last_access, megachunk_coords});
+        }
+    });
+    if (bytes <= memory_budget) {
+        return;
+    }
+
+    // Evict the least recently used megachunks first
+    sort(candidates.begin(), candidates.end(), [](pair<int, ivec3>& a, pair<int, ivec3>& b) -> bool {
+        return a.first < b.first;
+    });
+
+    // Flush once up front, so that each eviction's flush has nothing left to write
+    journal.flush();
+    int num_evicted = 0;
+    for(auto& p : candidates) {
+        if (bytes <= memory_budget) {
+            break;
+        }
+        bytes -= (*megachunks.find(p.second))->memory_usage();
+        save_megachunk(p.second, false);
+        num_evicted++;
+    }
+    if (num_evicted > 0) {
+        close_idle_regions();
+    }
+
+#if CHUNK_MEMORY_STATS
+    dbg("Evicted %d megachunks, %zu bytes now resident (Budget: %zu bytes)", num_evicted, bytes, memory_budget);
+    long long num_loads = cold_tier_hits + cold_tier_misses;
+    dbg("Cold tier: %zu megachunks, %zu bytes (Size: %zu bytes), %lld of %lld loads were hits", cold_megachunks.size(), cold_tier_bytes, cold_tier_size, cold_tier_hits.load(), num_loads);
+#endif
 }
 
 optional<ivec3> World::raycast(vec3 position, vec3 direction, float max_distance, bool previous_block) {
     // Ray increment
     float ray = 0.01;
     direction = normalize(direction);
+    DirectoryLock lock(directory_mutex);
+    // The cursor doesn't load megachunks, so every megachunk that the ray passes through must be loaded first
+    vec3 end = position + direction*max_distance;
+    load_megachunks_in_box(ivec3(floor(min(position, end))) - ivec3(1), ivec3(floor(max(position, end))) + ivec3(1), lock);
+    BlockCursor cursor(this, floor(position));
     for(int i = 0; i < max_distance/ray; i++) {
         // If the block is not air, then our raycast has hit a solid block
-        if(read_block(ivec3(floor(position + direction*(ray*i)))) != 0) {
+        ivec3 loc = floor(position + direction*(ray*i));
+        cursor.move_to(loc);
+        if(cursor.get_block_model() != 0) {
             if(previous_block) {
-                ivec3 loc = floor(position + direction*(ray*(i-1)));
-                return { loc };
+                ivec3 prev_loc = floor(position + direction*(ray*(i-1)));
+                return { prev_loc };
             } else {
-                return { ivec3(floor(position + direction*(ray*i))) };
+                return { loc };
             }
         }
     }
@@ -319,10 +1278,15 @@ void World::collide(AABB collision_box, fn_on_collide on_collide) {
     ivec3 bottom_left = ivec3(floor(collision_box.min_point) - vec3(1.0));
     ivec3 top_right = ivec3(ceil(collision_box.max_point));
     vec3 total_movement(0.0);
+    DirectoryLock lock(directory_mutex);
+    // The cursor doesn't load megachunks, so evicted terrain must be loaded first, or it would collide like air
+    load_megachunks_in_box(bottom_left, top_right, lock);
+    BlockCursor cursor(this, bottom_left);
     for(int x = bottom_left.x; x <= top_right.x; x++) {
         for(int y = bottom_left.y; y <= top_right.y; y++) {
             for(int z = bottom_left.z; z <= top_right.z; z++) {
-                if (read_block(x, y, z)) {
+                cursor.move_to(ivec3(x, y, z));
+                if (cursor.get_block_model()) {
                     vec3 box(x, y, z);
                     AABB static_box(box, box + vec3(1.0));
                     optional<vec3> movement_o = static_box.collide(collision_box);
@@ -342,30 +1306,136 @@ void World::collide(AABB collision_box, fn_on_collide on_collide) {
     }
 }
 
-#define ZIP_COMPRESSION true
+WorldSaveStatistics World::save(const char* filepath) {
+    WorldSaveStatistics statistics;
+    double start = glfwGetTime();
 
-void World::save(const char* filepath) {
-    char megachunk_filename[2048];
-    snprintf(megachunk_filename, sizeof(megachunk_filename), "%s/data", filepath);
-    std::error_code ec;
-    std::filesystem::create_directory(megachunk_filename);
+    char data_directory[2048];
+    snprintf(data_directory, sizeof(data_directory), "%s/data", filepath);
+    std::filesystem::create_directory(data_directory);
+
+    std::unique_lock<std::shared_mutex> lock(directory_mutex);
+    // Every edit being saved must already be in the journal, in case the save is interrupted
+    journal.flush();
 
+    // Clean megachunks are only guaranteed to be up-to-date in the directory that they were last saved to or loaded from
+    bool new_filepath = save_filepath != filepath;
+    CoordinateMap<unique_ptr<RegionFile>> old_regions;
+    if (new_filepath) {
+        std::swap(regions, old_regions);
+    }
     save_filepath = filepath;
-    
-#if ZIP_COMPRESSION
-    for(auto& p : megachunks) {
-        save_megachunk(p.second.location, true);
-    }
-#else
-    std::ofstream save_file;
-    save_file.open(filepath, std::ios::binary);
-    save_file.write((const char*)buffer, buffer_len);
-    save_file.close();
-#endif
+
+    if (new_filepath) {
+        // Megachunks that have been evicted only exist in the old directory, so carry their chunks over
+        disk_megachunks.for_each([&](ivec3 megachunk_coords, RegionFile*& old_region) {
+            RegionFile* region = get_region(megachunk_coords);
+            if (!region) {
+                return;
+            }
+            ivec3 first_chunk = megachunk_coords*MEGACHUNK_SIZE;
+            for(int i = 0; i < MEGACHUNK_SIZE; i++) {
+                for(int j = 0; j < MEGACHUNK_SIZE; j++) {
+                    for(int k = 0; k < MEGACHUNK_SIZE; k++) {
+                        ivec3 chunk_coords = first_chunk + ivec3(i, j, k);
+                        auto [payload, payload_size] = reopen_region(old_region) ? old_region->read_chunk(chunk_coords) : pair<const byte*, int>(NULL, 0);
+                        if (payload) {
+                            region->write_chunk(chunk_coords, payload, payload_size);
+                            statistics.bytes_written += payload_size;
+                        }
+                    }
+                }
+            }
+            old_region = region;
+            statistics.num_megachunks_written++;
+        });
+    }
+
+    vector<MegaChunk*> megachunks_to_write;
+    megachunks.for_each([&](ivec3 megachunk_coords, unique_ptr<MegaChunk>& megachunk) {
+        UNUSED(megachunk_coords);
+        int num_dirty_chunks = megachunk->num_dirty_chunks;
+        if (num_dirty_chunks == 0 && !new_filepath) {
+            statistics.num_megachunks_skipped++;
+            return;
+        }
+        statistics.num_megachunks_written++;
+        statistics.num_dirty_chunks += num_dirty_chunks;
+        megachunks_to_write.push_back(megachunk.get());
+    });
+    statistics.bytes_written += write_megachunks(megachunks_to_write, new_filepath);
+    regions.for_each([&](ivec3, unique_ptr<RegionFile>& region) {
+        region->flush();
+    });
+
+    // Every journaled edit is now in the region files
+    if (new_filepath) {
+        journal.open(get_journal_filename());
+    }
+    journal.clear();
+
+    statistics.time_taken = (glfwGetTime() - start)*1000;
+    return statistics;
+}
+
+void World::replay_journal_record(const JournalRecord& record) {
+    ivec3 loc = record.location;
+    switch (record.type) {
+    case JournalRecordType::WRITE_BLOCK: {
+        // set_block creates the chunk if necessary, while write_block can restore the break amount
+        set_block(loc.x, loc.y, loc.z, record.model);
+        if (record.break_amount != 0.0f) {
+            BlockData data(record.model);
+            data.break_amount = record.break_amount;
+            write_block(loc, data);
+        }
+        break;
+    }
+    case JournalRecordType::FILL_BOX:
+        fill_box(loc, record.size, record.model);
+        break;
+    case JournalRecordType::PASTE_BUFFER: {
+        // The buffer isn't aligned within the journal
+        vector<int> buffer(record.size.x*record.size.y*record.size.z);
+        memcpy(buffer.data(), record.data, buffer.size()*sizeof(int));
+        paste_buffer(loc, record.size, buffer.data());
+        break;
+    }
+    case JournalRecordType::APPLY_MASK:
+        apply_mask(loc, record.size, record.data, record.model);
+        break;
+    case JournalRecordType::MARK_GENERATED:
+        mark_generated(loc);
+        break;
+    }
 }
 
 bool World::load(const char* filepath) {
+    std::unique_lock<std::shared_mutex> lock(directory_mutex);
+    journal.close();
     megachunks.clear();
+    disk_megachunks.clear();
+    cold_megachunks.clear();
+    cold_tier_bytes = 0;
+    regions.clear();
+    {
+        std::lock_guard<std::mutex> heightmap_lock(heightmap_mutex);
+        heightmaps.clear();
+    }
+    // Nothing that was queued is on disk anymore. Loaders that are in the middle of a megachunk will see the new generation, and read it again
+    disk_generation++;
+    {
+        std::lock_guard<std::mutex> loader_lock(loader_mutex);
+        load_queue.clear();
+        loading_megachunks.clear();
+    }
+    // The chunks that are being meshed are gone, so any meshes that are in progress will be dropped when they're finished
+    {
+        std::lock_guard<std::mutex> mesher_lock(mesher_mutex);
+        mesh_queue.clear();
+        meshed_chunks.clear();
+        mesh_generation++;
+    }
 
     if (!std::filesystem::is_directory(filepath)) {
         return false;
@@ -373,32 +1443,108 @@ bool World::load(const char* filepath) {
 
     save_filepath = filepath;
 
-#if ZIP_COMPRESSION
-    char megachunk_filename[2048];
-    snprintf(megachunk_filename, sizeof(megachunk_filename), "%s/data", filepath);
-    
-    // Save filenames for all of the .data files
-    for (const auto& entry : std::filesystem::directory_iterator(megachunk_filename)) {
+    // Saves from before region files have to be converted first
+    if (migrate_save(filepath) < 0) {
+        return false;
+    }
+
+    char data_directory[2048];
+    snprintf(data_directory, sizeof(data_directory), "%s/data", filepath);
+
+    // Open every region file, and note which megachunks it holds
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(data_directory, ec)) {
+        if (entry.path().extension() != ".region") {
+            continue;
+        }
         string filename = entry.path().filename().generic_string();
 
-        int x, y, z;
-        sscanf(filename.c_str(), "%d_%d_%d.data", &x, &y, &z);
+        ivec3 region_coords;
+        if (sscanf(filename.c_str(), "r.%d.%d.%d.region", &region_coords.x, &region_coords.y, &region_coords.z) != 3) {
+            continue;
+        }
+        RegionFile* region = get_region(region_coords*REGION_SIZE);
+        if (!region) {
+            continue;
+        }
+        for(int i = 0; i < REGION_SIZE; i++) {
+            for(int j = 0; j < REGION_SIZE; j++) {
+                for(int k = 0; k < REGION_SIZE; k++) {
+                    ivec3 megachunk_coords = region_coords*REGION_SIZE + ivec3(i, j, k);
+                    if (region->has_megachunk(megachunk_coords)) {
+                        disk_megachunks[megachunk_coords] = region;
+                    }
+                }
+            }
+        }
+    }
 
-        disk_megachunks[ivec3(x, y, z)] = entry.path().generic_string();
+    // Only the tables were needed, so the region files stay closed until their megachunks are read
+    close_idle_regions();
+
+    // Replay the edits made since the last save on top of the region files.
+    // The journal is still closed, so they aren't journaled again, but they stay in the journal file until the next save
+    lock.unlock();
+    int num_records = Journal::replay(get_journal_filename(), [&](const JournalRecord& record) {
+        replay_journal_record(record);
+    });
+    if (num_records > 0) {
+        dbg("Replayed %d edits from the journal", num_records);
     }
-#else
-    save_file.seekg(0, save_file.end);
-    long length = save_file.tellg();
-    save_file.seekg(0);
+    journal.open(get_journal_filename());
 
-    if (length > buf_len) {
-        dbg("ERROR: File too large!");
-        return false;
+    return true;
+}
+
+int World::migrate_save(const char* filepath) {
+    char data_directory[2048];
+    snprintf(data_directory, sizeof(data_directory), "%s/data", filepath);
+
+    vector<std::filesystem::path> megachunk_files;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(data_directory, ec)) {
+        if (entry.path().extension() == ".data") {
+            megachunk_files.push_back(entry.path());
+        }
     }
+    if (megachunk_files.empty()) {
+        return 0;
+    }
+    dbg("Migrating %zu megachunk files in %s to region files", megachunk_files.size(), filepath);
 
-    save_file.read((char*)buf, length);
-    save_file.close();
-#endif
+    // A temporary world owns the region files while they're being written
+    World world;
+    world.save_filepath = filepath;
+    for(auto& path : megachunk_files) {
+        struct zip_t *zip = zip_open(path.generic_string().c_str(), 0, 'r');
+        if (!zip) {
+            dbg("ERROR: Failed to open %s!", path.generic_string().c_str());
+            return -1;
+        }
+        zip_entry_open(zip, "chunk");
+        int length = zip_entry_size(zip);
+        if (length < 0 || length > MAX_MEGACHUNK_SIZE) {
+            dbg("ERROR: %s has an invalid size of %d!", path.generic_string().c_str(), length);
+            zip_entry_close(zip);
+            zip_close(zip);
+            return -1;
+        }
+        vector<byte> buf(length);
+        zip_entry_noallocread(zip, buf.data(), length);
+        zip_entry_close(zip);
+        zip_close(zip);
 
-    return true;
+        MegaChunk megachunk;
+        megachunk.deserialize(buf.data(), length);
+        world.write_megachunk(&megachunk, true);
+    }
+    world.regions.for_each([&](ivec3, unique_ptr<RegionFile>& region) {
+        region->flush();
+    });
+
+    // Only remove the old files once every region file has reached the disk
+    for(auto& path : megachunk_files) {
+        std::filesystem::remove(path, ec);
+    }
+    return megachunk_files.size();
 }
@@ -4,40 +4,110 @@
 #include "utils.hpp"
 #include "aabb.hpp"
 #include "chunk.hpp"
+#include "chunk_mesher.hpp"
 #include "megachunk.hpp"
+#include "heightmap.hpp"
+#include "coordinate_map.hpp"
+#include "journal.hpp"
+#include "region_file.hpp"
 #include "texture_atlasser.hpp"
-#include "universe.hpp"
-
-/// \cond HIDDEN_SYMBOLS
-
-class IVec3Hasher
-{
-public:
-  size_t operator() (ivec3 const& key) const
-  {
-    return hash_ivec3(key);
-  }
-};
-class IVec3EqualFn
-{
-public:
-  bool operator() (ivec3 const& t1, ivec3 const& t2) const
-  {
-    return t1 == t2;
-  }
-};
-
-/// \endcond
 
 /**
  *\addtogroup VoxelEngine
  * @{
  */
 
+/// The default number of bytes of chunk memory that a World may keep resident, before evicting megachunks to disk
+#define DEFAULT_MEMORY_BUDGET (512*1024*1024)
+/// The number of seconds between fsyncs of the block-edit journal, which is the most time's worth of edits that a crash can lose
+#define JOURNAL_FLUSH_INTERVAL 1.0
+/// The size in bytes that the block-edit journal may grow to, before it's folded into the region files
+#define JOURNAL_COMPACTION_SIZE (16*1024*1024)
+/// The number of background threads that load megachunks from disk
+#define NUM_MEGACHUNK_LOADER_THREADS 2
+/// The default distance in blocks, ahead of the camera's movement, within which megachunks are loaded from disk before they're needed
+#define DEFAULT_PREFETCH_DISTANCE (2.0f*MEGACHUNK_SIZE*CHUNK_SIZE)
+/// The default number of bytes of encoded megachunks that a World keeps in memory after evicting them, see @ref World::set_cold_tier_size
+#define DEFAULT_COLD_TIER_SIZE (64*1024*1024)
+/// The number of background threads that build chunk meshes
+#define NUM_CHUNK_MESHER_THREADS 3
+/// The number of seconds per frame that @ref World::render may spend uploading chunk meshes, before leaving the rest for the next frame
+#define MESH_UPLOAD_BUDGET 0.002
+/// The number of encoded megachunks per save thread that may be waiting to be written, before the save threads wait for the writes to catch up
+#define SAVE_PIPELINE_DEPTH 2
+
+/// Whether a chunk can be used right away, as returned by @ref World::request_chunk
+enum class ChunkResidency {
+    /// The chunk is in memory
+    RESIDENT,
+    /// The chunk's megachunk is being loaded from disk by a background thread
+    LOADING,
+    /// The chunk doesn't exist, neither in memory nor on disk
+    NONEXISTENT,
+};
+
+/// Statistics about a single call to @ref World::save
+struct WorldSaveStatistics {
+    /// The number of megachunks that were written to disk
+    int num_megachunks_written = 0;
+    /// The number of resident megachunks that were not written, because they haven't changed since they were last saved or loaded
+    int num_megachunks_skipped = 0;
+    /// The number of chunks that had changed since they were last saved or loaded
+    int num_dirty_chunks = 0;
+    /// The number of bytes written to disk
+    size_t bytes_written = 0;
+    /// The time taken to save the world, in milliseconds
+    double time_taken = 0.0;
+};
+
+/// Statistics about the cold tier of evicted megachunks, as returned by @ref World::get_cold_tier_statistics
+struct ColdTierStatistics {
+    /// The number of megachunks in the cold tier
+    int num_megachunks = 0;
+    /// The number of bytes used by the megachunks in the cold tier
+    size_t bytes = 0;
+    /// The number of evicted megachunks that were loaded back from the cold tier
+    long long hits = 0;
+    /// The number of evicted megachunks that had to be loaded back from disk
+    long long misses = 0;
+    /// The average time taken to load a megachunk from the cold tier, in milliseconds
+    double average_inflate_time = 0.0;
+    /// The average time taken to load a megachunk from disk, in milliseconds
+    double average_disk_load_time = 0.0;
+};
+
 /// Callback type for a collision event. When called, it will give a translation vector for how to no longer be colliding, and the coefficient of friction.
 using fn_on_collide = std::function<void(vec3, float)>;
 
 /// The World class refers to a single VoxelEngine world
+/**
+ * ## Concurrency
+ *
+ * The world may be used by several threads at once, such as world generation, disk I/O and gameplay threads,
+ * as long as they work on different chunks. Threads that work on the same chunk are serialized, one block access at a time.
+ *
+ * - The main thread is the thread that renders the world. Only the main thread may call @ref render, @ref evict_megachunks, @ref mark_chunk,
+ *   @ref save, @ref load, @ref set_memory_budget, @ref set_cold_tier_size, @ref set_prefetch_distance and @ref set_generator. Every other method may be called from any thread.
+ * - The chunk directory, which maps coordinates to megachunks and chunks, is guarded by a reader/writer lock.
+ *   Every world operation holds it in shared mode, so that any number of operations can run at the same time.
+ *   Only creating chunks, loading megachunks from disk, evicting megachunks, and saving or loading the world hold it exclusively,
+ *   and so megachunks are never destroyed while an operation is looking at them.
+ * - Megachunks are loaded from disk by background threads, which read them while holding the directory lock in shared mode,
+ *   and then only briefly hold it exclusively to insert them. The main thread never waits on the disk, see @ref request_chunk.
+ *   Every other operation that needs an evicted megachunk will still load it itself, blocking until it's read.
+ * - Every chunk has its own @ref ChunkLock. Reading a block holds it in shared mode, while writing a block,
+ *   invalidating the chunk's render cache, or uploading the chunk's mesh holds it exclusively.
+ *   Only the box edits @ref fill_box, @ref paste_buffer and @ref apply_mask hold several chunk locks at once, exclusively and for the whole edit,
+ *   and they always acquire them in ascending (x, y, z) chunk order, by x, then y, then z. Every other operation holds one chunk lock at a time.
+ *   A thread never waits on a chunk lock while it holds another one, except for the next chunk in that order, and so chunk locks can never deadlock.
+ * - Chunks are meshed by background threads, from snapshots of the chunk and the borders of its neighbors.
+ *   Only the finished meshes are uploaded by the main thread.
+ * - Every chunk also has atomic state flags, see @ref CHUNK_STATE_GENERATED. A thread that will spend a long time on a chunk,
+ *   such as generating it, should first claim it with @ref try_claim_chunk, so that no other thread does the same work,
+ *   and so that the chunk will not be evicted until the claim is released.
+ * - A thread that only needs to read a chunk for a long time, such as for meshing or saving it,
+ *   should take a @ref ChunkSnapshot with @ref snapshot_chunk. Reading a snapshot requires no locks at all.
+ */
 
 class World {
 public:
@@ -46,19 +116,60 @@ public:
 
     /// Creates a new world with no loaded chunks
     World();
+    /// Stops the background loader and mesher threads
+    ~World();
 
     /// Sets a block to the given blocktype
     void set_block(int x, int y, int z, int model);
     
-    /// Retrives the blockdata for viewing purposes.
-    const BlockData* read_block(int x, int y, int z);
-    /// Retrives the blockdata for viewing purposes.
-    const BlockData* read_block(ivec3 location);
+    /// Retrives the blockdata for viewing purposes. Returns nullopt if the block is air, or if its chunk doesn't exist
+    optional<BlockData> read_block(int x, int y, int z);
+    /// Retrives the blockdata for viewing purposes. Returns nullopt if the block is air, or if its chunk doesn't exist
+    optional<BlockData> read_block(ivec3 location);
+
+    /// Overwrites the blockdata of an existing block. Will trigger a chunk rerender
+    void write_block(int x, int y, int z, const BlockData& data);
+    /// Overwrites the blockdata of an existing block. Will trigger a chunk rerender
+    void write_block(ivec3 location, const BlockData& data);
+
+    /// Try to claim the chunk at the given chunk-coordinates for the given task
+    /**
+     * @param chunk_coords The chunk-coordinates of the chunk to claim
+     * @param claim One of @ref CHUNK_STATE_GENERATING, @ref CHUNK_STATE_MESHING, or @ref CHUNK_STATE_SAVING
+     *
+     * @returns true if the chunk has now been claimed. false if the chunk doesn't exist, or if another thread already holds the same claim on it.
+     * A successful claim must be released with @ref release_chunk
+     */
+    bool try_claim_chunk(ivec3 chunk_coords, int claim);
+    /// Release a claim on a chunk, that was taken by @ref try_claim_chunk
+    void release_chunk(ivec3 chunk_coords, int claim);
+
+    /// Take a read-only snapshot of the chunk at the given chunk-coordinates, or nullopt if the chunk doesn't exist
+    /**
+     * Taking a snapshot is O(1), and the snapshot can be read from any thread without locking the world,
+     * while the world continues to be modified. See @ref ChunkSnapshot
+     */
+    optional<ChunkSnapshot> snapshot_chunk(ivec3 chunk_coords);
 
-    /// Retrieves the blockdata for writing purposes. Will trigger a chunk rerender
-    BlockData* write_block(int x, int y, int z);
-    /// Retrieves the blockdata for writing purposes. Will trigger a chunk rerender
-    BlockData* write_block(ivec3 location);
+    /** @name Region operations
+     * Each region operation acts on the box of blocks that starts at the given location, and has the given size.
+     * Buffers and masks hold one entry per block of the box, where the block at offset (x, y, z) within the box
+     * is at index ((x*size.y + y)*size.z + z). This is the same ordering as a chunk.
+     *
+     * Region operations write directly into chunk storage, creating chunks as necessary.
+     * Then, each touched chunk, and each chunk that borders the box, will be invalidated only once.
+     * This is much faster than calling @ref set_block on each block, which invalidates up to six chunks per block.
+     */
+    ///@{
+    /// Set every block in the box to the given blocktype
+    void fill_box(ivec3 location, ivec3 size, int model);
+    /// Copy the block model of every block in the box into the buffer, using 0 for air and nonexistent chunks
+    void copy_box_to_buffer(ivec3 location, ivec3 size, int* buffer);
+    /// Set every block in the box to the blocktype in the buffer
+    void paste_buffer(ivec3 location, ivec3 size, const int* buffer);
+    /// Set every block in the box that has a nonzero mask entry to the given blocktype, leaving the other blocks untouched
+    void apply_mask(ivec3 location, ivec3 size, const byte* mask, int model);
+    ///@}
 
     /// Mark a chunk for rendering.
     /**
@@ -73,21 +184,63 @@ public:
      * regardless of whether or not neighboring chunks are actually marked for render.
      * 
      * @param chunk_coords the chunk coordinates of the chunk that is to be marked for rendering
-     * @param priority The priority of the chunk render. If several chunks have yet to be rendered,
-     * only a single chunk mesh will be generated per frame, as rendering can take 5-10ms.
-     * Thus, if only a single chunk may be chosen, then the chunk with the lowest priority value will be rendered first.
-     * A chunk with priority 0 is guaranteed to be forcibly rendered, regardless of how long it takes.
+     * @param priority The priority of the chunk render. Chunks that have changed are meshed by background threads,
+     * and drawn out-of-date until their new mesh is ready. Chunks with a lower priority value are meshed first,
+     * and the finished meshes are uploaded in the same order, only for up to @ref MESH_UPLOAD_BUDGET seconds per frame.
+     * The mesh of a chunk with priority 0 is always uploaded as soon as it's ready, regardless of how long it takes.
+     *
+     * If the chunk, or a neighboring chunk, is still being loaded from disk, then the chunk is not marked, and it will not be rendered this frame.
      */ 
     void mark_chunk(ivec3 chunk_coords, int priority);
 
+    /// Check whether a chunk is in memory, without ever waiting on the disk
+    /**
+     * If the chunk's megachunk has been evicted to disk, it's queued to be loaded by a background thread,
+     * and @ref ChunkResidency::LOADING is returned until it's back in memory.
+     * Note that a megachunk on disk may not hold the given chunk, in which case the chunk will go from LOADING to NONEXISTENT.
+     */
+    ChunkResidency request_chunk(ivec3 chunk_coords);
+    /// Set the distance in blocks, ahead of the camera's movement, within which megachunks are loaded from disk before they're needed. 0 disables prefetching
+    /**
+     * The camera position is taken from the view matrix given to @ref render, and the movement direction from how it changes between frames.
+     */
+    void set_prefetch_distance(float distance);
+
     /// Mark a chunk as having been generated by the world generator. This is to keep track of which chunks have been generated
     void mark_generated(ivec3 chunk_coords);
 
     /// Returns true if the chunk has been generated by the world generator
     bool is_generated(ivec3 chunk_coords);
 
+    /// Get the y-coordinate of the topmost non-air block at the given x and z, or nullopt if every block there is air
+    /**
+     * This is O(1), as the heightmap of every column of chunks is kept up-to-date as blocks are written and as megachunks are loaded,
+     * and it's kept when megachunks are evicted.
+     *
+     * Heightmaps aren't saved. After @ref load, each megachunk is only added to the heightmaps once it's first read from disk,
+     * so a column whose chunks haven't been accessed yet reads as air. Use @ref request_chunk to load them first.
+     */
+    optional<int> get_height(int x, int z);
+
+    /// Set the deterministic world generator that generates the chunks of this world, see @ref ChunkGenerator
+    /**
+     * Chunks that have been marked as generated are then saved as only the blocks that differ from what the generator generates,
+     * so that chunks that were never edited take a few bytes on disk. When they're loaded, they're regenerated instead,
+     * on the background loader threads.
+     *
+     * This doesn't generate any chunks by itself, the game must still generate each chunk and call @ref mark_generated.
+     * A world that was saved with a generator can only be loaded once the same generator has been set.
+     */
+    void set_generator(uint32_t generator_id, uint64_t seed, fn_generate_chunk generate);
+
     /// Renders the world, based on the marked chunks
     void render(mat4& P, mat4& V, TextureAtlasser& atlasser);
+    /// Start a new render iteration without rendering anything, and evict megachunks until the world is within its memory budget
+    /**
+     * @ref render does this on its own. This is for worlds that are never rendered, such as in headless tests,
+     * where every megachunk that was accessed before the call may then be evicted.
+     */
+    void evict_megachunks();
 
     /// Casts a ray onto the first block that the ray intersects. Returns the intersected block, if any
     /**
@@ -117,31 +270,290 @@ public:
      * @param collision_box The collision box that the world must try to push out
      * @param on_collide The callback that will be executed for every collision that the collision_box must go through.
      * on_collide will be given a vec3 showing what translation is needed to exit the collision situation.
+     * on_collide must not call back into the world.
      */
     void collide(AABB collision_box, fn_on_collide on_collide);
 
     /// Save the world to the given filepath
-    void save(const char* filepath);
-    /// Load the world from the given filepath
+    /**
+     * Only megachunks that have changed since they were last saved or loaded are written.
+     * Saving to a different filepath than the world was last saved to or loaded from will write every megachunk.
+     *
+     * Once the world has a save directory, every edit is also appended to a journal in that directory,
+     * which is fsynced every @ref JOURNAL_FLUSH_INTERVAL seconds. Saving folds the journal into the region files and clears it,
+     * which happens automatically once the journal reaches @ref JOURNAL_COMPACTION_SIZE.
+     *
+     * @return Statistics about what was written
+     */
+    WorldSaveStatistics save(const char* filepath);
+    /// Load the world from the given filepath, replaying any edits from its journal that hadn't been saved yet
+    /**
+     * Only the region files are opened here. Megachunks are read from them when they're first accessed.
+     */
     bool load(const char* filepath);
+    /// Convert a save from the old format of one .data file per megachunk, into region files
+    /**
+     * This is done automatically by @ref load, and does nothing if the save has no .data files.
+     *
+     * @return The number of megachunk files that were converted, or -1 if one of them couldn't be read
+     */
+    static int migrate_save(const char* filepath);
+
+    /// Print the number of resident chunks, and the average number of bytes of memory that each one uses
+    void print_memory_usage();
+
+    /// Set the number of bytes of chunk memory that may be kept resident. 0 means unlimited
+    /**
+     * Once the resident chunks use more memory than the budget, the least recently used megachunks
+     * will be saved to disk and evicted from memory, until the world is back within budget.
+     * Megachunks that have been accessed during the current render iteration, and pinned megachunks, are never evicted.
+     * Evicted megachunks are transparently loaded back from disk when they are next accessed.
+     *
+     * Eviction requires a save directory, so nothing will be evicted until the world has been saved or loaded.
+     */
+    void set_memory_budget(size_t bytes);
+    /// Set the number of bytes of evicted megachunks that may be kept in memory in their encoded form. 0 disables the cold tier
+    /**
+     * Evicted megachunks are first moved into the cold tier, where every chunk is kept as the payload that it's saved with,
+     * which uses a fraction of the memory of a resident chunk. Loading a megachunk back from the cold tier only has to decode it,
+     * rather than read it from its region file. Once the cold tier is over its size, the megachunks that were evicted the longest ago
+     * are dropped from it, and will then be loaded from disk.
+     */
+    void set_cold_tier_size(size_t bytes);
+    /// Get the size of the cold tier, and how often and how quickly evicted megachunks have been loaded from it, see @ref set_cold_tier_size
+    ColdTierStatistics get_cold_tier_statistics();
+    /// Pin the megachunk containing the given chunk, so that it will not be evicted from memory. Pins are counted
+    void pin_chunk(ivec3 chunk_coords);
+    /// Undo a previous call to @ref pin_chunk
+    void unpin_chunk(ivec3 chunk_coords);
     
 private:
+    friend class BlockCursor;
+
     string save_filepath;
+    // Every edit is appended to the journal, which is replayed on top of the region files when the world is loaded
+    Journal journal;
+    double last_journal_flush = 0.0;
+    // Apply a record that was read back from the journal
+    void replay_journal_record(const JournalRecord& record);
+
+    // Guards megachunks, disk_megachunks, regions, generator and pinned_megachunks, and the creation of chunks within a megachunk
+    std::shared_mutex directory_mutex;
+    // Held by every world operation
+    using DirectoryLock = std::shared_lock<std::shared_mutex>;
 
     // Map from megachunk_coords to megachunks is here
-    unordered_map<ivec3, MegaChunk, IVec3Hasher, IVec3EqualFn> megachunks;
-    unordered_map<ivec3, string, IVec3Hasher, IVec3EqualFn> disk_megachunks;
+    CoordinateMap<unique_ptr<MegaChunk>> megachunks;
+    // Map from megachunk_coords to the region file of megachunks that are not in memory
+    CoordinateMap<RegionFile*> disk_megachunks;
+    // Map from region coordinates to the region files in save_filepath. They're closed while none of their megachunks are in memory,
+    // but never destroyed, as disk_megachunks points to them
+    CoordinateMap<unique_ptr<RegionFile>> regions;
+    // Guards reopening a closed region file while directory_mutex is only held in shared mode
+    std::mutex region_open_mutex;
+    // Generated chunks are saved as their edits against it. Guarded by directory_mutex
+    optional<ChunkGenerator> generator;
 
+    // Unless otherwise noted, these require directory_mutex to be held, in either mode.
+    // Block accesses will acquire the chunk lock themselves
     Chunk* get_chunk(int x, int y, int z);
-    BlockData* get_block(int x, int y, int z);
+    optional<BlockData> get_block(int x, int y, int z);
+    int get_block_model(int x, int y, int z);
     void refresh_block(int x, int y, int z);
 
+    // Call on_chunk for every chunk that intersects the given box, with the chunk's location in block-coordinates,
+    // and the first and last block of the intersection in chunk-local coordinates. on_chunk must acquire the chunk lock itself.
+    // If create is true, then nonexistent chunks will be created. Otherwise, they will be passed as NULL
+    void for_each_chunk_in_box(ivec3 location, ivec3 size, bool create, DirectoryLock& lock, const function<void(ChunkData*, ivec3, ivec3, ivec3)>& on_chunk);
+    // Edit every chunk that intersects the given box, creating them if necessary, with the same arguments as for_each_chunk_in_box.
+    // Every chunk is locked exclusively, in ascending (x, y, z) chunk order, before append_journal is called, and stays locked until each has been passed to on_chunk.
+    // The edit is only journaled if any of the chunks has been generated, as the world generator writes to chunks before marking them as generated
+    void edit_box(ivec3 location, ivec3 size, DirectoryLock& lock, const function<void()>& append_journal, const function<void(ChunkData*, ivec3, ivec3, ivec3)>& on_chunk);
+    // Journal the blocks of a generated chunk that has never been journaled nor saved, before its first edit is journaled. Requires the chunk lock
+    void journal_generated_chunk(ivec3 chunk_coords, ChunkData* cd);
+    // Invalidate every chunk that contains a block in the given box, or a block that borders the box
+    void refresh_box(ivec3 location, ivec3 size, DirectoryLock& lock);
+    // Copy the borders of the six chunks neighboring the given chunk. Acquires each neighbor's chunk lock itself
+    void get_chunk_borders(ivec3 chunk_coords, ChunkBorders& borders);
+
+    // Map from (chunk x, 0, chunk z) to the heightmap of that column of chunks. Guarded by heightmap_mutex
+    CoordinateMap<ColumnHeightmap> heightmaps;
+    // May be acquired while holding a chunk lock, or directory_mutex, but nothing is ever acquired while holding it
+    std::mutex heightmap_mutex;
+    // Update the heightmap of the column of chunks, for the columns of blocks of the chunk from first to last, in chunk-local x and z.
+    // The chunk lock must be held, so that the heightmap changes in the same order as the blocks do
+    void update_heightmap(ivec3 chunk_coords, Chunk& chunk, ivec3 first, ivec3 last);
+
+    // Only used by the main thread
     vector<pair<int, ivec3>> marked_chunks;
+    // Look up a resident chunk. Returns NULL if the chunk doesn't exist, or if its megachunk is on disk
     ChunkData* get_chunk_data(ivec3 chunk_coords);
+    // Look up a chunk, loading its megachunk from disk if necessary, and creating the chunk if create is true.
+    // If anything has to be loaded or created, the lock will be released and directory_mutex will be briefly held exclusively,
+    // so any pointers from earlier lookups must not be used afterwards
+    ChunkData* acquire_chunk_data(ivec3 chunk_coords, bool create, DirectoryLock& lock);
+    // Load every megachunk on disk that contains a block from first_block to last_block, inclusive.
+    // Like acquire_chunk_data, the lock may be released while loading, so earlier lookups must not be used afterwards
+    void load_megachunks_in_box(ivec3 first_block, ivec3 last_block, DirectoryLock& lock);
+    // Mark a resident chunk as changed since it was last saved
+    void mark_dirty(ivec3 chunk_coords, ChunkData* cd);
+    // Read a megachunk out of its region file, without inserting it. Requires directory_mutex to be held, in either mode
+    MegaChunk* read_disk_megachunk(ivec3 megachunk_coords, RegionFile* region);
+    // These require directory_mutex to be held exclusively
     void load_disk_megachunk(ivec3 megachunk_coords);
+    // Insert a megachunk that was read by read_disk_megachunk, in place of its disk_megachunks entry, and merge its chunks into the heightmaps
+    void insert_disk_megachunk(MegaChunk* megachunk);
+    // Save the megachunk's dirty chunks, and then evict it unless keep_in_memory is true
     void save_megachunk(ivec3 megachunk_coords, bool keep_in_memory = false);
+    // Write the megachunk's dirty chunks, or all of them, to its region file and mark it clean. Returns the number of bytes written.
+    // The region file must be flushed afterwards
+    size_t write_megachunk(MegaChunk* megachunk, bool all_chunks);
+    // Same as write_megachunk for every given megachunk, but encoding them on a pool of threads, while the calling thread writes
+    // the megachunks that have already been encoded
+    size_t write_megachunks(const vector<MegaChunk*>& megachunks_to_write, bool all_chunks);
+    // The payloads of a megachunk's chunks, as encoded by encode_megachunk and written by write_encoded_megachunk
+    struct EncodedMegaChunk {
+        MegaChunk* megachunk = NULL;
+        // Every payload, back-to-back
+        vector<byte> payloads;
+        struct EncodedChunk {
+            ivec3 chunk_coords;
+            int payload_size;
+            bool dirty;
+        };
+        // Every chunk, in the order of payloads
+        vector<EncodedChunk> chunks;
+    };
+    // Only reads the megachunk, so any number of megachunks may be encoded at once, as long as directory_mutex is held exclusively for them
+    void encode_megachunk(MegaChunk* megachunk, bool all_chunks, EncodedMegaChunk& encoded);
+    // Write the encoded chunks that are dirty, or all of them, and mark the megachunk clean. Returns the number of bytes written
+    size_t write_encoded_megachunk(const EncodedMegaChunk& encoded, bool all_chunks);
+    // Get the region file in save_filepath that holds the given megachunk, opening or creating it if necessary
+    RegionFile* get_region(ivec3 megachunk_coords);
+    // Open the given region file again if it was closed. Returns false if it couldn't be opened
+    bool reopen_region(RegionFile* region);
+    // Close the region files that none of the resident or cold megachunks are in. Requires directory_mutex to be held exclusively
+    void close_idle_regions();
+    string get_journal_filename();
     Chunk* make_chunk(int x, int y, int z);
-    int render_iteration = 0;
+    std::atomic<int> render_iteration{0};
+    // Record that a megachunk was accessed during this render iteration
+    void touch_megachunk(MegaChunk* megachunk);
+
+    // Guards load_queue, loading_megachunks, loader_threads and stop_loaders
+    std::mutex loader_mutex;
+    std::condition_variable loader_cv;
+    // Megachunks waiting to be loaded by a background thread, most urgent first
+    std::deque<ivec3> load_queue;
+    // Megachunks that are either queued, or being loaded
+    CoordinateMap<byte> loading_megachunks;
+    // Started when the first megachunk is queued
+    vector<std::thread> loader_threads;
+    bool stop_loaders = false;
+    // Incremented whenever a megachunk is put on disk, so that a loader can tell whether what it read might already be stale.
+    // Guarded by directory_mutex
+    int disk_generation = 0;
+    // Queue the megachunk to be loaded if it's on disk, in front of every other queued megachunk if urgent is true.
+    // Requires directory_mutex to be held, in either mode
+    ChunkResidency request_megachunk(ivec3 megachunk_coords, bool urgent);
+    // The loop of a background loader thread
+    void run_loader();
+
+    // A chunk waiting to be meshed by a background mesher thread
+    struct MeshJob {
+        ivec3 chunk_coords;
+        ChunkSnapshot snapshot;
+        ChunkBorders borders;
+        // The chunk's cache version when it was snapshotted
+        int cache_version;
+        // The mesh_generation when the job was queued
+        int generation;
+    };
+    // A mesh that has been built, and is waiting for the main thread to upload it
+    struct MeshedChunk {
+        int priority;
+        ivec3 chunk_coords;
+        int cache_version;
+        ChunkMesh mesh;
+    };
+    // Guards mesh_queue, meshed_chunks, mesher_threads, stop_meshers and mesh_generation
+    std::mutex mesher_mutex;
+    std::condition_variable mesher_cv;
+    // Chunks waiting to be meshed, by render priority. Every chunk here, or in meshed_chunks, is claimed with CHUNK_STATE_MESHING
+    std::multimap<int, unique_ptr<MeshJob>> mesh_queue;
+    vector<MeshedChunk> meshed_chunks;
+    // Started when the first chunk is queued
+    vector<std::thread> mesher_threads;
+    bool stop_meshers = false;
+    // Incremented whenever the world is loaded, so that the meshes of chunks that were unloaded are dropped
+    int mesh_generation = 0;
+    // Queue a claimed chunk to be meshed. Requires directory_mutex to be held, in either mode
+    void queue_mesh(ivec3 chunk_coords, ChunkData& cd, int priority);
+    // The loop of a background mesher thread
+    void run_mesher();
+    // Megachunks being encoded by the save threads, for write_megachunks
+    struct SaveJob {
+        const vector<MegaChunk*>* megachunks;
+        bool all_chunks;
+        vector<EncodedMegaChunk> encoded;
+        // The number of encoded megachunks that may be waiting to be written, before the save threads wait
+        int max_unwritten;
+        // The next megachunk to encode
+        int next_megachunk = 0;
+        // Megachunks that are being encoded, or are encoded but not yet written
+        int num_unwritten = 0;
+        // Indices of the megachunks that are encoded, in the order that they were finished
+        std::deque<int> encoded_megachunks;
+    };
+    // Guards save_job, saver_threads, stop_savers and the progress of the save job
+    std::mutex saver_mutex;
+    std::condition_variable saver_cv;
+    // The job of the write_megachunks call in progress, if any. There's at most one, as it requires directory_mutex to be held exclusively
+    SaveJob* save_job = NULL;
+    // Grown by write_megachunks to the number of threads that it encodes with, which is at most one per core
+    vector<std::thread> saver_threads;
+    bool stop_savers = false;
+    // The loop of a background save thread
+    void run_saver();
+    // Upload the meshes that have been built, most urgent first, until MESH_UPLOAD_BUDGET has been spent,
+    // and release their claims. Only called by the main thread, while holding directory_mutex in either mode
+    void upload_meshes(const TextureAtlasser& atlasser);
+
+    float prefetch_distance = DEFAULT_PREFETCH_DISTANCE;
+    optional<vec3> last_camera_position;
+    // Normalized, or zero if the camera hasn't moved yet
+    vec3 camera_direction = vec3(0.0f);
+    // Queue every megachunk on disk within prefetch_distance, ahead of the camera's movement
+    void prefetch(vec3 camera_position);
+
+    // Evicted megachunks, in the encoding that's also in their region file. Every megachunk here is still in disk_megachunks.
+    // Guarded by directory_mutex
+    struct ColdMegaChunk {
+        EncodedMegaChunk encoded;
+        // Megachunks with the lowest eviction_order were evicted first, and are dropped first
+        long long eviction_order;
+    };
+    CoordinateMap<ColdMegaChunk> cold_megachunks;
+    size_t cold_tier_size = DEFAULT_COLD_TIER_SIZE;
+    size_t cold_tier_bytes = 0;
+    long long next_eviction_order = 0;
+    std::atomic<long long> cold_tier_hits{0};
+    std::atomic<long long> cold_tier_misses{0};
+    // In microseconds
+    std::atomic<long long> total_inflate_time{0};
+    std::atomic<long long> total_disk_load_time{0};
+    // These require directory_mutex to be held exclusively
+    // Move an evicted megachunk into the cold tier, taking the encoded payloads
+    void insert_cold_megachunk(ivec3 megachunk_coords, EncodedMegaChunk& encoded);
+    void erase_cold_megachunk(ivec3 megachunk_coords);
+    // Drop the megachunks that were evicted the longest ago from the cold tier, until it's within cold_tier_size
+    void trim_cold_tier();
+
+    size_t memory_budget = DEFAULT_MEMORY_BUDGET;
+    // Map from megachunk_coords to the number of times that megachunk has been pinned
+    CoordinateMap<int> pinned_megachunks;
+    // Evict least recently used megachunks until the resident chunks are within memory_budget
+    void enforce_memory_budget();
 };
 
 /**@}*/
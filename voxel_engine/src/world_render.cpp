@@ -0,0 +1,175 @@
+#include "world.hpp"
+#include "universe.hpp"
+
+// The parts of World that render, and that mesh chunks with the universe's block models, which headless builds leave out
+
+static ivec3 to_megachunk_coords(ivec3 chunk_coords) {
+    return ivec3(floor_div(chunk_coords.x, MEGACHUNK_SIZE), floor_div(chunk_coords.y, MEGACHUNK_SIZE), floor_div(chunk_coords.z, MEGACHUNK_SIZE));
+}
+
+// Number of render iterations between checks of the memory budget
+#define MEMORY_BUDGET_CHECK_INTERVAL 60
+
+void World::render(mat4& P, mat4& V, TextureAtlasser& atlasser) {
+    atlasser.get_atlas_texture();
+
+    // The camera is at the origin of view space
+    prefetch(vec3(inverse(V)[3]));
+
+    sort(marked_chunks.begin(), marked_chunks.end(), [](pair<int, ivec3>& a, pair<int, ivec3>& b) -> bool {
+        return a.first < b.first;
+    });
+
+    DirectoryLock lock(directory_mutex);
+    // Upload first, so that the meshes that were just finished are drawn this frame
+    upload_meshes(atlasser);
+    for(auto& p : marked_chunks) {
+        int priority = p.first;
+        // Only the main thread evicts megachunks, and never ones that were accessed this iteration, so every marked chunk is still resident
+        ChunkData& cd = *get_chunk_data(p.second);
+
+        if (cd.last_render_mark == render_iteration) {
+            bool is_cached;
+            {
+                std::shared_lock<ChunkLock> chunk_lock(cd.lock);
+                is_cached = cd.chunk.is_cached();
+            }
+            // A chunk is only queued once at a time, and is drawn out-of-date until its new mesh has been uploaded
+            if (!is_cached && !(cd.state.fetch_or(CHUNK_STATE_MESHING) & CHUNK_STATE_MESHING)) {
+                (*megachunks.find(to_megachunk_coords(p.second)))->num_claims++;
+                queue_mesh(p.second, cd, priority);
+            }
+            cd.chunk.render(P, V, p.second);
+        }
+    }
+
+    marked_chunks.resize(0);
+    lock.unlock();
+
+    // Edits are journaled from any thread, but only reach the disk here
+    if (glfwGetTime() - last_journal_flush >= JOURNAL_FLUSH_INTERVAL) {
+        journal.flush();
+        last_journal_flush = glfwGetTime();
+    }
+    if (journal.is_open() && journal.size() > JOURNAL_COMPACTION_SIZE) {
+        // Saving to the current save directory folds the journal into the region files
+        string filepath = save_filepath;
+        save(filepath.c_str());
+    }
+
+#if CHUNK_MEMORY_STATS
+    if (render_iteration % 900 == 0) {
+        print_memory_usage();
+    }
+#endif
+
+    if (render_iteration % MEMORY_BUDGET_CHECK_INTERVAL == 0) {
+        enforce_memory_budget();
+    }
+
+    render_iteration++;
+}
+
+void World::queue_mesh(ivec3 chunk_coords, ChunkData& cd, int priority) {
+    unique_ptr<MeshJob> job;
+    {
+        // The version is read along with the snapshot, so that any later change to the chunk will be noticed when it's uploaded
+        std::shared_lock<ChunkLock> chunk_lock(cd.lock);
+        job.reset(new MeshJob{chunk_coords, cd.chunk.snapshot(), ChunkBorders(), cd.chunk.get_cache_version(), 0});
+    }
+    // A neighbor that changes after its border has been copied will invalidate this chunk, and so bump the version
+    get_chunk_borders(chunk_coords, job->borders);
+
+    std::lock_guard<std::mutex> mesher_lock(mesher_mutex);
+    if (mesher_threads.empty()) {
+        for(int i = 0; i < NUM_CHUNK_MESHER_THREADS; i++) {
+            mesher_threads.emplace_back(&World::run_mesher, this);
+        }
+    }
+    job->generation = mesh_generation;
+    mesh_queue.emplace(priority, std::move(job));
+    mesher_cv.notify_one();
+}
+
+// Look up the components of a block model in the universe, for a ChunkMesher
+static vector<MesherComponent> get_universe_mesher_components(int block_model) {
+    vector<MesherComponent> components;
+    for(const ComponentPossibilities& cp : get_universe()->get_model(block_model)->generate_model_instance(map<string,string>{})) {
+        Component* component = get_universe()->get_component(cp[0]);
+        MesherComponent mesher_component;
+        const bool* opacities = component->get_opacities();
+        std::copy(opacities, opacities + 6, mesher_component.opacities);
+        mesher_component.texture_tiles = component->get_texture_tiles();
+        mesher_component.cube_faces = component->get_cube_faces();
+        mesher_component.get_tile_mesh_data = [component](bool* visible_neighbors) {
+            return component->get_tile_mesh_data(visible_neighbors);
+        };
+        components.push_back(std::move(mesher_component));
+    }
+    return components;
+}
+
+void World::run_mesher() {
+    // Each thread has its own mesher, as a mesher caches the block models it has seen
+    ChunkMesher mesher(get_universe_mesher_components);
+    while (true) {
+        int priority;
+        unique_ptr<MeshJob> job;
+        {
+            std::unique_lock<std::mutex> lock(mesher_mutex);
+            mesher_cv.wait(lock, [this]() {
+                return stop_meshers || !mesh_queue.empty();
+            });
+            if (stop_meshers) {
+                return;
+            }
+            priority = mesh_queue.begin()->first;
+            job = std::move(mesh_queue.begin()->second);
+            mesh_queue.erase(mesh_queue.begin());
+        }
+
+        // Meshing only reads the snapshots, so it needs no locks at all
+        MeshedChunk meshed{priority, job->chunk_coords, job->cache_version, ChunkMesh()};
+        mesher.mesh(job->snapshot, job->borders, meshed.mesh);
+
+        std::lock_guard<std::mutex> lock(mesher_mutex);
+        // If the world has been loaded since, then the chunk is gone, along with its claim
+        if (job->generation == mesh_generation) {
+            meshed_chunks.push_back(std::move(meshed));
+        }
+    }
+}
+
+void World::upload_meshes(const TextureAtlasser& atlasser) {
+    vector<MeshedChunk> finished;
+    {
+        std::lock_guard<std::mutex> mesher_lock(mesher_mutex);
+        finished.swap(meshed_chunks);
+    }
+    sort(finished.begin(), finished.end(), [](const MeshedChunk& a, const MeshedChunk& b) -> bool {
+        return a.priority < b.priority;
+    });
+
+    double start = glfwGetTime();
+    size_t num_uploaded = 0;
+    for(MeshedChunk& meshed : finished) {
+        // Chunks with priority 0 are always uploaded right away, but the rest wait once this frame's budget has been spent
+        if (meshed.priority != 0 && glfwGetTime() - start > MESH_UPLOAD_BUDGET) {
+            break;
+        }
+        // Claimed chunks are never evicted, so the chunk must still be resident
+        ChunkData* cd = get_chunk_data(meshed.chunk_coords);
+        {
+            std::unique_lock<ChunkLock> chunk_lock(cd->lock);
+            cd->chunk.upload_mesh(meshed.mesh, atlasser, meshed.cache_version);
+        }
+        cd->state &= ~CHUNK_STATE_MESHING;
+        (*megachunks.find(to_megachunk_coords(meshed.chunk_coords)))->num_claims--;
+        num_uploaded++;
+    }
+
+    if (num_uploaded < finished.size()) {
+        std::lock_guard<std::mutex> mesher_lock(mesher_mutex);
+        meshed_chunks.insert(meshed_chunks.end(), std::make_move_iterator(finished.begin() + num_uploaded), std::make_move_iterator(finished.end()));
+    }
+}
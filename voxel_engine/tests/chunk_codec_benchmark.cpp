@@ -0,0 +1,116 @@
+#include "headless_world.hpp"
+#include "../src/chunk_codec.hpp"
+#include <chrono>
+
+// The bundled zip library is built on miniz, whose deflate works directly on memory buffers.
+// Its implementation is compiled along with the zip library, so only the declarations are needed here
+#define MINIZ_HEADER_FILE_ONLY
+#include <miniz.h>
+
+// Prints the encoded size of chunks with every ChunkCodec, and the throughput of encoding and decoding them,
+// against RAW deflated with the zip library's compressor, which is what the .data files that predate region files were stored as
+//
+// Usage: chunk_codec_benchmark
+
+// The number of chunks in each sample, as each one needs MAX_ENCODED_CHUNK_SIZE bytes of output buffer
+#define CHUNK_CODEC_BENCHMARK_CHUNKS 1024
+
+/*
+ * RAW_DEFLATE
+ */
+
+static int raw_deflate_encode(const UnpackedChunk& chunk, byte* buffer) {
+    thread_local byte raw[SERIALIZED_CHUNK_SIZE];
+    int raw_size = get_chunk_codec(ChunkCodecType::RAW)->encode(chunk, raw);
+    // Raw deflate without a zlib header, at the same level as ZIP_DEFAULT_COMPRESSION_LEVEL
+    return tdefl_compress_mem_to_mem(buffer, MAX_ENCODED_CHUNK_SIZE, raw, raw_size, TDEFL_DEFAULT_MAX_PROBES);
+}
+
+static int raw_deflate_get_encoded_size(const UnpackedChunk& chunk) {
+    thread_local byte buffer[MAX_ENCODED_CHUNK_SIZE];
+    return raw_deflate_encode(chunk, buffer);
+}
+
+static bool raw_deflate_decode(const byte* buffer, int size, UnpackedChunk& chunk) {
+    thread_local byte raw[SERIALIZED_CHUNK_SIZE];
+    size_t raw_size = tinfl_decompress_mem_to_mem(raw, SERIALIZED_CHUNK_SIZE, buffer, size, 0);
+    if (raw_size == TINFL_DECOMPRESS_MEM_TO_MEM_FAILED) {
+        return false;
+    }
+    return get_chunk_codec(ChunkCodecType::RAW)->decode(raw, raw_size, chunk);
+}
+
+static const ChunkCodec raw_deflate_codec = {ChunkCodecType::RAW_DEFLATE, "raw+deflate", raw_deflate_get_encoded_size, raw_deflate_encode, raw_deflate_decode};
+
+// Print the average encoded size of the given chunks with every codec, and the throughput of encoding and decoding them
+static void benchmark_chunk_codecs(const char* description, const vector<UnpackedChunk>& chunks) {
+    vector<const ChunkCodec*> codecs = {
+        get_chunk_codec(ChunkCodecType::RAW),
+        &raw_deflate_codec,
+        get_chunk_codec(ChunkCodecType::PALETTE_RLE),
+        get_chunk_codec(ChunkCodecType::PALETTE_BITPACKED),
+    };
+    vector<byte> buffer(MAX_ENCODED_CHUNK_SIZE*chunks.size());
+    vector<int> sizes(chunks.size());
+    // Throughput is measured against the size of the chunks as RAW, which is 3 bytes per block
+    double megabytes = (double)chunks.size()*SERIALIZED_CHUNK_SIZE/1024/1024;
+
+    dbg("Chunk codecs, on %zu %s:", chunks.size(), description);
+    // The last pass is the codec that choose_chunk_codec picks for each chunk
+    for(size_t c = 0; c <= codecs.size(); c++) {
+        auto get_codec = [&](const UnpackedChunk& chunk) {
+            return c < codecs.size() ? codecs[c] : choose_chunk_codec(chunk);
+        };
+
+        size_t total_size = 0;
+        auto start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < chunks.size(); i++) {
+            sizes[i] = get_codec(chunks[i])->encode(chunks[i], &buffer[i*MAX_ENCODED_CHUNK_SIZE]);
+            total_size += sizes[i];
+        }
+        double encode_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        UnpackedChunk decoded;
+        int num_errors = 0;
+        start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < chunks.size(); i++) {
+            if (!get_codec(chunks[i])->decode(&buffer[i*MAX_ENCODED_CHUNK_SIZE], sizes[i], decoded)) {
+                num_errors++;
+            }
+        }
+        double decode_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        dbg("%-18s %8.1f bytes/chunk, encode %8.1f MB/s, decode %8.1f MB/s (%d errors)",
+            c < codecs.size() ? codecs[c]->name : "chosen per chunk",
+            (double)total_size/chunks.size(), megabytes/encode_time, megabytes/decode_time, num_errors);
+    }
+}
+
+int main() {
+    // The chunks of the world that the game generates, repeated until there are enough of them to time
+    HeadlessWorld world = generate_overworld();
+    vector<UnpackedChunk> overworld_chunks(CHUNK_CODEC_BENCHMARK_CHUNKS);
+    auto it = world.chunks.begin();
+    for(UnpackedChunk& chunk : overworld_chunks) {
+        it->second.unpack(chunk);
+        if (++it == world.chunks.end()) {
+            it = world.chunks.begin();
+        }
+    }
+    benchmark_chunk_codecs("generated chunks", overworld_chunks);
+
+    // Chunks of random blocks, which is the worst case for every codec
+    for(int num_models : {4, 256}) {
+        vector<UnpackedChunk> random_chunks(CHUNK_CODEC_BENCHMARK_CHUNKS);
+        shared_ptr<ChunkContents> contents = make_shared<ChunkContents>();
+        for(UnpackedChunk& chunk : random_chunks) {
+            for(int i = 0; i < CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE; i++) {
+                contents->blocks.set(i, 1 + rand() % num_models);
+            }
+            contents->unpack(chunk);
+        }
+        string description = "chunks of " + std::to_string(num_models) + " random block models";
+        benchmark_chunk_codecs(description.c_str(), random_chunks);
+    }
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include "headless_world.hpp"
+
+// Meshes known chunks with a ChunkMesher, and checks which faces are culled and how many quads are left
+
+static int num_failures = 0;
+
+#define CHECK_EQUAL(actual, expected) { \
+    long long _actual_ = (actual); \
+    long long _expected_ = (expected); \
+    if (_actual_ != _expected_) { \
+        dbg("FAILED: %s is %lld, expected %lld", #actual, _actual_, _expected_); \
+        num_failures++; \
+    } \
+}
+
+// Mesh the given chunk, returning the number of quads
+static int mesh_chunk(const ChunkSnapshot& chunk, const ChunkBorders& borders, bool greedy, ChunkMesh& mesh) {
+    ChunkMesher mesher(get_headless_components);
+    mesher.set_greedy(greedy);
+    mesher.mesh(chunk, borders, mesh);
+    if (mesh.vertices.size() != (size_t)mesh.num_quads*4) {
+        dbg("FAILED: %d vertices for %d quads", (int)mesh.vertices.size(), mesh.num_quads);
+        num_failures++;
+    }
+    return mesh.num_quads;
+}
+
+static int count_quads(const ChunkSnapshot& chunk, const ChunkBorders& borders, bool greedy) {
+    ChunkMesh mesh;
+    return mesh_chunk(chunk, borders, greedy, mesh);
+}
+
+static ChunkSnapshot make_chunk(const vector<pair<ivec3, int>>& blocks) {
+    shared_ptr<ChunkContents> contents = make_shared<ChunkContents>();
+    for(auto& [pos, block_model] : blocks) {
+        contents->blocks.set((pos.x*CHUNK_SIZE + pos.y)*CHUNK_SIZE + pos.z, block_model);
+    }
+    return ChunkSnapshot(contents);
+}
+
+static ChunkSnapshot make_uniform_chunk(int block_model) {
+    shared_ptr<ChunkContents> contents = make_shared<ChunkContents>();
+    contents->blocks.fill(block_model);
+    return ChunkSnapshot(contents);
+}
+
+static void test_single_blocks() {
+    ChunkBorders air;
+
+    // Every face of a lone block is visible
+    ChunkSnapshot one_block = make_chunk({{ivec3(3, 4, 5), STONE_MODEL}});
+    CHECK_EQUAL(count_quads(one_block, air, false), 6);
+    CHECK_EQUAL(count_quads(one_block, air, true), 6);
+
+    // The two faces that touch are culled, and the other faces are merged in pairs
+    ChunkSnapshot two_blocks = make_chunk({{ivec3(3, 4, 5), STONE_MODEL}, {ivec3(4, 4, 5), STONE_MODEL}});
+    CHECK_EQUAL(count_quads(two_blocks, air, false), 10);
+    CHECK_EQUAL(count_quads(two_blocks, air, true), 6);
+
+    // Different textures aren't merged
+    ChunkSnapshot stone_and_dirt = make_chunk({{ivec3(3, 4, 5), STONE_MODEL}, {ivec3(4, 4, 5), DIRT_MODEL}});
+    CHECK_EQUAL(count_quads(stone_and_dirt, air, true), 10);
+
+    // Glass isn't opaque, so the stone face that touches it is still visible. The glass face that touches the stone is culled
+    ChunkSnapshot stone_and_glass = make_chunk({{ivec3(3, 4, 5), STONE_MODEL}, {ivec3(4, 4, 5), GLASS_MODEL}});
+    CHECK_EQUAL(count_quads(stone_and_glass, air, false), 11);
+    CHECK_EQUAL(count_quads(stone_and_glass, air, true), 11);
+
+    // A face is culled by the side of the neighbor that faces it. A floor is opaque on its bottom, so it culls the top of the stone below it.
+    // Facing the floor the other way, the top of the stone doesn't cull the floor above it
+    ChunkSnapshot floor_on_stone = make_chunk({{ivec3(3, 4, 5), STONE_MODEL}, {ivec3(3, 5, 5), FLOOR_MODEL}});
+    CHECK_EQUAL(count_quads(floor_on_stone, air, false), 10);
+    CHECK_EQUAL(count_quads(floor_on_stone, air, true), 10);
+    ChunkSnapshot stone_on_floor = make_chunk({{ivec3(3, 4, 5), FLOOR_MODEL}, {ivec3(3, 5, 5), STONE_MODEL}});
+    CHECK_EQUAL(count_quads(stone_on_floor, air, false), 11);
+    CHECK_EQUAL(count_quads(stone_on_floor, air, true), 11);
+
+    // A block model whose bitmap ID doesn't fit in a ChunkVertex isn't meshed, and doesn't cull the stone next to it
+    ChunkSnapshot stone_and_huge_tile = make_chunk({{ivec3(3, 4, 5), STONE_MODEL}, {ivec3(4, 4, 5), HUGE_TILE_MODEL}});
+    CHECK_EQUAL(count_quads(stone_and_huge_tile, air, false), 6);
+    CHECK_EQUAL(count_quads(stone_and_huge_tile, air, true), 6);
+
+    // Air has nothing to mesh
+    CHECK_EQUAL(count_quads(make_uniform_chunk(0), air, false), 0);
+}
+
+static void test_uniform_chunks() {
+    ChunkSnapshot stone = make_uniform_chunk(STONE_MODEL);
+
+    // Surrounded by air, only the outside of the chunk is visible
+    ChunkBorders air;
+    CHECK_EQUAL(count_quads(stone, air, false), 6*CHUNK_SIZE*CHUNK_SIZE);
+    CHECK_EQUAL(count_quads(stone, air, true), 6);
+
+    // Surrounded by stone, nothing is visible
+    ChunkBorders buried;
+    for(int dir = 0; dir < 6; dir++) {
+        buried.set_neighbor(dir, stone);
+    }
+    CHECK_EQUAL(count_quads(stone, buried, false), 0);
+    CHECK_EQUAL(count_quads(stone, buried, true), 0);
+
+    // Surrounded by glass, everything on the outside is visible again
+    ChunkSnapshot glass = make_uniform_chunk(GLASS_MODEL);
+    ChunkBorders glazed;
+    for(int dir = 0; dir < 6; dir++) {
+        glazed.set_neighbor(dir, glass);
+    }
+    CHECK_EQUAL(count_quads(stone, glazed, true), 6);
+}
+
+static void test_overworld() {
+    HeadlessWorld world = generate_overworld();
+    ChunkBorders borders;
+
+    // The middle of the surface has its sides buried, and only its top and bottom visible.
+    // The bottom is at the edge of the world, where the missing chunks are air
+    world.get_borders(ivec3(0, -1, 0), borders);
+    const ChunkSnapshot& middle = *world.get_chunk(ivec3(0, -1, 0));
+    CHECK_EQUAL(count_quads(middle, borders, false), 2*CHUNK_SIZE*CHUNK_SIZE);
+    ChunkMesh mesh;
+    CHECK_EQUAL(mesh_chunk(middle, borders, true, mesh), 2);
+    // The top is one 16x16 quad of dirt. See ChunkVertex for how its vertices are packed
+    int num_top_vertices = 0;
+    for(const ChunkVertex& vertex : mesh.vertices) {
+        if (vertex.position >> 27 != 3) {
+            continue;
+        }
+        num_top_vertices++;
+        ivec3 position(vertex.position & 511, (vertex.position >> 9) & 511, (vertex.position >> 18) & 511);
+        position = position / 16 - CHUNK_VERTEX_POSITION_BIAS;
+        CHECK_EQUAL(position.y, CHUNK_SIZE);
+        CHECK_EQUAL(position.x == 0 || position.x == CHUNK_SIZE, true);
+        CHECK_EQUAL(position.z == 0 || position.z == CHUNK_SIZE, true);
+        CHECK_EQUAL(vertex.texture & CHUNK_VERTEX_MAX_TILE, DIRT_TILE);
+    }
+    CHECK_EQUAL(num_top_vertices, 4);
+
+    // The corner of the surface also has two sides facing the air, each with a strip of dirt above a strip of stone
+    world.get_borders(ivec3(-1, -1, -1), borders);
+    const ChunkSnapshot& corner = *world.get_chunk(ivec3(-1, -1, -1));
+    CHECK_EQUAL(count_quads(corner, borders, false), 4*CHUNK_SIZE*CHUNK_SIZE);
+    CHECK_EQUAL(count_quads(corner, borders, true), 6);
+
+    // The chunks above the surface are air
+    world.get_borders(ivec3(0, 0, 0), borders);
+    CHECK_EQUAL(count_quads(*world.get_chunk(ivec3(0, 0, 0)), borders, true), 0);
+}
+
+int main() {
+    test_single_blocks();
+    test_uniform_chunks();
+    test_overworld();
+    if (num_failures) {
+        dbg("%d checks failed", num_failures);
+        return 1;
+    }
+    dbg("All checks passed");
+    return 0;
+}
@@ -0,0 +1,154 @@
+#include "../src/world.hpp"
+
+// Hammers a new world from many threads at once, while the main thread keeps evicting its megachunks,
+// and checks that every thread reads back exactly what it wrote.
+// Build with -DVOXELCRAFT_TSAN=ON, so that ThreadSanitizer also reports any data races
+//
+// Usage: concurrency_stress_test [number of operations per thread, 10000 by default]
+
+// Index of an offset within a box of the given size, matching the layout of World::copy_box_to_buffer
+#define BOX_INDEX(offset, size) (((offset).x*(size).y + (offset).y)*(size).z + (offset).z)
+
+static ivec3 to_chunk_coords(ivec3 location) {
+    return ivec3(floor_div(location.x, CHUNK_SIZE), floor_div(location.y, CHUNK_SIZE), floor_div(location.z, CHUNK_SIZE));
+}
+
+int main(int argc, char** argv) {
+    int num_threads = std::max(8, (int)std::thread::hardware_concurrency());
+    int num_operations = argc > 1 ? atoi(argv[1]) : 10000;
+    if (num_operations <= 0) {
+        dbg("ERROR: The number of operations must be positive!");
+        return 1;
+    }
+
+    World world;
+    // Evict every megachunk that isn't being used, as often as possible, so that megachunks are constantly reloaded from disk
+    std::filesystem::path save_directory = std::filesystem::temp_directory_path() / "voxelcraft_stress_test";
+    std::filesystem::remove_all(save_directory);
+    std::filesystem::create_directory(save_directory);
+    world.save(save_directory.string().c_str());
+    world.set_memory_budget(1);
+
+    // Every thread writes to this region, so nothing can be checked there, other than that the world stays consistent
+    ivec3 shared_location(-8, -8, -8);
+    ivec3 shared_size(32, 32, 32);
+
+    std::atomic<int> num_running(num_threads);
+    std::atomic<int> num_errors(0);
+    vector<std::thread> threads;
+    for(int t = 0; t < num_threads; t++) {
+        threads.emplace_back([&, t]() {
+            // Each thread owns a region that straddles the corner of a megachunk, and checks that it reads back exactly what it wrote
+            ivec3 own_location = ivec3(t + 1, 0, 0)*(MEGACHUNK_SIZE*CHUNK_SIZE) - ivec3(CHUNK_SIZE/2);
+            ivec3 own_size(CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE);
+            vector<int> expected(CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE, 0);
+            vector<int> buffer(CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE);
+            UnpackedChunk unpacked;
+            vector<byte> encoded(MAX_ENCODED_CHUNK_SIZE);
+
+            // xorshift32, seeded differently for every thread
+            uint state = 2463534242U + t*7919;
+            auto random = [&state](int n) {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                return (int)(state % n);
+            };
+
+            for(int i = 0; i < num_operations; i++) {
+                ivec3 own_offset(random(CHUNK_SIZE), random(CHUNK_SIZE), random(CHUNK_SIZE));
+                ivec3 own_block = own_location + own_offset;
+                ivec3 shared_block = shared_location + ivec3(random(shared_size.x), random(shared_size.y), random(shared_size.z));
+                ivec3 shared_chunk = to_chunk_coords(shared_block);
+                int model = random(4);
+
+                switch(random(9)) {
+                case 0:
+                    world.set_block(own_block.x, own_block.y, own_block.z, model);
+                    expected[BOX_INDEX(own_offset, own_size)] = model;
+                    break;
+                case 1: {
+                    optional<BlockData> b = world.read_block(own_block);
+                    if ((b ? b->block_model : 0) != expected[BOX_INDEX(own_offset, own_size)]) {
+                        num_errors++;
+                    }
+                    // No other thread writes to the columns of this region either, so their heights are known too
+                    optional<int> expected_height;
+                    for(int y = own_size.y - 1; y >= 0 && !expected_height; y--) {
+                        if (expected[BOX_INDEX(ivec3(own_offset.x, y, own_offset.z), own_size)]) {
+                            expected_height = own_location.y + y;
+                        }
+                    }
+                    if (world.get_height(own_block.x, own_block.z) != expected_height) {
+                        num_errors++;
+                    }
+                    break;
+                }
+                case 2: {
+                    ivec3 size = min(ivec3(random(4) + 1, random(4) + 1, random(4) + 1), own_size - own_offset);
+                    world.fill_box(own_block, size, model);
+                    for(int x = 0; x < size.x; x++) {
+                        for(int y = 0; y < size.y; y++) {
+                            for(int z = 0; z < size.z; z++) {
+                                expected[BOX_INDEX(own_offset + ivec3(x, y, z), own_size)] = model;
+                            }
+                        }
+                    }
+                    break;
+                }
+                case 3:
+                    world.copy_box_to_buffer(own_location, own_size, buffer.data());
+                    if (buffer != expected) {
+                        num_errors++;
+                    }
+                    break;
+                case 4:
+                    world.set_block(shared_block.x, shared_block.y, shared_block.z, model);
+                    break;
+                case 5:
+                    world.read_block(shared_block);
+                    break;
+                case 6: {
+                    optional<ChunkSnapshot> snapshot = world.snapshot_chunk(shared_chunk);
+                    if (snapshot) {
+                        snapshot->unpack(unpacked);
+                        choose_chunk_codec(unpacked)->encode(unpacked, encoded.data());
+                    }
+                    break;
+                }
+                case 7:
+                    if (world.try_claim_chunk(shared_chunk, CHUNK_STATE_GENERATING)) {
+                        world.mark_generated(shared_chunk);
+                        if (!world.is_generated(shared_chunk)) {
+                            num_errors++;
+                        }
+                        world.release_chunk(shared_chunk, CHUNK_STATE_GENERATING);
+                    }
+                    break;
+                case 8:
+                    world.raycast(vec3(shared_block), vec3(1.0f, 1.0f, 1.0f), 16.0f);
+                    break;
+                }
+            }
+            num_running--;
+        });
+    }
+
+    // Meanwhile, act as the main thread
+    int num_evictions = 0;
+    while(num_running > 0) {
+        world.evict_megachunks();
+        num_evictions++;
+        // Leave some time for the megachunks to be loaded back in
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::filesystem::remove_all(save_directory);
+
+    dbg("Concurrency stress test: %d threads, %d operations each, %d eviction passes, %d errors",
+        num_threads, num_operations, num_evictions, num_errors.load());
+    return num_errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,33 @@
+#include "../src/world.hpp"
+#include <chrono>
+
+// Prints the time taken to fill a 64x64x64 region of a new world, using World::set_block on each block, and using World::fill_box
+//
+// Usage: fill_box_benchmark
+
+int main() {
+    // Not aligned to chunk boundaries, so that the region has partially filled chunks
+    ivec3 location(8, 8, 8);
+    ivec3 size(64, 64, 64);
+    // Any nonzero block model will do, as nothing is rendered
+    int model = 1;
+
+    World per_block_world;
+    auto start = std::chrono::steady_clock::now();
+    for(int x = 0; x < size.x; x++) {
+        for(int y = 0; y < size.y; y++) {
+            for(int z = 0; z < size.z; z++) {
+                per_block_world.set_block(location.x + x, location.y + y, location.z + z, model);
+            }
+        }
+    }
+    double per_block_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    World fill_box_world;
+    start = std::chrono::steady_clock::now();
+    fill_box_world.fill_box(location, size, model);
+    double fill_box_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    dbg("Filling a 64x64x64 region: %.2fms with set_block, %.2fms with fill_box", per_block_time*1000, fill_box_time*1000);
+    return 0;
+}
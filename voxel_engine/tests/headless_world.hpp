@@ -0,0 +1,138 @@
+#ifndef _HEADLESS_WORLD_HPP_
+#define _HEADLESS_WORLD_HPP_
+
+#include "../src/chunk_mesher.hpp"
+
+// Block models and components built without a Universe, for meshing chunks without OpenGL
+
+// The block models of the game's world, and then of blocks that aren't opaque on every side.
+// Glass is a unit cube that isn't opaque on any side, and a floor is a unit cube that's only opaque on its bottom.
+// The last block model has a texture that doesn't fit on the texture atlas of a chunk
+#define STONE_MODEL 1
+#define DIRT_MODEL 2
+#define GLASS_MODEL 3
+#define FLOOR_MODEL 4
+#define HUGE_TILE_MODEL 5
+
+// Bitmap IDs of each block model's texture
+#define STONE_TILE 1
+#define DIRT_TILE 2
+#define GLASS_TILE 3
+#define FLOOR_TILE 4
+#define HUGE_TILE (CHUNK_VERTEX_MAX_TILE + 1)
+
+// A unit cube with the same texture on every side, like assets/meshes/cube.mesh,
+// which is opaque in each direction dir where (opaque_faces >> dir) & 1 == 1
+inline MesherComponent make_cube_component(int tile, int opaque_faces) {
+    MesherComponent component;
+    for(int dir = 0; dir < 6; dir++) {
+        component.opacities[dir] = (opaque_faces >> dir) & 1;
+        // The uv of a face is its position on the face
+        component.cube_faces.push_back(CubeFace{0, mat2(1.0f), vec2(0.0f)});
+    }
+    component.texture_tiles = {tile};
+    component.get_tile_mesh_data = [tile](bool* visible_neighbors) -> tuple<byte*, byte*, byte*, int> {
+        static thread_local vec3 vertices[6*4];
+        static thread_local vec2 uvs[6*4];
+        static thread_local int tiles[6];
+        static const vec2 corners[4] = {vec2(0, 0), vec2(1, 0), vec2(1, 1), vec2(0, 1)};
+        int num_quads = 0;
+        for(int dir = 0; dir < 6; dir++) {
+            if (!visible_neighbors[dir]) {
+                continue;
+            }
+            int axis = dir / 2;
+            int u_axis = axis == 0 ? 1 : 0;
+            int v_axis = axis == 2 ? 1 : 2;
+            // Counter-clockwise when looking at the face from outside of the cube
+            bool forward = (axis != 1) == (bool)(dir & 1);
+            for(int vert = 0; vert < 4; vert++) {
+                vec2 corner = corners[forward ? vert : (4 - vert) % 4];
+                vec3& vertex = vertices[num_quads*4 + vert];
+                vertex[axis] = dir & 1;
+                vertex[u_axis] = corner.x;
+                vertex[v_axis] = corner.y;
+                uvs[num_quads*4 + vert] = corner;
+            }
+            tiles[num_quads] = tile;
+            num_quads++;
+        }
+        return {(byte*)vertices, (byte*)uvs, (byte*)tiles, num_quads};
+    };
+    return component;
+}
+
+// The components of the block models above
+inline vector<MesherComponent> get_headless_components(int block_model) {
+    switch (block_model) {
+    case STONE_MODEL:
+        return {make_cube_component(STONE_TILE, (1 << 6) - 1)};
+    case DIRT_MODEL:
+        return {make_cube_component(DIRT_TILE, (1 << 6) - 1)};
+    case GLASS_MODEL:
+        return {make_cube_component(GLASS_TILE, 0)};
+    case FLOOR_MODEL:
+        return {make_cube_component(FLOOR_TILE, 1 << 2)};
+    case HUGE_TILE_MODEL:
+        return {make_cube_component(HUGE_TILE, (1 << 6) - 1)};
+    }
+    dbg("ERROR: Block model %d doesn't exist!", block_model);
+    return {};
+}
+
+// Fill the given chunk the same way as OverworldGen in mods/main_mod/WorldGen.vs:
+// Dirt on top of stone in the top half of chunk y = -1, stone below it, and air above it
+inline void generate_overworld_chunk(ivec3 chunk_coords, ChunkContents& contents) {
+    for(int x = 0; x < CHUNK_SIZE; x++) {
+        for(int y = 0; y < CHUNK_SIZE; y++) {
+            for(int z = 0; z < CHUNK_SIZE; z++) {
+                int block_model = 0;
+                if (chunk_coords.y == -1) {
+                    block_model = y >= 8 ? DIRT_MODEL : STONE_MODEL;
+                } else if (chunk_coords.y < -1) {
+                    block_model = STONE_MODEL;
+                }
+                contents.blocks.set((x*CHUNK_SIZE + y)*CHUNK_SIZE + z, block_model);
+            }
+        }
+    }
+}
+
+// A world of snapshotted chunks, where every chunk that isn't in the world is air
+struct HeadlessWorld {
+    map<tuple<int, int, int>, ChunkSnapshot> chunks;
+
+    void add_chunk(ivec3 chunk_coords, shared_ptr<const ChunkContents> contents) {
+        chunks.insert_or_assign({chunk_coords.x, chunk_coords.y, chunk_coords.z}, ChunkSnapshot(std::move(contents)));
+    }
+    const ChunkSnapshot* get_chunk(ivec3 chunk_coords) const {
+        auto it = chunks.find({chunk_coords.x, chunk_coords.y, chunk_coords.z});
+        return it == chunks.end() ? nullptr : &it->second;
+    }
+    void get_borders(ivec3 chunk_coords, ChunkBorders& borders) const {
+        static const ivec3 offsets[6] = {ivec3(-1, 0, 0), ivec3(1, 0, 0), ivec3(0, -1, 0), ivec3(0, 1, 0), ivec3(0, 0, -1), ivec3(0, 0, 1)};
+        borders = ChunkBorders();
+        for(int dir = 0; dir < 6; dir++) {
+            if (const ChunkSnapshot* neighbor = get_chunk(chunk_coords + offsets[dir])) {
+                borders.set_neighbor(dir, *neighbor);
+            }
+        }
+    }
+};
+
+// The world that the game generates when it starts, in mods/main_mod/Main.vs: The 3x3x3 chunks around the origin
+inline HeadlessWorld generate_overworld() {
+    HeadlessWorld world;
+    for(int x = -1; x <= 1; x++) {
+        for(int y = -1; y <= 1; y++) {
+            for(int z = -1; z <= 1; z++) {
+                shared_ptr<ChunkContents> contents = make_shared<ChunkContents>();
+                generate_overworld_chunk(ivec3(x, y, z), *contents);
+                world.add_chunk(ivec3(x, y, z), contents);
+            }
+        }
+    }
+    return world;
+}
+
+#endif
@@ -0,0 +1,51 @@
+#include "headless_world.hpp"
+#include <chrono>
+
+// Prints the time taken to mesh each chunk of the world that the game generates, and the size of the meshes,
+// with greedy and with per-face meshing. Nothing is uploaded or drawn, so this doesn't need OpenGL or a display
+//
+// Usage: meshing_benchmark [number of passes over the world, 1000 by default]
+
+int main(int argc, char** argv) {
+    int num_passes = argc > 1 ? atoi(argv[1]) : 1000;
+    if (num_passes <= 0) {
+        dbg("ERROR: The number of passes must be positive!");
+        return 1;
+    }
+
+    HeadlessWorld world = generate_overworld();
+    vector<const ChunkSnapshot*> chunks;
+    vector<ChunkBorders> borders(world.chunks.size());
+    for(auto& [coords, snapshot] : world.chunks) {
+        world.get_borders(ivec3(get<0>(coords), get<1>(coords), get<2>(coords)), borders[chunks.size()]);
+        chunks.push_back(&snapshot);
+    }
+
+    for(bool greedy : {false, true}) {
+        // One long-lived mesher, like each of the mesher threads of a World
+        ChunkMesher mesher(get_headless_components);
+        mesher.set_greedy(greedy);
+        ChunkMesh mesh;
+        long long num_quads = 0;
+        long long num_vertices = 0;
+        int num_nonempty_chunks = 0;
+        auto start = std::chrono::steady_clock::now();
+        for(int pass = 0; pass < num_passes; pass++) {
+            for(size_t i = 0; i < chunks.size(); i++) {
+                mesher.mesh(*chunks[i], borders[i], mesh);
+                if (pass == 0) {
+                    num_quads += mesh.num_quads;
+                    num_vertices += mesh.vertices.size();
+                    num_nonempty_chunks += mesh.num_quads > 0;
+                }
+            }
+        }
+        double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double num_chunks = num_nonempty_chunks ? num_nonempty_chunks : 1;
+        dbg("Meshing (%s): %d chunks (%d with quads), %.4fms per chunk, %.1f quads and %.1f vertices (%.0f bytes) per chunk with quads",
+            greedy ? "greedy" : "per-face", (int)chunks.size(), num_nonempty_chunks, time*1000 / ((double)num_passes * chunks.size()),
+            num_quads / num_chunks, num_vertices / num_chunks, num_vertices * sizeof(ChunkVertex) / num_chunks);
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include "headless_world.hpp"
+#include "../src/world.hpp"
+#include <chrono>
+
+// Prints the throughput of World::read_block on the world that the game generates,
+// reading every block of every chunk both sequentially and in a random order
+//
+// Usage: read_block_benchmark [number of passes over the world, 100 by default]
+
+int main(int argc, char** argv) {
+    int num_passes = argc > 1 ? atoi(argv[1]) : 100;
+    if (num_passes <= 0) {
+        dbg("ERROR: The number of passes must be positive!");
+        return 1;
+    }
+
+    // The 3x3x3 chunks around the origin, filled the same way as generate_overworld_chunk
+    World world;
+    ivec3 world_location = ivec3(-1)*CHUNK_SIZE;
+    ivec3 world_size = ivec3(3)*CHUNK_SIZE;
+    world.fill_box(world_location, world_size, 0);
+    world.fill_box(world_location, ivec3(world_size.x, 8, world_size.z), STONE_MODEL);
+    world.fill_box(world_location + ivec3(0, 8, 0), ivec3(world_size.x, 8, world_size.z), DIRT_MODEL);
+
+    long long num_reads = (long long)num_passes*world_size.x*world_size.y*world_size.z;
+    // Sum of the block models read, so that the reads can't be optimized out
+    long long checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for(int pass = 0; pass < num_passes; pass++) {
+        for(int x = 0; x < world_size.x; x++) {
+            for(int y = 0; y < world_size.y; y++) {
+                for(int z = 0; z < world_size.z; z++) {
+                    optional<BlockData> b = world.read_block(world_location + ivec3(x, y, z));
+                    checksum += b ? b->block_model : 0;
+                }
+            }
+        }
+    }
+    double sequential_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // xorshift32, so that every run reads the same random blocks
+    uint state = 2463534242U;
+    start = std::chrono::steady_clock::now();
+    for(long long i = 0; i < num_reads; i++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        ivec3 offset(state % world_size.x, (state >> 8) % world_size.y, (state >> 16) % world_size.z);
+        optional<BlockData> b = world.read_block(world_location + offset);
+        checksum += b ? b->block_model : 0;
+    }
+    double random_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    dbg("read_block: %lld reads, %.1fns per sequential read, %.1fns per random read (Checksum: %lld)",
+        num_reads, sequential_time*1e9 / num_reads, random_time*1e9 / num_reads, checksum);
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "../src/region_file.hpp"
+#include <chrono>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#endif
+
+// Prints the write throughput of storing megachunks in region files, and the read throughput and latency of reading them back,
+// with every StorageBackend. The region files are dropped from the page cache before they're read, so that the reads go to the disk
+//
+// Usage: storage_benchmark
+
+// The number of megachunks that are written and read, and the number of chunks in each
+#define STORAGE_BENCHMARK_MEGACHUNKS 16
+#define STORAGE_BENCHMARK_CHUNKS 256
+
+static ivec3 get_megachunk_coords(int m) {
+    return ivec3(m, 0, 0);
+}
+
+static ivec3 get_chunk_coords(int m, int c) {
+    return get_megachunk_coords(m)*MEGACHUNK_SIZE + ivec3(c / (MEGACHUNK_SIZE*MEGACHUNK_SIZE), (c / MEGACHUNK_SIZE) % MEGACHUNK_SIZE, c % MEGACHUNK_SIZE);
+}
+
+static double get_time() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main() {
+    // Chunks of random blocks, encoded the way that a World saves them, so that they're about as large as the most varied terrain
+    vector<vector<byte>> payloads(STORAGE_BENCHMARK_MEGACHUNKS*STORAGE_BENCHMARK_CHUNKS);
+    shared_ptr<ChunkContents> contents = make_shared<ChunkContents>();
+    UnpackedChunk unpacked;
+    size_t num_bytes = 0;
+    for(vector<byte>& payload : payloads) {
+        for(int i = 0; i < CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE; i++) {
+            contents->blocks.set(i, 1 + rand() % 256);
+        }
+        contents->unpack(unpacked);
+        payload.resize(MAX_ENCODED_CHUNK_SIZE);
+        payload.resize(choose_chunk_codec(unpacked)->encode(unpacked, payload.data()));
+        num_bytes += payload.size();
+    }
+    double mb = num_bytes / 1024.0 / 1024.0;
+    int num_errors = 0;
+
+    StorageBackend backends[] = {StorageBackend::BLOCKING, StorageBackend::IO_URING};
+    const char* backend_names[] = {"blocking", "io_uring"};
+    for(int b = 0; b < 2; b++) {
+        if (!RegionFile::set_storage_backend(backends[b])) {
+            dbg("Storage benchmark (%s): Not available", backend_names[b]);
+            continue;
+        }
+        // Each backend writes to new region files, so that every payload is appended
+        std::filesystem::path directory = std::filesystem::temp_directory_path() / (string("voxelcraft_storage_benchmark_") + backend_names[b]);
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directory(directory);
+
+        // Every region file, by the x of its region coordinates
+        vector<unique_ptr<RegionFile>> regions((STORAGE_BENCHMARK_MEGACHUNKS + REGION_SIZE - 1) / REGION_SIZE);
+        bool opened = true;
+        for(size_t r = 0; r < regions.size(); r++) {
+            regions[r].reset(new RegionFile());
+            opened = regions[r]->open((directory / ("r." + std::to_string(r) + ".0.0.region")).string()) && opened;
+        }
+        if (!opened) {
+            dbg("Storage benchmark (%s): Could not open the region files in %s!", backend_names[b], directory.string().c_str());
+            std::filesystem::remove_all(directory);
+            num_errors++;
+            continue;
+        }
+
+        double start = get_time();
+        for(int m = 0; m < STORAGE_BENCHMARK_MEGACHUNKS; m++) {
+            for(int c = 0; c < STORAGE_BENCHMARK_CHUNKS; c++) {
+                vector<byte>& payload = payloads[m*STORAGE_BENCHMARK_CHUNKS + c];
+                regions[m / REGION_SIZE]->write_chunk(get_chunk_coords(m, c), payload.data(), payload.size());
+            }
+        }
+        for(unique_ptr<RegionFile>& region : regions) {
+            region->flush();
+        }
+        double write_time = get_time() - start;
+
+        for(unique_ptr<RegionFile>& region : regions) {
+            region->close();
+#ifndef _WIN32
+            // Flushing fsyncs the region files, so all of their pages are clean and can be dropped
+            FILE* f = fopen(region->get_filepath().c_str(), "rb");
+            if (f) {
+                posix_fadvise(fileno(f), 0, 0, POSIX_FADV_DONTNEED);
+                fclose(f);
+            }
+#endif
+            region->open(region->get_filepath());
+        }
+
+        vector<double> latencies;
+        size_t num_bytes_read = 0;
+        // Sum of every byte read, as the blocking backend only reads a page from the disk once it's touched
+        unsigned int checksum = 0;
+        start = get_time();
+        for(int m = 0; m < STORAGE_BENCHMARK_MEGACHUNKS; m++) {
+            double read_start = get_time();
+            regions[m / REGION_SIZE]->read_megachunk(get_megachunk_coords(m), [&](ivec3, const byte* payload, int length) {
+                num_bytes_read += length;
+                for(int i = 0; i < length; i++) {
+                    checksum += payload[i];
+                }
+            });
+            latencies.push_back((get_time() - read_start)*1000);
+        }
+        double read_time = get_time() - start;
+        sort(latencies.begin(), latencies.end());
+
+        if (num_bytes_read != num_bytes) {
+            dbg("Storage benchmark (%s): Wrote %zu bytes, but read back %zu bytes!", backend_names[b], num_bytes, num_bytes_read);
+            num_errors++;
+        }
+        dbg("Storage benchmark (%s): Wrote %.1fMB at %.1fMB/s. Read %zu megachunks at %.1fMB/s, latency p50 %.2fms, p99 %.2fms, max %.2fms (Checksum: %u)",
+            backend_names[b], mb, mb / write_time, latencies.size(), mb / read_time,
+            latencies[latencies.size() / 2], latencies[latencies.size()*99 / 100], latencies.back(), checksum);
+
+        regions.clear();
+        std::filesystem::remove_all(directory);
+    }
+    return num_errors > 0 ? 1 : 0;
+}